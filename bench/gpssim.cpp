@@ -0,0 +1,149 @@
+/**
+  @file gpssim.cpp
+
+  Receiver simulator front end.
+  Writes NMEA or SiRF binary output to stdout (a pipe or file) or to a
+  pseudo terminal whose slave path is printed on stderr. Through a pty,
+  host commands are read back and output is garbled while the host
+  terminal runs at another baud rate than the simulated receiver.
+
+  usage: gpssim [-p] [-R] [-b] [-r hz] [-t seconds] [-n noise m] [-e error rate]
+                [-s seed] [-l lat,lon,alt] [-m speed,heading,turn rate]
+
+  @author Osamu Takahashi
+*/
+#include <GPS.h>
+#include <GPS/simulator.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+namespace {
+
+  long baudOf(speed_t in_speed) {
+    switch(in_speed) {
+      case B4800: return 4800;
+      case B9600: return 9600;
+      case B19200: return 19200;
+      case B38400: return 38400;
+      case B57600: return 57600;
+      case B115200: return 115200;
+    }
+    return 0;
+  }
+
+  void usage() {
+    fprintf(stderr,
+      "usage: gpssim [-p] [-R] [-b] [-r hz] [-t seconds] [-n noise m] [-e error rate]\n"
+      "              [-s seed] [-l lat,lon,alt] [-m speed,heading,turn rate]\n"
+      "  -p  output to a pseudo terminal and accept commands from it\n"
+      "  -R  pace output in real time\n"
+      "  -b  start in SiRF binary\n");
+    exit(1);
+  }
+
+  bool writeAll(int in_fd,const uint8_t *in_data,size_t in_length) {
+    while (in_length > 0) {
+      ssize_t n = write(in_fd,in_data,in_length);
+      if (n <= 0)
+        return false;
+      in_data += n;
+      in_length -= n;
+    }
+    return true;
+  }
+
+} /* namespace */
+
+int main(int argc,char **argv) {
+  bool pty = false;
+  bool realtime = false;
+  bool binary = false;
+  int hz = 1;
+  double seconds = 10;
+  double noise = 0;
+  double errorRate = 0;
+  uint32_t seed = 1;
+  double lat = 35.6812,lon = 139.7671,alt = 40;
+  double speed = 0,heading = 0,turnRate = 0;
+
+  int c;
+  while ((c = getopt(argc,argv,"pRbr:t:n:e:s:l:m:")) != -1) {
+    switch(c) {
+      case 'p': pty = true; break;
+      case 'R': realtime = true; break;
+      case 'b': binary = true; break;
+      case 'r': hz = atoi(optarg); break;
+      case 't': seconds = atof(optarg); break;
+      case 'n': noise = atof(optarg); break;
+      case 'e': errorRate = atof(optarg); break;
+      case 's': seed = strtoul(optarg,NULL,0); break;
+      case 'l': sscanf(optarg,"%lf,%lf,%lf",&lat,&lon,&alt); break;
+      case 'm': sscanf(optarg,"%lf,%lf,%lf",&speed,&heading,&turnRate); break;
+      default: usage();
+    }
+  }
+
+  if (hz < 1 || hz > 10)
+    usage();
+
+  GPS::Simulator sim(seed);
+  sim.setStart(lat,lon,alt,GPS::util::utcToEpochNanos(2020,1,1,0,0,0,0));
+  sim.setMotion(speed,heading,turnRate);
+  sim.setEpochRate(hz);
+  sim.setNoise(noise);
+  sim.setErrorRate(errorRate);
+  if (binary)
+    sim.setProtocol(GPS::NMEA::PROTOCOL_SiRF_binary);
+
+  int fd = STDOUT_FILENO;
+  if (pty) {
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+      perror("posix_openpt");
+      return 1;
+    }
+    struct termios t;
+    tcgetattr(fd,&t);
+    cfmakeraw(&t);
+    cfsetispeed(&t,B4800);
+    cfsetospeed(&t,B4800);
+    tcsetattr(fd,TCSANOW,&t);
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+    fprintf(stderr,"%s\n",ptsname(fd));
+  }
+
+  uint8_t out[SIMULATOR_EPOCH_SIZE];
+  uint32_t epochs = (uint32_t)(seconds * hz);
+  for (uint32_t i = 0;i < epochs;i++) {
+    long hostBaud = sim.baud();
+    if (pty) {
+      uint8_t in[256];
+      ssize_t n;
+      while ((n = read(fd,in,sizeof(in))) > 0)
+        sim.receive(in,n);
+      struct termios t;
+      tcgetattr(fd,&t);
+      hostBaud = baudOf(cfgetospeed(&t));
+    }
+
+    size_t l = sim.epoch(out,sizeof(out));
+    if (hostBaud != sim.baud()) {
+      for (size_t j = 0;j < l;j++)
+        out[j] = out[j] * 7 + 3;
+    }
+    // a pty without a reader drops output like an unplugged cable
+    if (!writeAll(fd,out,l) && !pty)
+      break;
+    if (realtime)
+      usleep(1000000 / hz);
+  }
+
+  if (pty)
+    close(fd);
+  return 0;
+}
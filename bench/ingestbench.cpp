@@ -0,0 +1,94 @@
+/**
+  @file ingestbench.cpp
+
+  EpollIngest throughput over many socket pairs carrying simulated
+  receiver output, half NMEA and half SiRF binary. Prints JSON.
+
+  usage: ingestbench [streams] [epochs per stream]
+
+  @author Osamu Takahashi
+*/
+#include <GPS.h>
+#include <GPS/ingest.h>
+#include <GPS/simulator.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <vector>
+
+namespace {
+
+  uint64_t g_messages = 0;
+
+  void nmeaHandler(uint32_t,const GPS::NMEA::Message &) {
+    g_messages++;
+  }
+
+  void sirfHandler(uint32_t,const GPS::SiRF::OutputMessage &) {
+    g_messages++;
+  }
+
+  double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+} /* namespace */
+
+int main(int argc,char **argv) {
+  int streams = argc > 1 ? atoi(argv[1]) : 2000;
+  int epochs = argc > 2 ? atoi(argv[2]) : 20;
+
+  struct rlimit rl;
+  getrlimit(RLIMIT_NOFILE,&rl);
+  rl.rlim_cur = rl.rlim_max;
+  setrlimit(RLIMIT_NOFILE,&rl);
+
+  // one burst per stream fits in the socket buffer
+  std::vector<uint8_t> burst[2];
+  for (int p = 0;p < 2;p++) {
+    GPS::Simulator sim(p + 1);
+    if (p)
+      sim.setProtocol(GPS::NMEA::PROTOCOL_SiRF_binary);
+    uint8_t out[SIMULATOR_EPOCH_SIZE];
+    for (int i = 0;i < epochs;i++) {
+      size_t l = sim.epoch(out,sizeof(out));
+      burst[p].insert(burst[p].end(),out,out + l);
+    }
+  }
+
+  GPS::EpollIngest ingest(streams);
+  std::vector<int> writers;
+  for (int i = 0;i < streams;i++) {
+    int sv[2];
+    if (socketpair(AF_UNIX,SOCK_STREAM,0,sv) != 0 || ingest.add(sv[0],nmeaHandler,sirfHandler) < 0) {
+      fprintf(stderr,"stream %d: out of descriptors\n",i);
+      return 1;
+    }
+    writers.push_back(sv[1]);
+  }
+
+  uint64_t bytes = 0;
+  for (int i = 0;i < streams;i++) {
+    const std::vector<uint8_t> &b = burst[i & 1];
+    if (write(writers[i],&b[0],b.size()) != (ssize_t)b.size())
+      return 1;
+    bytes += b.size();
+  }
+
+  double t0 = now();
+  while (ingest.poll(0) > 0);
+  double t = now() - t0;
+
+  printf("{\"streams\":%d,\"bytes\":%llu,\"messages\":%llu,\"wakeups\":%llu,"
+         "\"seconds\":%.6f,\"MBps\":%.1f,\"messagesPerSecond\":%.0f}\n",
+         streams,(unsigned long long)bytes,(unsigned long long)g_messages,
+         (unsigned long long)ingest.wakeups(),t,bytes / t / 1e6,g_messages / t);
+  return 0;
+}
@@ -0,0 +1,289 @@
+/**
+  @file sirfbench.cpp
+
+  SiRF binary parsing benchmark.
+  Generates a synthetic receiver stream and prints results as JSON.
+
+  usage: sirfbench [seconds of receiver output] [MID 41 rate in Hz]
+
+  @author Osamu Takahashi
+*/
+#include <GPS.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#define BENCH_FORMAT_VERSION  1
+
+namespace {
+
+  class NullStream {
+  public:
+    int available() const { return 0; }
+    int read() { return -1; }
+  };
+
+  typedef GPS::SiRF::PacketParser<NullStream> PacketParser;
+
+  uint32_t g_frames = 0;
+
+  void outputHandler(const GPS::SiRF::OutputMessage &) {
+    g_frames++;
+  }
+
+  void viewHandler(const GPS::SiRF::PayloadView &) {
+    g_frames++;
+  }
+
+  uint64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  enum {
+    MIN_DAMAGED = 8   //!< corrupted and cut frames each, at least
+  };
+
+  /**
+    Deterministic corpus, identical across releases for the same arguments.
+    A short corpus is followed by enough damaged frames to have
+    MIN_DAMAGED corrupted and cut frames, so resync is always measured.
+  */
+  class Corpus {
+  public:
+    Corpus(int in_seconds,int in_rate)
+      : m_seed(0x2545f491),
+        m_valid(0),
+        m_corrupted(0),
+        m_partial(0) {
+      for (int s = 0;s < in_seconds;s++) {
+        for (int r = 0;r < in_rate;r++) {
+          _add(GPS::SiRF::GeodeticNavigationDataID,sizeof(GPS::SiRF::GeodeticNavigationData));
+        }
+        _add(GPS::SiRF::MeasureNavigationDataOutID,sizeof(GPS::SiRF::MeasureNavigationDataOut));
+        _add(GPS::SiRF::MeasuredTrackerDataOutID,sizeof(GPS::SiRF::MeasuredTrackerDataOut));
+        _add(GPS::SiRF::ClockStatusDataID,sizeof(GPS::SiRF::ClockStatusData));
+      }
+      while (m_corrupted < MIN_DAMAGED)
+        _add(GPS::SiRF::GeodeticNavigationDataID,sizeof(GPS::SiRF::GeodeticNavigationData),CORRUPT);
+      while (m_partial < MIN_DAMAGED)
+        _add(GPS::SiRF::GeodeticNavigationDataID,sizeof(GPS::SiRF::GeodeticNavigationData),CUT);
+    }
+
+    const uint8_t *data() const { return &m_data[0]; }
+    size_t size() const { return m_data.size(); }
+    uint32_t valid() const { return m_valid; }
+    uint32_t corrupted() const { return m_corrupted; }
+    uint32_t partial() const { return m_partial; }
+    //! start offsets of the valid frames
+    const std::vector<size_t> &frames() const { return m_frames; }
+  private:
+    enum {
+      CORRUPT = 0,
+      CUT = 2,
+      RANDOM = 100
+    };
+
+    std::vector<uint8_t> m_data;
+    std::vector<size_t> m_frames;
+    uint32_t m_seed;
+    uint32_t m_valid;
+    uint32_t m_corrupted;
+    uint32_t m_partial;
+
+    uint32_t _random() {
+      m_seed ^= m_seed << 13;
+      m_seed ^= m_seed >> 17;
+      m_seed ^= m_seed << 5;
+      return m_seed;
+    }
+
+    void _add(int in_messageID,int in_bodyLength,uint32_t in_damage = RANDOM) {
+      uint8_t frame[256];
+      int l = in_bodyLength + 1;
+      frame[0] = 0xa0;
+      frame[1] = 0xa2;
+      frame[2] = l >> 8;
+      frame[3] = l & 0xff;
+      frame[4] = in_messageID;
+      for (int i = 1;i < l;i++)
+        frame[4 + i] = _random();
+      int cs = GPS::util::byteSum(frame + 4,l) & 0x7fff;
+      frame[4 + l] = cs >> 8;
+      frame[5 + l] = cs & 0xff;
+      frame[6 + l] = 0xb0;
+      frame[7 + l] = 0xb3;
+      int n = l + 8;
+
+      uint32_t r = _random() % 100;
+      if (in_damage != RANDOM)
+        r = in_damage;
+      if (r < 2) {
+        // a bit error
+        frame[4 + _random() % l] ^= 1 << (_random() % 8);
+        m_corrupted++;
+      } else
+      if (r < 3) {
+        // cut by a port reset
+        n = 4 + _random() % l;
+        m_partial++;
+      } else {
+        m_frames.push_back(m_data.size());
+        m_valid++;
+      }
+      m_data.insert(m_data.end(),frame,frame + n);
+    }
+  };
+
+  struct Result {
+    const char *name;
+    uint64_t nanos;
+    uint32_t frames;
+    uint32_t resyncs;
+  };
+
+  //! best of three runs
+  Result runFeed(const char *in_name,const uint8_t *in_data,size_t in_size,size_t in_chunk,int in_mode) {
+    Result best = { in_name,~0ULL,0,0 };
+    for (int run = 0;run < 3;run++) {
+      NullStream stream;
+      GPS::SiRF::MessageParser parser;
+      PacketParser packetParser(stream,parser);
+      uint8_t payloadBuffer[256];
+
+      switch(in_mode) {
+        case 0:
+          packetParser.setHandler(outputHandler);
+          break;
+        case 1:
+          packetParser.setHandler(outputHandler);
+          packetParser.setPayloadBuffer(payloadBuffer,sizeof(payloadBuffer));
+          break;
+        case 2:
+          packetParser.setViewHandler(viewHandler);
+          packetParser.setPayloadBuffer(payloadBuffer,sizeof(payloadBuffer));
+          break;
+      }
+
+      g_frames = 0;
+      uint64_t t = nowNanos();
+      for (size_t i = 0;i < in_size;i += in_chunk) {
+        packetParser.feed(in_data + i,std::min(in_chunk,in_size - i));
+      }
+      t = nowNanos() - t;
+      if (t < best.nanos) {
+        best.nanos = t;
+        best.frames = g_frames;
+        best.resyncs = packetParser.resyncs();
+      }
+    }
+    return best;
+  }
+
+  Result runFeed(const char *in_name,const Corpus &in_corpus,size_t in_chunk,int in_mode) {
+    return runFeed(in_name,in_corpus.data(),in_corpus.size(),in_chunk,in_mode);
+  }
+
+  Result runMessageParser(const Corpus &in_corpus) {
+    GPS::SiRF::MessageParser parser;
+    const std::vector<size_t> &frames = in_corpus.frames();
+    uint32_t decoded = 0;
+    uint64_t t = nowNanos();
+    for (size_t i = 0;i < frames.size();i++) {
+      const uint8_t *f = in_corpus.data() + frames[i];
+      decoded += parser.parse(f + 4,(f[2] << 8) | f[3]);
+    }
+    Result res = { "MessageParser::parse",nowNanos() - t,decoded,0 };
+    return res;
+  }
+
+  void printResult(const Result &in_result,size_t in_bytes,bool in_last) {
+    double sec = in_result.nanos / 1e9;
+    printf("    { \"name\": \"%s\", \"frames\": %u, \"resyncs\": %u, \"seconds\": %.6f, "
+           "\"frames_per_sec\": %.0f, \"bytes_per_sec\": %.0f }%s\n",
+           in_result.name,in_result.frames,in_result.resyncs,sec,
+           in_result.frames / sec,in_bytes / sec,in_last ? "" : ",");
+  }
+
+} /* namespace */
+
+int main(int argc,char **argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 20000;
+  int rate = argc > 2 ? atoi(argv[2]) : 5;
+  if (seconds <= 0 || rate < 1 || rate > 10) {
+    fprintf(stderr,"usage: %s [seconds] [MID 41 rate 1-10]\n",argv[0]);
+    return 1;
+  }
+
+  Corpus corpus(seconds,rate);
+
+  Result results[] = {
+    runFeed("feed/whole",corpus,corpus.size(),0),
+    runFeed("feed/64",corpus,64,0),
+    runFeed("feed/64/deferred",corpus,64,1),
+    runFeed("feed/64/view",corpus,64,2),
+    runFeed("feed/1",corpus,1,0),
+    runFeed("feed/1/deferred",corpus,1,1),
+    runMessageParser(corpus)
+  };
+  int n = sizeof(results) / sizeof(results[0]);
+
+  // latency from the last byte of a frame to the handler
+  std::vector<uint32_t> latency;
+  {
+    NullStream stream;
+    GPS::SiRF::MessageParser parser;
+    PacketParser packetParser(stream,parser);
+    packetParser.setHandler(outputHandler);
+    const std::vector<size_t> &frames = corpus.frames();
+    for (size_t i = 0;i < frames.size();i++) {
+      const uint8_t *f = corpus.data() + frames[i];
+      size_t l = ((f[2] << 8) | f[3]) + 8;
+      packetParser.feed(f,l - 1);
+      uint64_t t = nowNanos();
+      packetParser.feed(f + l - 1,1);
+      latency.push_back(nowNanos() - t);
+    }
+    std::sort(latency.begin(),latency.end());
+    if (latency.empty())
+      latency.push_back(0);
+  }
+
+  // extra time per resync, against the same frames without errors
+  double perResync = 0;
+  {
+    std::vector<uint8_t> good;
+    const std::vector<size_t> &frames = corpus.frames();
+    for (size_t i = 0;i < frames.size();i++) {
+      const uint8_t *f = corpus.data() + frames[i];
+      good.insert(good.end(),f,f + ((f[2] << 8) | f[3]) + 8);
+    }
+    Result clean = runFeed("clean",good.empty() ? NULL : &good[0],good.size(),64,1);
+    const Result &noisy = results[2];
+    if (noisy.resyncs > 0)
+      perResync = ((double)noisy.nanos - clean.nanos) / noisy.resyncs;
+  }
+
+  printf("{\n");
+  printf("  \"benchmark\": \"sirf\",\n");
+  printf("  \"format\": %d,\n",BENCH_FORMAT_VERSION);
+  printf("  \"corpus\": { \"seconds\": %d, \"rate_hz\": %d, \"bytes\": %lu, "
+         "\"valid\": %u, \"corrupted\": %u, \"partial\": %u },\n",
+         seconds,rate,(unsigned long)corpus.size(),corpus.valid(),corpus.corrupted(),corpus.partial());
+  printf("  \"throughput\": [\n");
+  for (int i = 0;i < n;i++) {
+    printResult(results[i],corpus.size(),i == n - 1);
+  }
+  printf("  ],\n");
+  printf("  \"latency_ns\": { \"p50\": %u, \"p99\": %u, \"max\": %u },\n",
+         latency[latency.size() / 2],latency[latency.size() * 99 / 100],latency.back());
+  printf("  \"resync_ns\": %.1f\n",perResync);
+  printf("}\n");
+  return 0;
+}
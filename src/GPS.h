@@ -9,5 +9,14 @@
 #include <GPS/nmea.h>
 #include <GPS/sirf.h>
 #include <GPS/util.h>
+#include <GPS/time.h>
+#include <GPS/geodesy.h>
+#include <GPS/demux.h>
+#include <GPS/protocol.h>
+#include <GPS/encoder.h>
+#include <GPS/command.h>
+#include <GPS/rate.h>
+#include <GPS/baud.h>
+#include <GPS/checkpoint.h>
 
 #endif /* __GPS_h */
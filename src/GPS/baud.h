@@ -0,0 +1,227 @@
+/**
+  @file baud.h
+
+  Baud rate upgrade with verification and rollback
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_baud_h
+#define __GPS_baud_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+
+namespace GPS {
+
+  /**
+    Called when an upgrade ends
+    @param in_baud baud rate now in use
+    @param in_reached true if the requested rate was reached
+  */
+  typedef void (*BaudHandler)(long in_baud,bool in_reached);
+
+  /**
+    Steps a receiver up through the standard baud rates.
+    At each step the receiver is commanded ($PSRF100 or MID 134), the
+    local port is reopened and the step is kept once valid sentences
+    (or frames) arrive before the timeout. Otherwise the receiver is
+    commanded back at the new rate and the previous rate is restored.
+
+    Port needs available(), read(), write(), flush() and begin(baud),
+    as HardwareSerial does.
+
+    @param Port serial port class
+  */
+  template<class Port>
+  class BaudNegotiator {
+  public:
+    /**
+      @param in_port serial port, already opened at in_baud
+      @param in_nmea NMEA parser reading in_port
+      @param in_sirf SiRF packet parser reading in_port
+      @param in_baud current baud rate
+      @param in_protocol protocol the receiver is using
+      @param in_timeoutMs time allowed to verify a step
+    */
+    BaudNegotiator(Port &in_port,NMEA::Parser<Port> &in_nmea,SiRF::PacketParser<Port> &in_sirf,
+                   long in_baud,NMEA::ProtocolType in_protocol = NMEA::PROTOCOL_NMEA,
+                   uint32_t in_timeoutMs = 2000)
+      : m_port(in_port),
+        m_nmea(in_nmea),
+        m_sirf(in_sirf),
+        m_nmeaBuilder(in_port),
+        m_sirfBuilder(in_port),
+        m_protocol(in_protocol),
+        m_state(IDLE),
+        m_baud(in_baud),
+        m_next(in_baud),
+        m_target(in_baud),
+        m_timeout(in_timeoutMs),
+        m_deadline(0),
+        m_mark(0),
+        m_required(2),
+        m_failures(0),
+        m_handler(NULL) {
+    }
+
+    void setHandler(BaudHandler in_handler) {
+      m_handler = in_handler;
+    }
+
+    /**
+      @param in_messages valid sentences or frames needed to keep a step
+    */
+    void setRequired(uint8_t in_messages) {
+      m_required = in_messages;
+    }
+
+    /**
+      Start stepping up
+      @param in_baud highest rate wanted, one of rates[]
+      @param in_nowMs current time
+      @return false if busy or already at in_baud
+    */
+    bool upgrade(long in_baud,uint32_t in_nowMs) {
+      if (m_state != IDLE || in_baud <= m_baud)
+        return false;
+      m_target = in_baud;
+      return _step(in_nowMs);
+    }
+
+    /**
+      Parse received data and verify the current step, call from loop()
+      @param in_nowMs current time, millis() on Arduino
+    */
+    void update(uint32_t in_nowMs) {
+      uint32_t count;
+      if (m_protocol == NMEA::PROTOCOL_NMEA) {
+        m_nmea.yyparse();
+        count = m_nmea.messages();
+      } else {
+        m_sirf.polling();
+        count = m_sirf.frames();
+      }
+
+      switch(m_state) {
+        case VERIFY:
+          if (count - m_mark >= m_required) {
+            m_baud = m_next;
+            if (m_baud >= m_target || !_step(in_nowMs))
+              _finish(m_baud >= m_target);
+          } else
+          if (_expired(in_nowMs)) {
+            // the receiver may listen at the new rate without being heard
+            _command(m_baud);
+            _reopen(m_baud);
+            m_mark = _count();
+            m_deadline = in_nowMs + m_timeout;
+            m_failures++;
+            m_state = ROLLBACK;
+          }
+          break;
+        case ROLLBACK:
+          if (count - m_mark >= m_required || _expired(in_nowMs))
+            _finish(false);
+          break;
+      }
+    }
+
+    bool busy() const {
+      return m_state != IDLE;
+    }
+
+    long baud() const {
+      return m_baud;
+    }
+
+    //! number of steps rolled back
+    uint32_t failures() const {
+      return m_failures;
+    }
+
+    enum {
+      RATE_COUNT = 6
+    };
+
+    //! supported rates, ascending
+    static const long rates[RATE_COUNT];
+  private:
+    enum {
+      IDLE,
+      VERIFY,
+      ROLLBACK
+    };
+
+    Port &m_port;
+    NMEA::Parser<Port> &m_nmea;
+    SiRF::PacketParser<Port> &m_sirf;
+    NMEA::CommandBuilder<Port> m_nmeaBuilder;
+    SiRF::CommandBuilder<Port> m_sirfBuilder;
+
+    NMEA::ProtocolType m_protocol;
+    uint8_t m_state;
+    long m_baud;
+    long m_next;
+    long m_target;
+    uint32_t m_timeout;
+    uint32_t m_deadline;
+    uint32_t m_mark;
+    uint8_t m_required;
+    uint32_t m_failures;
+    BaudHandler m_handler;
+
+    bool _step(uint32_t in_nowMs) {
+      m_next = 0;
+      for (int i = 0;i < RATE_COUNT;i++) {
+        if (rates[i] > m_baud && rates[i] <= m_target) {
+          m_next = rates[i];
+          break;
+        }
+      }
+      if (m_next == 0)
+        return false;
+      _command(m_next);
+      _reopen(m_next);
+      m_mark = _count();
+      m_deadline = in_nowMs + m_timeout;
+      m_state = VERIFY;
+      return true;
+    }
+
+    void _command(long in_baud) {
+      if (m_protocol == NMEA::PROTOCOL_NMEA)
+        m_nmeaBuilder.SetSerialPort(NMEA::PROTOCOL_NMEA,in_baud);
+      else
+        m_sirfBuilder.SetBinarySerialPort(in_baud);
+    }
+
+    void _reopen(long in_baud) {
+      m_port.flush();
+      m_port.begin(in_baud);
+    }
+
+    uint32_t _count() const {
+      return m_protocol == NMEA::PROTOCOL_NMEA ? m_nmea.messages() : m_sirf.frames();
+    }
+
+    bool _expired(uint32_t in_nowMs) const {
+      return (int32_t)(in_nowMs - m_deadline) >= 0;
+    }
+
+    void _finish(bool in_reached) {
+      m_state = IDLE;
+      if (m_handler)
+        (*m_handler)(m_baud,in_reached);
+    }
+  };
+
+  template<class Port>
+  const long BaudNegotiator<Port>::rates[RATE_COUNT] = {
+    4800, 9600, 19200, 38400, 57600, 115200
+  };
+
+} /* GPS */
+
+#endif /* __GPS_baud_h */
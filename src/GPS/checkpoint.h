@@ -0,0 +1,147 @@
+/**
+  @file checkpoint.h
+
+  Checkpoint and restore of parser states.
+  The state of a NMEA::Parser, a Demux and a SiRF::PacketParser between
+  two chunks, mid-sentence or mid-frame, is written to a small versioned
+  blob, e.g. to hand a receiver connection to another process. Parsers
+  restored from it continue with the remaining bytes as if they had never
+  stopped.
+
+  Blob layout: 'G' 'C', version, section count, sections of
+  tag, big endian length and data, and a big endian FNV-1a fingerprint
+  of everything before it. The NMEA section is a NMEA::ParserState in
+  host byte order, so blobs move between builds of the same configuration
+  on the same architecture only; a size mismatch is refused.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_checkpoint_h
+#define __GPS_checkpoint_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+#include <GPS/demux.h>
+
+//! largest blob of one Parser, Demux and PacketParser each
+#define CHECKPOINT_MAX_SIZE \
+  (4 + 3 * 3 + sizeof(GPS::NMEA::ParserState) + 16 + 64 + 2 * 9 + \
+   30 + SIRF_RESYNC_WINDOW + 2 * SIRF_MAX_PAYLOAD_LENGTH + 4 + 255 + 4)
+
+namespace GPS {
+
+  enum {
+    CHECKPOINT_VERSION = 2,
+
+    CHECKPOINT_NMEA = 1,
+    CHECKPOINT_DEMUX = 2,
+    CHECKPOINT_SIRF = 3
+  };
+
+  /**
+    Blob writer, one section per parser kind
+    @code
+    uint8_t blob[CHECKPOINT_MAX_SIZE];
+    GPS::CheckpointWriter writer(blob,sizeof(blob));
+    writer.add(parser);
+    writer.add(demux);
+    writer.add(packetParser);
+    size_t length = writer.finish();
+    @endcode
+  */
+  class CheckpointWriter {
+  public:
+    CheckpointWriter(uint8_t *out_blob,size_t in_size);
+
+    void add(const NMEA::ParserState &in_state);
+
+    template<class T>
+    void add(const NMEA::Parser<T> &in_parser) {
+      NMEA::ParserState state;
+      in_parser.save(&state);
+      add(state);
+    }
+
+    template<class T,class S>
+    void add(const Demux<T,S> &in_demux) {
+      uint8_t *p = _begin(CHECKPOINT_DEMUX);
+      _end(p ? in_demux.save(p,_room()) : 0);
+    }
+
+    template<class T>
+    void add(const SiRF::PacketParser<T> &in_parser) {
+      uint8_t *p = _begin(CHECKPOINT_SIRF);
+      _end(p ? in_parser.save(p,_room()) : 0);
+    }
+
+    /**
+      @return blob length, 0 if it did not fit
+    */
+    size_t finish();
+  private:
+    uint8_t *m_blob;
+    size_t m_size;
+    size_t m_length;
+    bool m_failed;
+
+    uint8_t *_begin(uint8_t in_tag);
+    void _end(size_t in_length);
+    size_t _room() const;
+  };
+
+  /**
+    Blob reader. Each restore() sets up a parser from its section;
+    handlers and buffers of the parsers are not part of the blob.
+    @code
+    GPS::CheckpointReader reader(blob,length);
+    if (reader.valid() && reader.restore(&parser) && reader.restore(&demux) && reader.restore(&packetParser))
+      ...
+    @endcode
+  */
+  class CheckpointReader {
+  public:
+    CheckpointReader(const uint8_t *in_blob,size_t in_length);
+
+    //! false if the magic, version, layout or fingerprint is wrong
+    bool valid() const {
+      return m_valid;
+    }
+
+    //! @return false if the blob has no usable NMEA section
+    bool restore(NMEA::ParserState *out_state) const;
+
+    template<class T>
+    bool restore(NMEA::Parser<T> *io_parser) const {
+      NMEA::ParserState state;
+      if (!restore(&state))
+        return false;
+      io_parser->load(state);
+      return true;
+    }
+
+    template<class T,class S>
+    bool restore(Demux<T,S> *io_demux) const {
+      size_t l;
+      const uint8_t *p = _find(CHECKPOINT_DEMUX,&l);
+      return p && io_demux->load(p,l);
+    }
+
+    template<class T>
+    bool restore(SiRF::PacketParser<T> *io_parser) const {
+      size_t l;
+      const uint8_t *p = _find(CHECKPOINT_SIRF,&l);
+      return p && io_parser->load(p,l);
+    }
+  private:
+    const uint8_t *m_blob;
+    size_t m_length;
+    bool m_valid;
+
+    const uint8_t *_find(uint8_t in_tag,size_t *out_length) const;
+  };
+
+} /* GPS */
+
+#endif /* __GPS_checkpoint_h */
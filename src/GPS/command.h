@@ -0,0 +1,314 @@
+/**
+  @file command.h
+
+  Pipelined receiver commands with acknowledgement tracking
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_command_h
+#define __GPS_command_h
+
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+
+//! commands queued or waiting for acknowledgement at once
+#ifndef COMMAND_ENGINE_SLOTS
+#define COMMAND_ENGINE_SLOTS  8
+#endif
+
+namespace GPS {
+
+  /**
+    Called when a command completes
+    @param in_command number returned when the command was queued
+    @param in_acknowledged false if every attempt timed out
+  */
+  typedef void (*CommandHandler)(uint16_t in_command,bool in_acknowledged);
+
+  /**
+    Sends NMEA ($PSRF) and SiRF binary commands without waiting for each
+    other and matches $PSRF154 / MID 11 acknowledgements by command ID.
+    Commands with different IDs are in flight together, a command waits
+    while another one with the same ID is unacknowledged.
+    Unacknowledged commands are resent after the timeout.
+
+    Received messages are passed from the parser handlers to
+    acknowledge(), update() is called from loop().
+
+    @param Port serial port class
+  */
+  template<class Port>
+  class CommandEngine {
+  public:
+    /**
+      @param in_port serial port
+      @param in_timeoutMs time to wait for each acknowledgement
+      @param in_retries attempts after the first one
+    */
+    CommandEngine(Port &in_port,uint32_t in_timeoutMs = 1000,uint8_t in_retries = 2)
+      : m_port(in_port),
+        m_timeout(in_timeoutMs),
+        m_retries(in_retries),
+        m_budget(64),
+        m_sequence(0),
+        m_failures(0),
+        m_handler(NULL) {
+      for (int i = 0;i < COMMAND_ENGINE_SLOTS;i++) {
+        m_slots[i].state = FREE;
+      }
+    }
+
+    void setHandler(CommandHandler in_handler) {
+      m_handler = in_handler;
+    }
+
+    /**
+      Limit output of a single update(), at least one command is sent
+      @param in_bytes bytes, 64 by default
+    */
+    void setPacing(uint16_t in_bytes) {
+      m_budget = in_bytes;
+    }
+
+    /**
+      Queue SetSerialPort ($PSRF100)
+      @return command number, -1 if the queue is full
+      @see NMEA::CommandBuilder::SetSerialPort
+    */
+    int32_t setSerialPort(NMEA::ProtocolType in_protocol,int in_baud,int in_dataBits = 8,int in_stopBits = 1,int in_parity = 0) {
+      Slot *s = _allocate(100);
+      if (s == NULL)
+        return -1;
+      NMEA::CommandBuilder<Slot> builder(*s);
+      builder.SetSerialPort(in_protocol,in_baud,in_dataBits,in_stopBits,in_parity);
+      return s->command;
+    }
+
+    /**
+      Queue QueryRateControl ($PSRF103)
+      @return command number, -1 if the queue is full
+      @see NMEA::CommandBuilder::QueryRateControl
+    */
+    int32_t queryRateControl(NMEA::MessageType in_message,NMEA::QueryRateControlMode in_mode,int in_rate,int in_checksumEnable) {
+      Slot *s = _allocate(103);
+      if (s == NULL)
+        return -1;
+      NMEA::CommandBuilder<Slot> builder(*s);
+      builder.QueryRateControl(in_message,in_mode,in_rate,in_checksumEnable);
+      return s->command;
+    }
+
+    /**
+      Queue Set Binary Serial Port (MID 134)
+      @return command number, -1 if the queue is full
+    */
+    int32_t setBinarySerialPort(int32_t in_bitRate,int in_dataBits = 8,int in_stopBit = 1,int in_parity = 0) {
+      Slot *s = _allocate(SiRF::SetBinarySerialPortID);
+      if (s == NULL)
+        return -1;
+      SiRF::CommandBuilder<Slot> builder(*s);
+      builder.SetBinarySerialPort(in_bitRate,in_dataBits,in_stopBit,in_parity);
+      return s->command;
+    }
+
+    /**
+      Queue Set Protocol (MID 135)
+      @return command number, -1 if the queue is full
+    */
+    int32_t setProtocol(SiRF::Protocol in_protocol) {
+      Slot *s = _allocate(SiRF::SetProtocolID);
+      if (s == NULL)
+        return -1;
+      SiRF::CommandBuilder<Slot> builder(*s);
+      builder.SetProtocol(in_protocol);
+      return s->command;
+    }
+
+    /**
+      Queue Set Message Rate (MID 166)
+      @return command number, -1 if the queue is full
+    */
+    int32_t setMessageRate(int in_mode,int in_messageIDToBeSet,int in_updateRate) {
+      Slot *s = _allocate(SiRF::SetMessageRateID);
+      if (s == NULL)
+        return -1;
+      SiRF::CommandBuilder<Slot> builder(*s);
+      builder.SetMessageRate(in_mode,in_messageIDToBeSet,in_updateRate);
+      return s->command;
+    }
+
+    /**
+      Match a $PSRF154 acknowledgement
+      @param in_msg any decoded NMEA message
+      @return true if a command completed
+    */
+    bool acknowledge(const NMEA::Message &in_msg) {
+#ifdef NMEA_USE_154
+      if (in_msg.messageID == NMEA_PSRF154)
+        return _acknowledge((uint8_t)in_msg.eeAck.ackID);
+#endif
+      return false;
+    }
+
+    /**
+      Match a Command Acknowledgment (MID 11)
+      @param in_msg any decoded SiRF output message
+      @return true if a command completed
+    */
+    bool acknowledge(const SiRF::OutputMessage &in_msg) {
+#ifdef SIRF_USE_11
+      if (in_msg.messageID == SiRF::CommandAcknowledgmentID)
+        return _acknowledge(in_msg.messageBody.commandAcknowledgment.ackID);
+#endif
+      return false;
+    }
+
+    /**
+      Send queued commands and resend or fail timed out ones
+      @param in_nowMs current time, millis() on Arduino
+    */
+    void update(uint32_t in_nowMs) {
+      int budget = m_budget;
+      bool sent = false;
+
+      for (int i = 0;i < COMMAND_ENGINE_SLOTS;i++) {
+        Slot &s = m_slots[i];
+        if (s.state == SENT && (int32_t)(in_nowMs - s.deadline) >= 0) {
+          if (s.attempts > m_retries) {
+            m_failures++;
+            _complete(s,false);
+            continue;
+          }
+          // resend below, from the same slot
+          s.state = QUEUED;
+        }
+      }
+
+      // oldest first, so commands with the same ID keep their order
+      for (;;) {
+        Slot *s = _nextToSend();
+        if (s == NULL || (sent && s->length > budget))
+          break;
+        m_port.write((const uint8_t *)s->data,s->length);
+        budget -= s->length;
+        sent = true;
+        s->state = SENT;
+        s->attempts++;
+        s->deadline = in_nowMs + m_timeout;
+      }
+    }
+
+    //! commands queued or waiting for acknowledgement
+    int pending() const {
+      int n = 0;
+      for (int i = 0;i < COMMAND_ENGINE_SLOTS;i++) {
+        n += m_slots[i].state != FREE;
+      }
+      return n;
+    }
+
+    //! number of commands given up
+    uint32_t failures() const {
+      return m_failures;
+    }
+  private:
+    enum {
+      FREE,
+      QUEUED,
+      SENT
+    };
+
+    /**
+      A queued command, also the output port of the command builders
+    */
+    struct Slot {
+      uint8_t state;
+      uint8_t ackID;
+      uint8_t attempts;
+      uint8_t length;
+      uint16_t command;
+      uint32_t deadline;
+      char data[NMEA_MAX_SENTENCE_LENGTH + 5];
+
+      void write(uint8_t in_c) {
+        if (length < sizeof(data))
+          data[length++] = in_c;
+      }
+      void write(const uint8_t *in_data,int in_length) {
+        for (int i = 0;i < in_length;i++)
+          write(in_data[i]);
+      }
+      void write(const char *in_data,int in_length) {
+        write((const uint8_t *)in_data,in_length);
+      }
+    };
+
+    Port &m_port;
+    uint32_t m_timeout;
+    uint8_t m_retries;
+    uint16_t m_budget;
+    uint16_t m_sequence;
+    uint32_t m_failures;
+    CommandHandler m_handler;
+    Slot m_slots[COMMAND_ENGINE_SLOTS];
+
+    Slot *_allocate(uint8_t in_ackID) {
+      for (int i = 0;i < COMMAND_ENGINE_SLOTS;i++) {
+        Slot &s = m_slots[i];
+        if (s.state == FREE) {
+          s.state = QUEUED;
+          s.ackID = in_ackID;
+          s.attempts = 0;
+          s.length = 0;
+          s.command = m_sequence++;
+          return &s;
+        }
+      }
+      return NULL;
+    }
+
+    bool _inFlight(uint8_t in_ackID) const {
+      for (int i = 0;i < COMMAND_ENGINE_SLOTS;i++) {
+        if (m_slots[i].state == SENT && m_slots[i].ackID == in_ackID)
+          return true;
+      }
+      return false;
+    }
+
+    //! oldest queued command whose ID is not in flight
+    Slot *_nextToSend() {
+      Slot *next = NULL;
+      for (int i = 0;i < COMMAND_ENGINE_SLOTS;i++) {
+        Slot &s = m_slots[i];
+        if (s.state == QUEUED && !_inFlight(s.ackID) &&
+            (next == NULL || (int16_t)(s.command - next->command) < 0)) {
+          next = &s;
+        }
+      }
+      return next;
+    }
+
+    bool _acknowledge(uint8_t in_ackID) {
+      for (int i = 0;i < COMMAND_ENGINE_SLOTS;i++) {
+        Slot &s = m_slots[i];
+        if (s.state == SENT && s.ackID == in_ackID) {
+          _complete(s,true);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void _complete(Slot &io_slot,bool in_acknowledged) {
+      io_slot.state = FREE;
+      if (m_handler)
+        (*m_handler)(io_slot.command,in_acknowledged);
+    }
+  };
+
+} /* GPS */
+
+#endif /* __GPS_command_h */
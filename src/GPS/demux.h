@@ -0,0 +1,299 @@
+/**
+  @file demux.h
+
+  Splits a serial stream carrying both NMEA sentences
+  and SiRF binary frames.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_demux_h
+#define __GPS_demux_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/sirf.h>
+
+namespace GPS {
+
+  /**
+    Demultiplexer of NMEA text and SiRF binary frames.
+    It is the input stream of a NMEA::Parser; while the parser asks for
+    text, binary frames found on the way are handed to the SiRF side
+    in runs with feed(). Bytes are read once and never queued for the
+    other protocol.
+    A frame is trusted for the length it announces, unless a sentence
+    start ("$GPxxx," or "$PSRFnnn,") shows up inside it: the frame was
+    cut short then, and the text from the '$' on goes to the parser.
+    Up to 9 bytes after a '$' are held while this is decided.
+
+    @code
+    GPS::SiRF::MessageParser sirfParser;
+    GPS::SiRF::PacketParser<HardwareSerial> packetParser(Serial,sirfParser);
+    GPS::Demux<HardwareSerial,GPS::SiRF::PacketParser<HardwareSerial> > demux(Serial,packetParser);
+    GPS::NMEA::Parser<GPS::Demux<HardwareSerial,GPS::SiRF::PacketParser<HardwareSerial> > > parser(demux);
+    ...
+    parser.yyparse();
+    @endcode
+
+    @param T input stream class
+    @param S binary sink, SiRF::PacketParser or a class with feed(const uint8_t*,size_t) and cut()
+  */
+  template<class T,class S>
+  class Demux {
+  public:
+    Demux(T &in_serial,S &in_sirf)
+      : m_serial(in_serial),
+        m_sirf(in_sirf),
+        m_state(TEXT),
+        m_remain(0),
+        m_text(-1),
+        m_binaryLength(0),
+        m_probeLength(0),
+        m_replayPos(0),
+        m_replayLength(0),
+        m_textBytes(0),
+        m_binaryBytes(0) {
+
+    }
+
+    /**
+      Route received bytes until a text byte is ready
+      @return 1 if a text byte is ready, otherwise 0
+    */
+    int available() {
+      if (m_text >= 0)
+        return 1;
+      for (;;) {
+        int c;
+        if (m_replayPos < m_replayLength)
+          c = m_replay[m_replayPos++];
+        else
+        if (m_serial.available())
+          c = m_serial.read();
+        else
+          break;
+        if (_classify(c)) {
+          m_text = c;
+          break;
+        }
+      }
+      _flush();
+      return m_text >= 0;
+    }
+
+    //! next text byte or -1
+    int read() {
+      if (m_text < 0 && !available())
+        return -1;
+      int c = m_text;
+      m_text = -1;
+      m_textBytes++;
+      return c;
+    }
+
+    //! true while inside a binary frame
+    bool inBinaryFrame() const {
+      return m_state != TEXT;
+    }
+
+    uint32_t textBytes() const {
+      return m_textBytes;
+    }
+
+    uint32_t binaryBytes() const {
+      return m_binaryBytes;
+    }
+
+    /**
+      Copy the state between two chunks, fields are stored big endian.
+      The binary sink is saved on its own.
+      @param out_data destination
+      @param in_size out_data size
+      @return bytes written, 0 if in_size is too small
+    */
+    size_t save(uint8_t *out_data,size_t in_size) const {
+      uint8_t replay = m_replayLength - m_replayPos;
+      size_t l = STATE_HEADER_SIZE + m_binaryLength + m_probeLength + replay;
+      if (in_size < l)
+        return 0;
+      out_data[0] = m_state;
+      util::writeBE16(out_data + 1,m_remain);
+      util::writeBE16(out_data + 3,(uint16_t)m_text);
+      util::writeBE32(out_data + 5,m_textBytes);
+      util::writeBE32(out_data + 9,m_binaryBytes);
+      out_data[13] = m_binaryLength;
+      out_data[14] = m_probeLength;
+      out_data[15] = replay;
+      uint8_t *p = out_data + STATE_HEADER_SIZE;
+      memcpy(p,m_binary,m_binaryLength); p += m_binaryLength;
+      memcpy(p,m_probe,m_probeLength); p += m_probeLength;
+      memcpy(p,m_replay + m_replayPos,replay);
+      return l;
+    }
+
+    /**
+      Continue from a state saved by save()
+      @return false if in_data is not a valid state, nothing is changed then
+    */
+    bool load(const uint8_t *in_data,size_t in_length) {
+      if (in_length < STATE_HEADER_SIZE || in_data[0] > BODY ||
+          in_data[13] > BINARY_BUFFER_SIZE || in_data[14] >= PROBE_SIZE || in_data[15] > PROBE_SIZE ||
+          (in_data[14] > 0 && in_data[0] != BODY) ||
+          in_length != (size_t)STATE_HEADER_SIZE + in_data[13] + in_data[14] + in_data[15])
+        return false;
+      m_state = in_data[0];
+      m_remain = util::readBE16(in_data + 1);
+      m_text = (int16_t)util::readBE16(in_data + 3);
+      m_textBytes = util::readBE32(in_data + 5);
+      m_binaryBytes = util::readBE32(in_data + 9);
+      m_binaryLength = in_data[13];
+      m_probeLength = in_data[14];
+      m_replayPos = 0;
+      m_replayLength = in_data[15];
+      const uint8_t *p = in_data + STATE_HEADER_SIZE;
+      memcpy(m_binary,p,m_binaryLength); p += m_binaryLength;
+      memcpy(m_probe,p,m_probeLength); p += m_probeLength;
+      memcpy(m_replay,p,m_replayLength);
+      return true;
+    }
+  private:
+    enum {
+      TEXT,
+      SYNC,
+      LENGTH_HI,
+      LENGTH_LO,
+      BODY,
+
+      BINARY_BUFFER_SIZE = 64,
+      PROBE_SIZE = 9,           //!< longest sentence start, "$PSRF100,"
+      STATE_HEADER_SIZE = 16    //!< fixed part of save()
+    };
+
+    T &m_serial;
+    S &m_sirf;
+    uint8_t m_state;
+    uint16_t m_remain;
+    int16_t m_text;
+    uint8_t m_binary[BINARY_BUFFER_SIZE];
+    uint8_t m_binaryLength;
+    uint8_t m_probe[PROBE_SIZE];    //!< '$' and what follows inside a frame
+    uint8_t m_probeLength;
+    uint8_t m_replay[PROBE_SIZE];   //!< probed bytes to classify again
+    uint8_t m_replayPos;
+    uint8_t m_replayLength;
+    uint32_t m_textBytes;
+    uint32_t m_binaryBytes;
+
+    void _binary(uint8_t c) {
+      if (m_binaryLength == BINARY_BUFFER_SIZE)
+        _flush();
+      m_binary[m_binaryLength++] = c;
+      m_binaryBytes++;
+    }
+
+    void _flush() {
+      if (m_binaryLength > 0) {
+        m_sirf.feed(m_binary,m_binaryLength);
+        m_binaryLength = 0;
+      }
+    }
+
+    //! @return 1 if m_probe starts a sentence, 0 if it still may, -1 if not
+    int _sentence() const {
+      // 'A' is any capital letter, '9' any digit
+      static const char *const PATTERNS[] = { "$GPAAA,","$PSRF999," };
+      int result = -1;
+      for (size_t i = 0;i < sizeof(PATTERNS) / sizeof(PATTERNS[0]);i++) {
+        const char *p = PATTERNS[i];
+        int j = 0;
+        for (;j < m_probeLength && p[j];j++) {
+          uint8_t c = m_probe[j];
+          if (p[j] == 'A' ? c < 'A' || c > 'Z' : p[j] == '9' ? c < '0' || c > '9' : c != p[j])
+            break;
+        }
+        if (p[j] == 0)
+          return 1;
+        if (j == m_probeLength)
+          result = 0;
+      }
+      return result;
+    }
+
+    /*
+      The probed bytes are classified again, as text from the '$' on
+      if they start a sentence, otherwise from the byte after the '$'
+    */
+    void _resolve(bool in_sentence) {
+      int from = 0;
+      if (in_sentence) {
+        m_state = TEXT;
+        _flush();
+        m_sirf.cut();
+      } else {
+        _binary(m_probe[0]);
+        if (--m_remain == 0)
+          m_state = TEXT;
+        from = 1;
+      }
+      // ahead of the bytes still to replay, together no more than PROBE_SIZE
+      uint8_t n = m_probeLength - from;
+      uint8_t rest = m_replayLength - m_replayPos;
+      memmove(m_replay + n,m_replay + m_replayPos,rest);
+      memcpy(m_replay,m_probe + from,n);
+      m_replayPos = 0;
+      m_replayLength = n + rest;
+      m_probeLength = 0;
+    }
+
+    /*
+      @return true if c is text
+    */
+    bool _classify(int c) {
+      switch(m_state) {
+        case TEXT:
+          if (c != 0xa0)
+            return true;
+          m_state = SYNC;
+          _binary(c);
+          return false;
+        case SYNC:
+          if (c != 0xa2) {
+            // a lone 0xa0, let the SiRF side discard it
+            m_state = TEXT;
+            return _classify(c);
+          }
+          m_state = LENGTH_HI;
+          break;
+        case LENGTH_HI:
+          m_remain = c << 8;
+          m_state = c <= 0x7f ? LENGTH_LO : TEXT;
+          break;
+        case LENGTH_LO:
+          m_remain |= c;
+          if (m_remain > SIRF_MAX_PAYLOAD_LENGTH) {
+            m_state = TEXT;
+          } else {
+            m_remain += 4;  // checksum and end sequence
+            m_state = BODY;
+          }
+          break;
+        case BODY:
+          if (m_probeLength > 0 || c == '$') {
+            m_probe[m_probeLength++] = c;
+            int sentence = _sentence();
+            if (sentence != 0)
+              _resolve(sentence > 0);
+            return false;
+          }
+          if (--m_remain == 0)
+            m_state = TEXT;
+          break;
+      }
+      _binary(c);
+      return false;
+    }
+  };
+
+} /* GPS */
+
+#endif /* __GPS_demux_h */
@@ -0,0 +1,81 @@
+/**
+  @file encoder.h
+
+  NMEA sentence encoder, the inverse of NMEA::Parser.
+  Decoded structures are formatted with integers only and
+  appended with checksum and CR LF to a caller buffer.
+  Fields filled with 0xff are written empty.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_encoder_h
+#define __GPS_encoder_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+
+//! space reserved for a sentence, longer than NMEA allows for out of range values,
+//! NMEA_USE_FLOAT fields are clamped to the integer range of the fixed point types
+#define NMEA_ENCODER_SENTENCE_SIZE  128
+
+namespace GPS {
+
+namespace NMEA {
+
+  /**
+    NMEA sentence encoder
+    Each encode() appends one sentence to the buffer and returns its length,
+    or 0 if the message type is not supported or the buffer is full.
+    The buffer is not null terminated.
+  */
+  class Encoder {
+  public:
+    /**
+      A constructor
+      @param out_buffer output buffer
+      @param in_size size of out_buffer
+    */
+    Encoder(char *out_buffer,size_t in_size)
+      : m_buffer(out_buffer),
+        m_size(in_size),
+        m_length(0) {
+    }
+
+    /**
+      Encode a decoded message, GGA, GSA, GSV, RMC, VTG or ZDA
+      @param in_msg message from NMEA::Parser
+      @return length of the sentence
+    */
+    size_t encode(const Message &in_msg);
+
+    size_t encode(const GGA &in_gga);
+    size_t encode(const GSA &in_gsa);
+    size_t encode(const GSV &in_gsv);
+    size_t encode(const RMC &in_rmc);
+    size_t encode(const VTG &in_vtg);
+    size_t encode(const ZDA &in_zda);
+
+    //! encoded sentences
+    const char *data() const { return m_buffer; }
+    //! bytes used
+    size_t length() const { return m_length; }
+    //! bytes left
+    size_t remaining() const { return m_size - m_length; }
+    //! start over at the beginning of the buffer
+    void clear() { m_length = 0; }
+  private:
+    char *m_buffer;
+    size_t m_size;
+    size_t m_length;
+    char m_scratch[NMEA_ENCODER_SENTENCE_SIZE];
+
+    char *_begin(const char *in_prefix);
+    size_t _end(char *in_start,char *in_p);
+  };
+
+} /* NMEA */
+
+} /* GPS */
+
+#endif /* __GPS_encoder_h */
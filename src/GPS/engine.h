@@ -0,0 +1,80 @@
+/**
+  @file engine.h
+
+  Parser engine for detached parser states.
+  One engine per thread advances any number of streams whose
+  NMEA::ParserState live elsewhere, e.g. in an array indexed by stream.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_engine_h
+#define __GPS_engine_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+
+namespace GPS {
+
+namespace NMEA {
+
+  /**
+    Called for each sentence of a stream
+    @param in_stream stream ID given to Engine::feed()
+    @param in_msg parsed message
+  */
+  typedef void (*StreamHandler)(uint32_t in_stream,const Message &in_msg);
+
+  /**
+    Stateless parser engine.
+    feed() loads a state, parses a chunk and stores the state back,
+    so a stream may be fed by a different engine (thread) each time,
+    but not by two at once.
+    @code
+    GPS::NMEA::ParserState *states = new GPS::NMEA::ParserState[streams];
+    GPS::NMEA::Engine::reset(&states[id]);
+    ...
+    engine.feed(id,&states[id],chunk,length);
+    @endcode
+  */
+  class Engine {
+  public:
+    Engine();
+
+    void setHandler(StreamHandler in_handler) {
+      m_handler = in_handler;
+    }
+
+    /**
+      Initialize a state, as a new Parser
+    */
+    static void reset(ParserState *out_state);
+
+    /**
+      Parse a chunk of a stream, not to be called from the handler
+      @param in_stream stream ID passed to the handler
+      @param io_state state of the stream
+      @param in_data received bytes
+      @param in_length bytes
+    */
+    void feed(uint32_t in_stream,ParserState *io_state,const uint8_t *in_data,size_t in_length);
+  private:
+    util::ChunkStream m_stream;
+    Parser<util::ChunkStream> m_parser;
+    StreamHandler m_handler;
+    uint32_t m_current;
+
+    //! engine feeding on this thread, ParserHandler carries no user data
+    static thread_local Engine *s_engine;
+
+    static void _handler(const Message &in_msg);
+
+    Engine(const Engine &);
+    Engine &operator=(const Engine &);
+  };
+
+} /* NMEA */
+
+} /* GPS */
+
+#endif /* __GPS_engine_h */
@@ -0,0 +1,159 @@
+/**
+  @file ingest.h
+
+  epoll driven ingestion of many receiver streams on Linux.
+  Serial devices, ptys and sockets are registered with one epoll set;
+  each readable fd is read in large chunks which are fed to that
+  stream's parsers. One thread serves every stream and sleeps in
+  epoll_wait() while nothing is readable.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_ingest_h
+#define __GPS_ingest_h
+
+#ifdef __linux__
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+#include <GPS/demux.h>
+
+//! epoll events taken per poll()
+#ifndef INGEST_EVENTS
+#define INGEST_EVENTS   256
+#endif
+
+namespace GPS {
+
+  /**
+    Called for each NMEA sentence of a stream
+    @param in_stream stream ID returned by EpollIngest::add()
+    @param in_msg parsed message
+  */
+  typedef void (*StreamMessageHandler)(uint32_t in_stream,const NMEA::Message &in_msg);
+
+  /**
+    Called for each SiRF output message of a stream
+  */
+  typedef void (*StreamOutputHandler)(uint32_t in_stream,const SiRF::OutputMessage &in_msg);
+
+  /**
+    Called once when a stream reaches end of file or a read error,
+    it is no longer polled but keeps its ID until remove()
+  */
+  typedef void (*StreamClosedHandler)(uint32_t in_stream);
+
+  /**
+    Per stream counters
+  */
+  struct StreamStats {
+    uint64_t  bytes;      //!< bytes read
+    uint32_t  reads;      //!< chunks read
+    uint32_t  messages;   //!< valid NMEA sentences
+    uint32_t  frames;     //!< valid SiRF frames
+    uint32_t  discarded;  //!< bytes outside valid SiRF frames
+  };
+
+  /**
+    Ingestion driver.
+    Each stream owns a Demux, a NMEA::Parser and a SiRF::PacketParser, so
+    a stream may carry NMEA, SiRF binary or both. Handlers run on the
+    thread calling poll(). fds are made non-blocking and are not closed
+    by the driver.
+    @code
+    GPS::EpollIngest ingest(4096);
+    uint32_t id = ingest.add(fd,nmeaHandler,sirfHandler);
+    for (;;)
+      ingest.poll(-1);
+    @endcode
+  */
+  class EpollIngest {
+  public:
+    /**
+      @param in_maxStreams number of stream IDs
+      @param in_chunkSize bytes read from a fd at once
+    */
+    EpollIngest(uint32_t in_maxStreams,size_t in_chunkSize = 16384);
+    ~EpollIngest();
+
+    //! false if epoll or memory could not be set up
+    bool valid() const { return m_epoll >= 0 && m_streams != NULL && m_free != NULL && m_chunk != NULL; }
+
+    /**
+      Register a fd
+      @param in_fd readable fd
+      @param in_nmea sentence handler or NULL
+      @param in_sirf binary message handler or NULL
+      @param in_context user data returned by context()
+      @return stream ID or -1 if the table is full or epoll refused in_fd
+    */
+    int32_t add(int in_fd,StreamMessageHandler in_nmea,StreamOutputHandler in_sirf,void *in_context = NULL);
+
+    /**
+      Unregister a stream and release its ID.
+      A handler may remove its own stream, it gets no further messages
+      and the ID is released when the chunk has been parsed.
+    */
+    void remove(uint32_t in_stream);
+
+    /**
+      Wait for readable streams and parse what they received
+      @param in_timeoutMs epoll_wait() timeout, -1 waits forever
+      @return number of streams serviced, -1 on error
+    */
+    int poll(int in_timeoutMs);
+
+    void setClosedHandler(StreamClosedHandler in_handler) {
+      m_closedHandler = in_handler;
+    }
+
+    //! counters of a stream, NULL if in_stream is not in use
+    const StreamStats *stats(uint32_t in_stream) const;
+
+    void *context(uint32_t in_stream) const;
+
+    //! true while the stream is polled
+    bool open(uint32_t in_stream) const;
+
+    //! number of registered streams
+    uint32_t streams() const {
+      return m_count;
+    }
+
+    //! number of epoll_wait() returns with events
+    uint64_t wakeups() const {
+      return m_wakeups;
+    }
+  private:
+    struct Stream;
+
+    int m_epoll;
+    uint32_t m_maxStreams;
+    uint32_t m_count;
+    Stream **m_streams;
+    uint32_t *m_free;       //!< stack of unused IDs
+    uint32_t m_freeCount;
+    uint8_t *m_chunk;
+    size_t m_chunkSize;
+    uint64_t m_wakeups;
+    StreamClosedHandler m_closedHandler;
+
+    //! stream being fed on this thread, parser handlers carry no user data
+    static thread_local Stream *s_current;
+
+    void _service(uint32_t in_stream);
+    void _close(Stream *io_stream);
+    static void _nmeaHandler(const NMEA::Message &in_msg);
+    static void _sirfHandler(const SiRF::OutputMessage &in_msg);
+
+    EpollIngest(const EpollIngest &);
+    EpollIngest &operator=(const EpollIngest &);
+  };
+
+} /* GPS */
+
+#endif /* __linux__ */
+
+#endif /* __GPS_ingest_h */
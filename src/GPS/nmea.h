@@ -65,6 +65,7 @@
 #define NMEA_NUM       NMEA_TOKEN(-2)
 #define NMEA_FLT_NUM   NMEA_TOKEN(-3)
 #define NMEA_HEX8      NMEA_TOKEN(-4)
+#define NMEA_OVERFLOW  NMEA_TOKEN(-5)
 
 #define NMEA_STATE_MASK 0x07ff
 
@@ -126,9 +127,9 @@ namespace NMEA {
   */
   struct GGA {
     UTCTime       utcTime;
-    decimal1616_t latitude;         //!< .4 format
+    coordinate_t  latitude;         //!< .4 format, or 1e-7 degrees
     int8_t        nsIndicator;
-    decimal1616_t longitude;        //!< .4 format
+    coordinate_t  longitude;        //!< .4 format, or 1e-7 degrees
     int8_t        ewIndicator;
     int8_t        positionFixIndicator;
     int8_t        satelitesUsed;
@@ -148,9 +149,9 @@ namespace NMEA {
     @see decimal1616_t
   */
   struct GLL {
-    decimal1616_t latitude;
+    coordinate_t  latitude;
     int8_t        nsIndicator;
-    decimal1616_t longitude;
+    coordinate_t  longitude;
     int8_t        ewIndicator;
     UTCTime       utcTime;
     int8_t        status;
@@ -212,9 +213,9 @@ namespace NMEA {
   struct RMC {
     UTCTime       utcTime;
     int8_t        status;
-    decimal1616_t latitude;
+    coordinate_t  latitude;
     int8_t        nsIndicator;
-    decimal1616_t longitude;
+    coordinate_t  longitude;
     int8_t        ewIndicator;
     decimal168_t  speedOverGround;
     decimal168_t  courseOverGround;
@@ -271,7 +272,7 @@ namespace NMEA {
   struct _151 {
     uint8_t       gpsTimeValidFlag;
     uint16_t      gpsWeek;
-    uint16_t      gpsTOW;
+    uint32_t      gpsTOW;         //!< seconds
     uint32_t      ephReqMask;
   } __attribute__((__packed__));
 
@@ -342,6 +343,106 @@ namespace NMEA {
   //! ParserHandler function type
   typedef void (*ParserHandler)(const Message &);
 
+#ifndef NMEA_CHANGE_FILTER_GSV_PAGES
+#define NMEA_CHANGE_FILTER_GSV_PAGES  4
+#endif
+
+  /**
+    Change detection stage
+    Compares each decoded message with the last one of the same type
+    and suppresses identical ones. GSV pages are tracked separately.
+    @see Parser::setFilter
+  */
+  class ChangeFilter {
+  public:
+    ChangeFilter()
+      : m_enabled(0xffff),
+        m_maxSuppressed(0) {
+      reset();
+    }
+
+    /**
+      Enable or disable change detection for a message type
+      @param in_messageID NMEA message ID
+      @param in_enable false to always pass the message type
+    */
+    void enable(uint8_t in_messageID,bool in_enable) {
+      if (in_enable)
+        m_enabled |= (1 << in_messageID);
+      else
+        m_enabled &= ~(1 << in_messageID);
+    }
+
+    /**
+      Coalesce runs of identical messages instead of dropping them
+      @param in_max pass an identical message after this many suppressions, 0 = never
+    */
+    void setMaxSuppressed(uint16_t in_max) {
+      m_maxSuppressed = in_max;
+    }
+
+    /**
+      Filter a decoded message
+      @param in_msg decoded message
+      @return true if the message should be delivered
+    */
+    bool pass(const Message &in_msg) {
+      uint8_t id = in_msg.messageID;
+      if (id > NMEA_PSRF155 || !(m_enabled & (1 << id)))
+        return true;
+
+      int slot = id;
+#ifdef NMEA_USE_GSV
+      if (id == NMEA_GPGSV) {
+        int n = in_msg.gsv.messageNumber;
+        if (n < 1 || n > NMEA_CHANGE_FILTER_GSV_PAGES)
+          return true;
+        slot = NMEA_PSRF155 + n;
+      }
+#endif
+      uint32_t fp = util::fingerprint(&in_msg,sizeof(Message));
+      if ((m_seen & (1UL << slot)) && m_fingerprint[slot] == fp) {
+        if (m_maxSuppressed == 0 || m_run[slot] < m_maxSuppressed) {
+          m_run[slot]++;
+          m_suppressed[id]++;
+          return false;
+        }
+      }
+      m_seen |= (1UL << slot);
+      m_fingerprint[slot] = fp;
+      m_run[slot] = 0;
+      return true;
+    }
+
+    /**
+      @param in_messageID NMEA message ID
+      @return number of suppressed messages of the type
+    */
+    uint32_t suppressed(uint8_t in_messageID) const {
+      return in_messageID <= NMEA_PSRF155 ? m_suppressed[in_messageID] : 0;
+    }
+
+    /**
+      Forget the last messages and clear counters
+    */
+    void reset() {
+      m_seen = 0;
+      memset(m_run,0,sizeof(m_run));
+      memset(m_suppressed,0,sizeof(m_suppressed));
+    }
+  private:
+    enum {
+      SLOTS = NMEA_PSRF155 + NMEA_CHANGE_FILTER_GSV_PAGES + 1
+    };
+
+    uint16_t m_enabled;
+    uint16_t m_maxSuppressed;
+    uint32_t m_seen;
+    uint32_t m_fingerprint[SLOTS];
+    uint16_t m_run[SLOTS];
+    uint32_t m_suppressed[NMEA_PSRF155 + 1];
+  };
+
   /**
     NMEA command output class
     @param T output stream class
@@ -367,9 +468,9 @@ namespace NMEA {
       @see ProtocolType
     */
     void SetSerialPort(ProtocolType protocolType,int baud,int dataBits = 8,int stopBits = 1,int parity = 0) {
-      m_port.begin();
+      enum { PREFIX_CHECKSUM = util::nmeaChecksum("PSRF100,") };
+      m_port.begin("$PSRF100,",9,PREFIX_CHECKSUM);
       m_port
-        << "$PSRF100,"
         << protocolType
         << ","
         << baud
@@ -392,9 +493,9 @@ namespace NMEA {
       @see QueryRateControlMode
     */
     void QueryRateControl(MessageType message,QueryRateControlMode mode,int rate,int checksumEnable) {
-      m_port.begin();
+      enum { PREFIX_CHECKSUM = util::nmeaChecksum("PSRF103,") };
+      m_port.begin("$PSRF103,",9,PREFIX_CHECKSUM);
       m_port
-        << "$PSRF103,"
         << message
         << ","
         << mode
@@ -403,7 +504,6 @@ namespace NMEA {
         << ","
         << checksumEnable;
       m_port.end();
-
     }
   private:
     util::PortWrapper<Port> m_port;
@@ -421,6 +521,29 @@ namespace NMEA {
   extern const uint8_t yy_def[];
   extern const uint8_t yy_chk[];
 
+  /**
+    Parser state detached from its stream, plain data.
+    Everything a Parser carries between two bytes: the lexer DFA state,
+    bytes of the token in progress, checksums, the parser state and the
+    partially decoded message. States may be kept in an array indexed
+    by stream and copied with memcpy.
+    @see Parser::save
+    @see Parser::load
+  */
+  struct ParserState {
+    uint8_t   lexerState;
+    uint8_t   lastAcceptingState;
+    uint8_t   lastAcceptingPosition;
+    uint8_t   checksum;
+    uint8_t   lastChecksum;
+    uint8_t   position;       //!< position in token
+    uint8_t   length;         //!< bytes in token
+    uint16_t  parserState;
+    uint32_t  messages;       //!< sentences parsed completely
+    int8_t    token[MAX_STRING_INPUT_BUFFER_SIZE];
+    Message   message;
+  } __attribute__((__packed__));
+
   /**
     NMEA Lexer class, internal use
   */
@@ -432,7 +555,8 @@ namespace NMEA {
         m_checksum(0),
         m_last_checksum(0) {
         yy_current_state = 0;
-
+        yy_last_accepting_state = 0;
+        yy_last_accepting_cpos = 0;
       }
 
     int yylex();
@@ -446,6 +570,26 @@ namespace NMEA {
     const GPS::util::StringInputBuffer<T> &buffer() const {
       return m_buffer;
     }
+
+    void save(ParserState *out_state) const {
+      out_state->lexerState = yy_current_state;
+      out_state->lastAcceptingState = yy_last_accepting_state;
+      out_state->lastAcceptingPosition = yy_last_accepting_cpos;
+      out_state->checksum = m_checksum;
+      out_state->lastChecksum = m_last_checksum;
+      out_state->position = m_buffer.currentPosition();
+      out_state->length = m_buffer.bufferedLength();
+      memcpy(out_state->token,m_buffer.data(),m_buffer.bufferedLength());
+    }
+
+    void load(const ParserState &in_state) {
+      yy_current_state = in_state.lexerState;
+      yy_last_accepting_state = in_state.lastAcceptingState;
+      yy_last_accepting_cpos = in_state.lastAcceptingPosition;
+      m_checksum = in_state.checksum;
+      m_last_checksum = in_state.lastChecksum;
+      m_buffer.assign(in_state.token,in_state.position,in_state.length);
+    }
   private:
     GPS::util::StringInputBuffer<T> m_buffer;
     int yy_current_state;
@@ -458,6 +602,35 @@ namespace NMEA {
 #define TK2ST(n)  ((n - 1024) << 11)
 #define TK2ID(n)  (n - 1024)
 
+  /**
+    Parser states, the sentence in the upper 5 bits and
+    the step within it in NMEA_STATE_MASK
+  */
+  enum {
+    STATE_0 = 0,
+    STATE_GGA = TK2ST(NMEA_TOKEN_GPGGA),
+    STATE_GLL = TK2ST(NMEA_TOKEN_GPGLL),
+    STATE_GSA = TK2ST(NMEA_TOKEN_GPGSA),
+    STATE_GSV = TK2ST(NMEA_TOKEN_GPGSV),
+    STATE_MSS = TK2ST(NMEA_TOKEN_GPMSS),
+    STATE_RMC = TK2ST(NMEA_TOKEN_GPRMC),
+    STATE_VTG = TK2ST(NMEA_TOKEN_GPVTG),
+    STATE_ZDA = TK2ST(NMEA_TOKEN_GPZDA),
+    STATE_150 = TK2ST(NMEA_TOKEN_PSRF150),
+    STATE_151 = TK2ST(NMEA_TOKEN_PSRF151),
+    STATE_152 = TK2ST(NMEA_TOKEN_PSRF152),
+    STATE_154 = TK2ST(NMEA_TOKEN_PSRF154),
+    STATE_WAIT_NL = 0xe800,
+    STATE_ERROR = 0xf800
+  };
+
+  /**
+    Check a state from outside, e.g. a checkpoint, before Parser::load
+    @param in_state state to check
+    @return false if a DFA state, buffer position or parser state is out of range
+  */
+  bool validState(const ParserState &in_state);
+
   /**
     NMEA Parser class
     @param T input stream class
@@ -472,7 +645,9 @@ namespace NMEA {
     Parser(T &in_stream)
       : m_lexer(in_stream),
         m_current_state(0),
-        m_handler(NULL) {
+        m_handler(NULL),
+        m_filter(NULL),
+        m_messages(0) {
 
         }
 
@@ -484,6 +659,15 @@ namespace NMEA {
       m_handler = in_handler;
     }
 
+    /**
+      Set a change detection stage run before the handler
+      @param in_filter a change filter pointer, NULL to disable
+      @see ChangeFilter
+    */
+    void setFilter(ChangeFilter *in_filter) {
+      m_filter = in_filter;
+    }
+
     /**
       parse from stream
     */
@@ -569,31 +753,42 @@ namespace NMEA {
     const GPS::util::StringInputBuffer<T> &buffer() const {
       return m_lexer.buffer();
     }
+
+    //! number of sentences parsed completely
+    uint32_t messages() const {
+      return m_messages;
+    }
+
+    /**
+      Copy the state between two bytes, the stream is not touched
+      @param out_state state
+    */
+    void save(ParserState *out_state) const {
+      m_lexer.save(out_state);
+      out_state->parserState = m_current_state;
+      out_state->messages = m_messages;
+      memcpy(&out_state->message,&m_message,sizeof(Message));
+    }
+
+    /**
+      Continue from a saved state, the handler and filter are kept
+      @param in_state state from save() of a Parser of any stream class
+    */
+    void load(const ParserState &in_state) {
+      m_lexer.load(in_state);
+      m_current_state = in_state.parserState;
+      m_messages = in_state.messages;
+      memcpy(&m_message,&in_state.message,sizeof(Message));
+    }
   private:
     Lexer<T> m_lexer;
     ParserHandler m_handler;
+    ChangeFilter *m_filter;
+    uint32_t m_messages;
     Message m_message;
 
     uint16_t m_current_state;
 
-    enum {
-      STATE_0 = 0,
-      STATE_GGA = TK2ST(NMEA_TOKEN_GPGGA),
-      STATE_GLL = TK2ST(NMEA_TOKEN_GPGLL),
-      STATE_GSA = TK2ST(NMEA_TOKEN_GPGSA),
-      STATE_GSV = TK2ST(NMEA_TOKEN_GPGSV),
-      STATE_MSS = TK2ST(NMEA_TOKEN_GPMSS),
-      STATE_RMC = TK2ST(NMEA_TOKEN_GPRMC),
-      STATE_VTG = TK2ST(NMEA_TOKEN_GPVTG),
-      STATE_ZDA = TK2ST(NMEA_TOKEN_GPZDA),
-      STATE_150 = TK2ST(NMEA_TOKEN_PSRF150),
-      STATE_151 = TK2ST(NMEA_TOKEN_PSRF151),
-      STATE_152 = TK2ST(NMEA_TOKEN_PSRF152),
-      STATE_154 = TK2ST(NMEA_TOKEN_PSRF154),
-      STATE_WAIT_NL = 0xe800,
-      STATE_ERROR = 0xf800
-    };
-
     void _clearData() {
       memset(&m_message,0xff,sizeof(Message));
     }
@@ -702,7 +897,8 @@ namespace NMEA {
 #endif
     void _wait_NL(int in_token) {
       if (in_token == NMEA_NL) {
-        if (m_handler)
+        m_messages++;
+        if (m_handler && (m_filter == NULL || m_filter->pass(m_message)))
           (*m_handler)(m_message);
         m_current_state = 0;
       } else {
@@ -713,6 +909,10 @@ namespace NMEA {
     void _error(int in_token) {
       if (in_token == NMEA_NL) {
         m_current_state = 0;
+      } else
+      if (in_token == '$') {
+        m_current_state = 1;
+        m_lexer.clearChecksum();
       }
     }
   };
@@ -725,10 +925,18 @@ namespace NMEA {
     if (yy_current_state == 0) {
       m_buffer.accept();
       yy_current_state = 1;
+      // positions of the last token are gone with accept()
+      yy_last_accepting_state = 0;
+      yy_last_accepting_cpos = 0;
       m_checksum = m_last_checksum;
     }
     do {
       int next = m_buffer.next();
+      if (next == -2) {
+        // a token longer than the buffer is line noise, drop it
+        yy_current_state = 0;
+        return NMEA_OVERFLOW;
+      }
       if (next < 0)
         return -1;
 
@@ -894,7 +1102,7 @@ namespace NMEA {
         // Latitude
       case 3:
         if (in_token == NMEA_FLT_NUM) {
-          buffer().decodeDecimal_4_4(&m_message.gga.latitude);
+          m_message.gga.latitude = buffer().decodeCoordinate();
           m_current_state++;
         } //else
         // if (in_token == ',') {
@@ -906,6 +1114,7 @@ namespace NMEA {
       case 5:
         if (in_token == 'N' || in_token == 'S') {
           m_message.gga.nsIndicator = in_token;
+          m_message.gga.latitude = util::applyHemisphere(m_message.gga.latitude,in_token);
           m_current_state++;
         } //else
         // if (in_token == ',') {
@@ -916,7 +1125,7 @@ namespace NMEA {
         // Longitude
       case 7:
         if (in_token == NMEA_FLT_NUM) {
-          buffer().decodeDecimal_4_4(&m_message.gga.longitude);
+          m_message.gga.longitude = buffer().decodeCoordinate();
           m_current_state++;
         } //else
         // if (in_token == ',') {
@@ -928,6 +1137,7 @@ namespace NMEA {
       case 9:
         if (in_token == 'E' || in_token == 'W') {
           m_message.gga.ewIndicator = in_token;
+          m_message.gga.longitude = util::applyHemisphere(m_message.gga.longitude,in_token);
           m_current_state++;
         } //else
         // if (in_token == ',') {
@@ -1054,7 +1264,7 @@ namespace NMEA {
         // Latitude
       case 1:
         if (in_token == NMEA_FLT_NUM) {
-           buffer().decodeDecimal_4_4(&m_message.gll.latitude);
+          m_message.gll.latitude = buffer().decodeCoordinate();
           m_current_state++;
         }
         NMEA_SKIP
@@ -1063,6 +1273,7 @@ namespace NMEA {
       case 3:
         if (in_token == 'N' || in_token == 'S') {
           m_message.gll.nsIndicator = in_token;
+          m_message.gll.latitude = util::applyHemisphere(m_message.gll.latitude,in_token);
           m_current_state++;
         }
         NMEA_SKIP
@@ -1070,7 +1281,7 @@ namespace NMEA {
         // Longitude
       case 5:
         if (in_token == NMEA_FLT_NUM) {
-          buffer().decodeDecimal_4_4(&m_message.gll.longitude);
+          m_message.gll.longitude = buffer().decodeCoordinate();
           m_current_state++;
         }
         NMEA_SKIP
@@ -1079,6 +1290,7 @@ namespace NMEA {
       case 7:
         if (in_token == 'E' || in_token == 'W') {
           m_message.gll.ewIndicator = in_token;
+          m_message.gll.longitude = util::applyHemisphere(m_message.gll.longitude,in_token);
           m_current_state++;
         }
         NMEA_SKIP
@@ -1341,7 +1553,7 @@ namespace NMEA {
         NMEA_ON_ERROR;
       case 5:
         if (in_token == NMEA_FLT_NUM) {
-          buffer().decodeDecimal_4_4(&m_message.gll.latitude);
+          m_message.rmc.latitude = buffer().decodeCoordinate();
           m_current_state++;
         }
         NMEA_SKIP
@@ -1350,6 +1562,7 @@ namespace NMEA {
       case 7:
         if (in_token == 'N' || in_token == 'S') {
           m_message.rmc.nsIndicator = in_token;
+          m_message.rmc.latitude = util::applyHemisphere(m_message.rmc.latitude,in_token);
           m_current_state++;
         }
         NMEA_SKIP
@@ -1357,7 +1570,7 @@ namespace NMEA {
         // Longitude
       case 9:
         if (in_token == NMEA_FLT_NUM) {
-          buffer().decodeDecimal_4_4(&m_message.rmc.longitude);
+          m_message.rmc.longitude = buffer().decodeCoordinate();
           m_current_state++;
         }
         NMEA_SKIP
@@ -1366,6 +1579,7 @@ namespace NMEA {
       case 11:
         if (in_token == 'E' || in_token == 'W') {
           m_message.rmc.ewIndicator = in_token;
+          m_message.rmc.longitude = util::applyHemisphere(m_message.rmc.longitude,in_token);
           m_current_state++;
         }
         NMEA_SKIP
@@ -1607,7 +1821,7 @@ namespace NMEA {
         NMEA_ON_ERROR;
       case 5:
         if (in_token == NMEA_NUM) {
-          m_message.gpsDataAndEEM.gpsTOW = buffer().decodeInt16();
+          m_message.gpsDataAndEEM.gpsTOW = buffer().decodeLong();
           m_current_state++;
         }
         NMEA_SKIP
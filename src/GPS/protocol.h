@@ -0,0 +1,208 @@
+/**
+  @file protocol.h
+
+  NMEA <-> SiRF binary protocol switching
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_protocol_h
+#define __GPS_protocol_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+
+namespace GPS {
+
+  /**
+    Called when a protocol switch ends
+    @param in_protocol protocol now in use
+    @param in_confirmed false if the switch timed out and was reverted
+  */
+  typedef void (*ProtocolSwitchHandler)(NMEA::ProtocolType in_protocol,bool in_confirmed);
+
+  /**
+    Switches a receiver between NMEA and SiRF binary and feeds the
+    port to the parser of the protocol in use.
+    A switch is confirmed by a valid frame (or sentence) of the new
+    protocol; without one before the timeout the receiver is asked
+    for the previous protocol and baud rate again and they are restored.
+
+    Port needs available(), read(), write(), flush() and begin(baud),
+    as HardwareSerial does.
+
+    @param Port serial port class
+  */
+  template<class Port>
+  class ProtocolSwitch {
+  public:
+    /**
+      @param in_port serial port, already opened at in_baud
+      @param in_nmea NMEA parser reading in_port
+      @param in_sirf SiRF packet parser reading in_port
+      @param in_baud current baud rate
+      @param in_timeoutMs time allowed to confirm a switch
+    */
+    ProtocolSwitch(Port &in_port,NMEA::Parser<Port> &in_nmea,SiRF::PacketParser<Port> &in_sirf,
+                   long in_baud,uint32_t in_timeoutMs = 2000)
+      : m_port(in_port),
+        m_nmea(in_nmea),
+        m_sirf(in_sirf),
+        m_nmeaBuilder(in_port),
+        m_sirfBuilder(in_port),
+        m_state(NMEA_ACTIVE),
+        m_baud(in_baud),
+        m_pendingBaud(in_baud),
+        m_timeout(in_timeoutMs),
+        m_deadline(0),
+        m_mark(0),
+        m_failures(0),
+        m_handler(NULL) {
+
+    }
+
+    void setHandler(ProtocolSwitchHandler in_handler) {
+      m_handler = in_handler;
+    }
+
+    /**
+      Ask the receiver for SiRF binary output
+      @param in_baud baud rate after the switch
+      @param in_nowMs current time
+      @return false if a switch is in progress or binary is in use
+    */
+    bool switchToBinary(long in_baud,uint32_t in_nowMs) {
+      if (m_state != NMEA_ACTIVE)
+        return false;
+      m_nmeaBuilder.SetSerialPort(NMEA::PROTOCOL_SiRF_binary,in_baud);
+      _reopen(in_baud);
+      m_mark = m_sirf.frames();
+      m_deadline = in_nowMs + m_timeout;
+      m_state = TO_BINARY;
+      return true;
+    }
+
+    /**
+      Ask the receiver for NMEA output at the current baud rate
+      @param in_nowMs current time
+      @return false if a switch is in progress or NMEA is in use
+    */
+    bool switchToNMEA(uint32_t in_nowMs) {
+      if (m_state != BINARY_ACTIVE)
+        return false;
+      m_sirfBuilder.SetProtocol(SiRF::Protocol_NMEA);
+      m_port.flush();
+      m_mark = m_nmea.messages();
+      m_deadline = in_nowMs + m_timeout;
+      m_state = TO_NMEA;
+      return true;
+    }
+
+    /**
+      Parse received data with the active parser, call from loop()
+      @param in_nowMs current time, millis() on Arduino
+    */
+    void update(uint32_t in_nowMs) {
+      switch(m_state) {
+        case NMEA_ACTIVE:
+          m_nmea.yyparse();
+          break;
+        case BINARY_ACTIVE:
+          m_sirf.polling();
+          break;
+        case TO_BINARY:
+          m_sirf.polling();
+          if (m_sirf.frames() != m_mark) {
+            m_baud = m_pendingBaud;
+            _finish(BINARY_ACTIVE,true);
+          } else
+          if (_expired(in_nowMs)) {
+            // the receiver may have switched without being heard,
+            // move it back to the old baud rate before asking for NMEA
+            m_sirfBuilder.SetBinarySerialPort(m_baud);
+            _reopen(m_baud);
+            m_sirfBuilder.SetProtocol(SiRF::Protocol_NMEA);
+            m_port.flush();
+            m_failures++;
+            _finish(NMEA_ACTIVE,false);
+          }
+          break;
+        case TO_NMEA:
+          m_nmea.yyparse();
+          if (m_nmea.messages() != m_mark) {
+            _finish(NMEA_ACTIVE,true);
+          } else
+          if (_expired(in_nowMs)) {
+            // the receiver may talk NMEA without being heard,
+            // ask it for binary again before following binary
+            m_nmeaBuilder.SetSerialPort(NMEA::PROTOCOL_SiRF_binary,m_baud);
+            m_port.flush();
+            m_failures++;
+            _finish(BINARY_ACTIVE,false);
+          }
+          break;
+      }
+    }
+
+    //! protocol the parsers currently follow
+    NMEA::ProtocolType protocol() const {
+      return m_state == BINARY_ACTIVE || m_state == TO_BINARY
+        ? NMEA::PROTOCOL_SiRF_binary : NMEA::PROTOCOL_NMEA;
+    }
+
+    bool switching() const {
+      return m_state == TO_BINARY || m_state == TO_NMEA;
+    }
+
+    long baud() const {
+      return m_baud;
+    }
+
+    //! number of switches which timed out
+    uint32_t failures() const {
+      return m_failures;
+    }
+  private:
+    enum {
+      NMEA_ACTIVE,
+      TO_BINARY,
+      BINARY_ACTIVE,
+      TO_NMEA
+    };
+
+    Port &m_port;
+    NMEA::Parser<Port> &m_nmea;
+    SiRF::PacketParser<Port> &m_sirf;
+    NMEA::CommandBuilder<Port> m_nmeaBuilder;
+    SiRF::CommandBuilder<Port> m_sirfBuilder;
+
+    uint8_t m_state;
+    long m_baud;
+    long m_pendingBaud;
+    uint32_t m_timeout;
+    uint32_t m_deadline;
+    uint32_t m_mark;
+    uint32_t m_failures;
+    ProtocolSwitchHandler m_handler;
+
+    bool _expired(uint32_t in_nowMs) const {
+      return (int32_t)(in_nowMs - m_deadline) >= 0;
+    }
+
+    void _reopen(long in_baud) {
+      m_port.flush();
+      m_port.begin(in_baud);
+      m_pendingBaud = in_baud;
+    }
+
+    void _finish(uint8_t in_state,bool in_confirmed) {
+      m_state = in_state;
+      if (m_handler)
+        (*m_handler)(protocol(),in_confirmed);
+    }
+  };
+
+} /* GPS */
+
+#endif /* __GPS_protocol_h */
@@ -0,0 +1,283 @@
+/**
+  @file rate.h
+
+  Receiver output rates following the subscribed messages
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_rate_h
+#define __GPS_rate_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+#include <GPS/command.h>
+
+#ifndef RATE_CONTROLLER_SUBSCRIPTIONS
+#define RATE_CONTROLLER_SUBSCRIPTIONS   8
+#endif
+
+#ifndef RATE_CONTROLLER_MESSAGES
+#define RATE_CONTROLLER_MESSAGES        8
+#endif
+
+//! failed changes before an output is given up
+#ifndef RATE_CONTROLLER_ATTEMPTS
+#define RATE_CONTROLLER_ATTEMPTS        5
+#endif
+
+//! wait after the first failed change, doubled after each further one
+#ifndef RATE_CONTROLLER_BACKOFF_MS
+#define RATE_CONTROLLER_BACKOFF_MS      1000
+#endif
+
+namespace GPS {
+
+  /**
+    Turns receiver outputs down to what the subscribers ask for.
+    Each managed output is set to the shortest interval of its
+    subscriptions, or disabled while it has none.
+    Messages are NMEA::MessageType values with the NMEA protocol
+    ($PSRF103) and message IDs with SiRF binary (MID 166).
+
+    A subscription with a handler receives its NMEA messages
+    through dispatch(), which is called from the parser handler.
+
+    Rate changes are queued on a CommandEngine and an output counts as
+    set only when its command is acknowledged. The CommandHandler passes
+    completions to completed(). A failed change is queued again after
+    RATE_CONTROLLER_BACKOFF_MS, doubled after each further failure,
+    and after RATE_CONTROLLER_ATTEMPTS failures the output is no longer
+    managed.
+
+    @param Port serial port class
+  */
+  template<class Port>
+  class RateController {
+  public:
+    /**
+      @param in_engine command engine writing to the receiver
+      @param in_protocol protocol the receiver is using
+    */
+    RateController(CommandEngine<Port> &in_engine,NMEA::ProtocolType in_protocol = NMEA::PROTOCOL_NMEA)
+      : m_engine(in_engine),
+        m_protocol(in_protocol),
+        m_managed(0),
+        m_cursor(0),
+        m_now(0) {
+      for (int i = 0;i < RATE_CONTROLLER_SUBSCRIPTIONS;i++) {
+        m_subscriptions[i].rate = 0;
+      }
+    }
+
+    /**
+      Control an output, it is disabled until subscribed
+      @param in_message NMEA::MessageType or SiRF message ID
+      @return false if too many outputs are managed
+    */
+    bool manage(uint8_t in_message) {
+      if (_find(in_message) >= 0)
+        return true;
+      if (m_managed >= RATE_CONTROLLER_MESSAGES)
+        return false;
+      m_outputs[m_managed].message = in_message;
+      m_outputs[m_managed].applied = UNKNOWN;
+      m_outputs[m_managed].command = NONE;
+      m_outputs[m_managed].failures = 0;
+      m_managed++;
+      return true;
+    }
+
+    /**
+      @param in_message NMEA::MessageType or SiRF message ID
+      @param in_rate output interval in seconds, 1 - 255
+      @param in_handler NMEA message handler, may be NULL
+      @return subscription number, -1 if none is left
+    */
+    int8_t subscribe(uint8_t in_message,uint8_t in_rate = 1,NMEA::ParserHandler in_handler = NULL) {
+      if (in_rate == 0)
+        return -1;
+      for (int i = 0;i < RATE_CONTROLLER_SUBSCRIPTIONS;i++) {
+        Subscription &s = m_subscriptions[i];
+        if (s.rate == 0) {
+          s.message = in_message;
+          s.rate = in_rate;
+          s.handler = in_handler;
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    void unsubscribe(int8_t in_subscription) {
+      if (in_subscription >= 0 && in_subscription < RATE_CONTROLLER_SUBSCRIPTIONS)
+        m_subscriptions[in_subscription].rate = 0;
+    }
+
+    /**
+      Use the other protocol's commands, all rates are sent again
+      @param in_protocol protocol the receiver is using
+    */
+    void setProtocol(NMEA::ProtocolType in_protocol) {
+      m_protocol = in_protocol;
+      for (int i = 0;i < m_managed;i++) {
+        m_outputs[i].applied = UNKNOWN;
+        m_outputs[i].command = NONE;
+        m_outputs[i].failures = 0;
+      }
+    }
+
+    /**
+      Pass a NMEA message to the handlers subscribed to its type
+      @param in_msg decoded message
+    */
+    void dispatch(const NMEA::Message &in_msg) {
+      if (in_msg.messageID > NMEA_GPZDA)
+        return;
+      uint8_t type = messageTypes[in_msg.messageID];
+      for (int i = 0;i < RATE_CONTROLLER_SUBSCRIPTIONS;i++) {
+        const Subscription &s = m_subscriptions[i];
+        if (s.rate && s.handler && s.message == type)
+          (*s.handler)(in_msg);
+      }
+    }
+
+    /**
+      Queue one rate change if an output differs from its subscriptions
+      and has no change in flight or backing off, call from loop()
+      @param in_nowMs current time, millis() on Arduino
+      @return true if a command was queued
+    */
+    bool update(uint32_t in_nowMs) {
+      m_now = in_nowMs;
+      for (int n = 0;n < m_managed;n++) {
+        Output &o = m_outputs[m_cursor];
+        m_cursor = (m_cursor + 1) % m_managed;
+        uint8_t rate = rateOf(o.message);
+        if (o.failures > 0 && (int32_t)(in_nowMs - o.retryAt) < 0)
+          continue;
+        if (o.command == NONE && rate != o.applied) {
+          int32_t command = m_protocol == NMEA::PROTOCOL_NMEA
+            ? m_engine.queryRateControl((NMEA::MessageType)o.message,NMEA::SET_RATE,rate,1)
+            : m_engine.setMessageRate(0,o.message,rate);
+          if (command < 0)
+            return false;
+          o.command = command;
+          o.pending = rate;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /**
+      Pass a command completion from the CommandHandler
+      @param in_command command number
+      @param in_acknowledged false if the command timed out
+      @return true if it was a rate change of this controller
+    */
+    bool completed(uint16_t in_command,bool in_acknowledged) {
+      for (int i = 0;i < m_managed;i++) {
+        Output &o = m_outputs[i];
+        if (o.command == in_command) {
+          o.command = NONE;
+          if (in_acknowledged) {
+            o.applied = o.pending;
+            o.failures = 0;
+          } else
+          if (++o.failures >= RATE_CONTROLLER_ATTEMPTS) {
+            _remove(i);
+          } else {
+            o.retryAt = m_now + ((uint32_t)RATE_CONTROLLER_BACKOFF_MS << (o.failures - 1));
+          }
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /**
+      @param in_message NMEA::MessageType or SiRF message ID
+      @return false if it is not managed or was given up
+    */
+    bool managed(uint8_t in_message) const {
+      return _find(in_message) >= 0;
+    }
+
+    /**
+      @param in_message NMEA::MessageType or SiRF message ID
+      @return shortest subscribed interval, 0 if not subscribed
+    */
+    uint8_t rateOf(uint8_t in_message) const {
+      uint8_t rate = 0;
+      for (int i = 0;i < RATE_CONTROLLER_SUBSCRIPTIONS;i++) {
+        const Subscription &s = m_subscriptions[i];
+        if (s.rate && s.message == in_message && (rate == 0 || s.rate < rate))
+          rate = s.rate;
+      }
+      return rate;
+    }
+  private:
+    enum {
+      UNKNOWN = 0xffff,
+      NONE = -1
+    };
+
+    struct Subscription {
+      uint8_t message;
+      uint8_t rate;               //!< 0 if the slot is free
+      NMEA::ParserHandler handler;
+    };
+
+    struct Output {
+      uint8_t message;
+      uint8_t pending;            //!< rate of the command in flight
+      uint16_t applied;           //!< rate last acknowledged, or UNKNOWN
+      int32_t command;            //!< command in flight, or NONE
+      uint8_t failures;           //!< failed changes in a row
+      uint32_t retryAt;           //!< time to queue again after a failure
+    };
+
+    CommandEngine<Port> &m_engine;
+    NMEA::ProtocolType m_protocol;
+    Subscription m_subscriptions[RATE_CONTROLLER_SUBSCRIPTIONS];
+    Output m_outputs[RATE_CONTROLLER_MESSAGES];
+    uint8_t m_managed;
+    uint8_t m_cursor;
+    uint32_t m_now;             //!< time of the last update()
+
+    int _find(uint8_t in_message) const {
+      for (int i = 0;i < m_managed;i++) {
+        if (m_outputs[i].message == in_message)
+          return i;
+      }
+      return -1;
+    }
+
+    void _remove(int in_index) {
+      m_outputs[in_index] = m_outputs[--m_managed];
+      if (m_cursor >= m_managed)
+        m_cursor = 0;
+    }
+
+    //! NMEA message ID to MessageType
+    static const uint8_t messageTypes[NMEA_GPZDA + 1];
+  };
+
+  template<class Port>
+  const uint8_t RateController<Port>::messageTypes[NMEA_GPZDA + 1] = {
+    0xff,
+    NMEA::MSG_GGA,
+    NMEA::MSG_GLL,
+    NMEA::MSG_GSA,
+    NMEA::MSG_GSV,
+    NMEA::MSG_MSS,
+    NMEA::MSG_RMC,
+    NMEA::MSG_VTG,
+    NMEA::MSG_ZDA
+  };
+
+} /* GPS */
+
+#endif /* __GPS_rate_h */
@@ -0,0 +1,119 @@
+/**
+  @file scheduler.h
+
+  Work stealing scheduler of per stream parse tasks on a host.
+  Received chunks are queued on their stream; a stream with queued
+  data is a task on a worker's deque. Idle workers steal tasks from
+  busy ones, and a stream is never run by two workers at once, so
+  its sentences are parsed and delivered in order.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_scheduler_h
+#define __GPS_scheduler_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/engine.h>
+
+//! bytes queued on a stream before submit() refuses more
+#ifndef SCHEDULER_MAX_PENDING
+#define SCHEDULER_MAX_PENDING   (1024 * 1024)
+#endif
+
+namespace GPS {
+
+  /**
+    Per worker counters
+  */
+  struct WorkerStats {
+    uint64_t  busyNanos;  //!< time spent parsing
+    uint64_t  tasks;      //!< chunks of streams parsed
+    uint64_t  steals;     //!< tasks taken from other workers
+    uint64_t  bytes;      //!< bytes parsed
+  };
+
+  /**
+    Scheduler of NMEA::Engine workers over detached stream states.
+    The handler runs on worker threads, one stream at a time.
+    @code
+    GPS::Scheduler scheduler(streams,4);
+    scheduler.setHandler(handler);
+    scheduler.start();
+    ...
+    scheduler.submit(id,chunk,length);
+    @endcode
+  */
+  class Scheduler {
+  public:
+    /**
+      @param in_streams number of stream IDs
+      @param in_workers number of worker threads
+    */
+    Scheduler(uint32_t in_streams,unsigned in_workers);
+    ~Scheduler();
+
+    //! set before start()
+    void setHandler(NMEA::StreamHandler in_handler);
+
+    void start();
+
+    /**
+      Stop the workers, queued data which was not parsed is kept
+    */
+    void stop();
+
+    /**
+      Queue received bytes of a stream, callable from any thread
+      @param in_stream stream ID
+      @param in_data received bytes, copied
+      @param in_length bytes
+      @return false if the stream has SCHEDULER_MAX_PENDING bytes queued
+    */
+    bool submit(uint32_t in_stream,const uint8_t *in_data,size_t in_length);
+
+    /**
+      Wait until every queued byte is parsed
+    */
+    void wait();
+
+    /**
+      State of a stream, valid while the scheduler is idle
+    */
+    const NMEA::ParserState &state(uint32_t in_stream) const;
+
+    unsigned workers() const {
+      return m_workerCount;
+    }
+
+    WorkerStats stats(unsigned in_worker) const;
+
+    /**
+      @return share of the time since start() the worker spent parsing, 0 - 1
+    */
+    double utilisation(unsigned in_worker) const;
+  private:
+    struct Stream;
+    struct Worker;
+    struct Shared;
+
+    uint32_t m_streamCount;
+    unsigned m_workerCount;
+    Stream *m_streams;
+    Worker *m_workers;
+    Shared *m_shared;
+    NMEA::StreamHandler m_handler;
+
+    void _run(unsigned in_worker);
+    bool _take(unsigned in_worker,uint32_t *out_stream);
+    void _push(unsigned in_worker,uint32_t in_stream,bool in_back);
+    void _parse(unsigned in_worker,uint32_t in_stream);
+
+    Scheduler(const Scheduler &);
+    Scheduler &operator=(const Scheduler &);
+  };
+
+} /* GPS */
+
+#endif /* __GPS_scheduler_h */
@@ -0,0 +1,183 @@
+/**
+  @file simulator.h
+
+  Receiver simulator for tests and load generation on a host.
+  Follows a trajectory and emits GGA, GSA, GSV, RMC, VTG and ZDA
+  sentences or SiRF MID 41 frames. $PSRF100, $PSRF103 and SiRF
+  input messages (MID 134, 135, 166) change the output as a
+  receiver would, SiRF input messages are acknowledged by MID 11.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_simulator_h
+#define __GPS_simulator_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+
+#define SIMULATOR_SATELLITES      8
+
+//! enough for one epoch of every output
+#define SIMULATOR_EPOCH_SIZE      1024
+
+#ifndef SIMULATOR_PORT_BUFFER
+#define SIMULATOR_PORT_BUFFER     4096
+#endif
+
+namespace GPS {
+
+  /**
+    Simulated receiver, deterministic for a seed
+  */
+  class Simulator {
+  public:
+    /**
+      Starts at 35.6812N 139.7671E, 2020-01-01 00:00:00 UTC, standing still,
+      one epoch per second, NMEA at 4800 baud with every sentence enabled
+      @param in_seed noise generator seed, not 0
+    */
+    Simulator(uint32_t in_seed = 1);
+
+    /**
+      @param in_lat latitude in degrees
+      @param in_lon longitude in degrees
+      @param in_alt height above MSL in meters
+      @param in_epochNanos UNIX UTC nanoseconds
+    */
+    void setStart(double in_lat,double in_lon,double in_alt,int64_t in_epochNanos);
+
+    /**
+      @param in_speed meters per second
+      @param in_heading degrees clockwise from north
+      @param in_turnRate degrees per second
+    */
+    void setMotion(double in_speed,double in_heading,double in_turnRate = 0);
+
+    //! epochs per second, 1 - 10
+    void setEpochRate(uint8_t in_hz);
+
+    //! standard deviation of the reported position in meters
+    void setNoise(double in_meters);
+
+    //! probability of a bit error in each sentence or frame
+    void setErrorRate(double in_probability);
+
+    void setProtocol(NMEA::ProtocolType in_protocol);
+
+    /**
+      @param in_message NMEA::MessageType
+      @param in_rate epochs between outputs, 0 disables
+    */
+    void setRate(uint8_t in_message,uint8_t in_rate);
+
+    /**
+      @param in_messageID SiRF output message ID, only 41 is generated
+      @param in_rate epochs between outputs, 0 disables
+    */
+    void setBinaryRate(uint8_t in_messageID,uint8_t in_rate);
+
+    /**
+      Advance one epoch and write its output
+      @param out_buffer output, SIMULATOR_EPOCH_SIZE bytes hold every output
+      @param in_size size of out_buffer
+      @return bytes written, output which does not fit is dropped
+    */
+    size_t epoch(uint8_t *out_buffer,size_t in_size);
+
+    /**
+      Bytes sent to the receiver
+      @param in_data NMEA sentences and SiRF frames
+      @param in_length bytes
+    */
+    void receive(const uint8_t *in_data,size_t in_length);
+
+    NMEA::ProtocolType protocol() const { return m_protocol; }
+    long baud() const { return m_baud; }
+    //! UNIX UTC nanoseconds of the last epoch
+    int64_t time() const { return m_time; }
+    //! true position of the last epoch
+    double latitude() const { return m_lat; }
+    double longitude() const { return m_lon; }
+    //! number of epochs
+    uint32_t epochs() const { return m_epochs; }
+  private:
+    uint32_t m_seed;
+    double m_lat;
+    double m_lon;
+    double m_alt;
+    double m_speed;
+    double m_heading;
+    double m_turnRate;
+    double m_noise;
+    double m_errorRate;
+    int64_t m_time;
+    uint32_t m_epochs;
+    uint8_t m_hz;
+    NMEA::ProtocolType m_protocol;
+    long m_baud;
+
+    uint8_t m_rates[NMEA::MSG_ZDA + 1];
+    uint16_t m_queries;         //!< $PSRF103 queries, bit per MessageType
+    uint8_t m_mid41Rate;
+    uint8_t m_acks[8];          //!< SiRF input message IDs to acknowledge
+    uint8_t m_ackCount;
+
+    uint8_t m_in[128];          //!< input sentence or frame being received
+    uint8_t m_inLength;
+
+    double m_reportedLat;
+    double m_reportedLon;
+
+    uint32_t _random();
+    double _gaussian();
+    void _move();
+    void _corrupt(uint8_t *io_data,size_t in_length);
+    void _input(uint8_t in_c);
+    void _sentence();
+    void _frame();
+    bool _due(uint8_t in_message);
+    size_t _nmea(uint8_t *out_buffer,size_t in_size);
+    size_t _binary(uint8_t *out_buffer,size_t in_size);
+    size_t _sirfFrame(const uint8_t *in_payload,uint16_t in_length,uint8_t *out_buffer,size_t in_size);
+  };
+
+  /**
+    In-memory serial port connected to a Simulator,
+    usable as the stream of NMEA::Parser and SiRF::PacketParser.
+    Output is garbled while begin() and the simulator disagree on the baud rate.
+  */
+  class SimulatorPort {
+  public:
+    SimulatorPort(Simulator &in_simulator,long in_baud = 4800)
+      : m_simulator(in_simulator),
+        m_baud(in_baud),
+        m_length(0),
+        m_position(0) {
+    }
+
+    /**
+      Generate one epoch of output for reading
+      @return bytes added
+    */
+    size_t step();
+
+    void begin(long in_baud) { m_baud = in_baud; }
+    void flush() {}
+    int available() const { return m_length - m_position; }
+    int read() { return m_position < m_length ? m_buffer[m_position++] : -1; }
+    void write(uint8_t in_c) { m_simulator.receive(&in_c,1); }
+    void write(const uint8_t *in_data,int in_length) { m_simulator.receive(in_data,in_length); }
+    void write(const char *in_data,int in_length) { m_simulator.receive((const uint8_t *)in_data,in_length); }
+  private:
+    Simulator &m_simulator;
+    long m_baud;
+    uint8_t m_buffer[SIMULATOR_PORT_BUFFER];
+    size_t m_length;
+    size_t m_position;
+  };
+
+} /* GPS */
+
+#endif /* __GPS_simulator_h */
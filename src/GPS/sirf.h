@@ -11,8 +11,54 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <string.h>
 #include <GPS/util.h>
 
+/*
+  SIRF_USE_SHUFFLE converts message bodies with PSHUFB. It changes the
+  inline MessageParser::_convert() and needs the table in sirf.cpp,
+  so it must be defined for every translation unit or for none.
+*/
+#ifdef SIRF_USE_SHUFFLE
+#if !defined(__SSSE3__) || defined(GPS_BIG_ENDIAN_HOST)
+#error SIRF_USE_SHUFFLE needs SSSE3 on a little endian host
+#endif
+#include <tmmintrin.h>
+#endif
+
+#ifndef SIRF_USE_PARTLY
+#define SIRF_USE_2
+#define SIRF_USE_4
+#define SIRF_USE_7
+#define SIRF_USE_9
+#define SIRF_USE_11
+#define SIRF_USE_13
+#define SIRF_USE_41
+#endif
+
+//! channels reported by MID 4 and MID 13
+#define SIRF_CHANNELS   12
+
+/**
+  Longest accepted payload, the protocol allows up to 32767
+*/
+#ifndef SIRF_MAX_PAYLOAD_LENGTH
+#define SIRF_MAX_PAYLOAD_LENGTH  1024
+#endif
+#if SIRF_MAX_PAYLOAD_LENGTH > 32767
+#error SIRF_MAX_PAYLOAD_LENGTH must not exceed 32767
+#endif
+
+/**
+  Bytes of a frame in progress kept to rescan after a false start.
+  To recover a frame hidden in a truncated one it must cover the longest
+  decoded frame: MID 4 is 196 bytes, MID 41 is 99 bytes.
+  0 disables the rescan.
+*/
+#ifndef SIRF_RESYNC_WINDOW
+#define SIRF_RESYNC_WINDOW  256
+#endif
+
 namespace GPS {
 
 namespace SiRF {
@@ -61,34 +107,25 @@ namespace SiRF {
     uint8_t   ch12PRN;
   } __attribute__((__packed__));
 
+  //! Measured Tracker Data Out – Message ID 4, one channel
+  struct TrackerChannel {
+    uint8_t   SVid;
+    uint8_t   azimuth;
+    uint8_t   elev;
+    uint16_t  state;
+    uint8_t   CN0[10];
+  } __attribute__((__packed__));
+
   //! Measured Tracker Data Out – Message ID 4
   struct MeasuredTrackerDataOut {
     uint16_t  GPSWeek;
     uint32_t  GPSTOW;
     uint8_t   chans;
-    uint8_t   _1stSVid;
-    uint8_t   azimuth1;
-    uint8_t   elev1;
-    uint16_t  state1;
-    uint8_t   CN0_1;
-    uint8_t   CN0_2;
-    uint8_t   CN0_3;
-    uint8_t   CN0_4;
-    uint8_t   CN0_5;
-    uint8_t   CN0_6;
-    uint8_t   CN0_7;
-    uint8_t   CN0_8;
-    uint8_t   CN0_9;
-    uint8_t   CN0_10;
-    uint16_t  _2ndSVid;
-    uint8_t   azimuth2;
-    uint8_t   elev2;
-    uint16_t  state2;
+    TrackerChannel channels[SIRF_CHANNELS];
   } __attribute__((__packed__));
 
   //! Response: Clock Status Data – Message ID 7
   struct ClockStatusData {
-    uint8_t   messageID;
     uint16_t  extendedGPSWeek;
     uint32_t  GPSTOW;
     uint8_t   SVs;
@@ -110,6 +147,19 @@ namespace SiRF {
     uint8_t   ackID;
   } __attribute__((__packed__));
 
+  //! Visible List – Message ID 13, one satellite
+  struct VisibleSV {
+    uint8_t   SVid;
+    int16_t   azimuth;
+    int16_t   elevation;
+  } __attribute__((__packed__));
+
+  //! Visible List – Message ID 13, only visibleSVs entries are valid
+  struct VisibleList {
+    uint8_t   visibleSVs;
+    VisibleSV SVs[SIRF_CHANNELS];
+  } __attribute__((__packed__));
+
   //! Geodetic Navigation Data – Message ID 41
   struct GeodeticNavigationData {
     struct {
@@ -210,11 +260,90 @@ namespace SiRF {
   struct OutputMessage {
     uint8_t   messageID;
     union {
+#ifdef SIRF_USE_2
+      MeasureNavigationDataOut measureNavigationDataOut;
+#endif
+#ifdef SIRF_USE_4
+      MeasuredTrackerDataOut measuredTrackerDataOut;
+#endif
+#ifdef SIRF_USE_7
       ClockStatusData clockStatusData;
+#endif
+#ifdef SIRF_USE_9
+      CPUThroughput cpuThroughput;
+#endif
+#ifdef SIRF_USE_11
+      CommandAcknowledgment commandAcknowledgment;
+#endif
+#ifdef SIRF_USE_13
+      VisibleList visibleList;
+#endif
+#ifdef SIRF_USE_41
       GeodeticNavigationData geodeticNavigationData;
+#endif
     } messageBody;
   };
 
+  enum {
+    FIELD_SIGNED = 1
+  };
+
+  /**
+    A multi byte big endian field of a message body
+  */
+  struct FieldLayout {
+    uint8_t   offset;   //!< from the start of the message body
+    uint8_t   width;    //!< 2 or 4
+    uint8_t   flags;    //!< FIELD_SIGNED
+    uint8_t   count;    //!< number of repetitions
+    uint8_t   stride;   //!< distance between repetitions
+  };
+
+  /**
+    Layout of an output message body.
+    Single byte fields need no conversion and are not listed.
+  */
+  struct MessageLayout {
+    uint8_t   messageID;
+    uint8_t   minLength;  //!< shortest acceptable body
+    uint8_t   length;     //!< body size
+    uint8_t   fieldCount;
+    const FieldLayout *fields;
+  };
+
+  extern const MessageLayout messageLayouts[];
+  extern const uint8_t messageLayoutCount;
+
+#ifdef SIRF_USE_SHUFFLE
+#define SIRF_MAX_SHUFFLE_SEGMENTS 12
+
+  /**
+    Byte order conversion of a message body as PSHUFB operations on
+    16 byte segments, built from the MessageLayout at startup.
+    A segment never splits a field; count is 0 when the body is shorter
+    than a segment or needs more than SIRF_MAX_SHUFFLE_SEGMENTS.
+  */
+  struct ShuffleProgram {
+    uint8_t   count;
+    uint8_t   offset[SIRF_MAX_SHUFFLE_SEGMENTS];
+    uint8_t   mask[SIRF_MAX_SHUFFLE_SEGMENTS][16];
+  };
+
+  //! indexed like messageLayouts
+  extern ShuffleProgram shufflePrograms[];
+#endif
+
+  /**
+    @return layout of the message or NULL if it is not supported
+  */
+  inline const MessageLayout *findMessageLayout(int in_messageID) {
+    for (uint8_t i = 0;i < messageLayoutCount;i++) {
+      if (messageLayouts[i].messageID == in_messageID)
+        return &messageLayouts[i];
+    }
+    return NULL;
+  }
+
   struct InputMessage {
     uint8_t   messageID;
     union {
@@ -226,12 +355,109 @@ namespace SiRF {
 
   typedef void (*OutputMessageHandler)(const OutputMessage &);
 
+  /**
+    A validated payload left in place, fields are loaded on demand
+  */
+  class PayloadView {
+  public:
+    PayloadView(const uint8_t *in_payload,uint16_t in_length)
+      : m_payload(in_payload),
+        m_length(in_length) {
+
+    }
+
+    uint8_t messageID() const {
+      return m_payload[0];
+    }
+
+    //! payload including the message ID
+    const uint8_t *data() const {
+      return m_payload;
+    }
+
+    uint16_t length() const {
+      return m_length;
+    }
+
+    //! @param in_offset from the start of the message body
+    uint8_t u8(uint16_t in_offset) const {
+      return m_payload[in_offset + 1];
+    }
+
+    uint16_t u16(uint16_t in_offset) const {
+      return util::readBE16(m_payload + in_offset + 1);
+    }
+
+    uint32_t u32(uint16_t in_offset) const {
+      return util::readBE32(m_payload + in_offset + 1);
+    }
+
+    int16_t s16(uint16_t in_offset) const {
+      return (int16_t)u16(in_offset);
+    }
+
+    int32_t s32(uint16_t in_offset) const {
+      return (int32_t)u32(in_offset);
+    }
+  protected:
+    const uint8_t *m_payload;
+    uint16_t m_length;
+  };
+
+  typedef void (*PayloadViewHandler)(const PayloadView &);
+
+  /**
+    @param in_frame a whole frame, from 0xa0 0xa2 to 0xb0 0xb3
+    @param in_length frame length
+  */
+  typedef void (*RawFrameHandler)(const uint8_t *in_frame,uint16_t in_length);
+
+#define SIRF_VIEW_FIELD(t,s,f,l) \
+    t f() const { return (t)l(offsetof(s,f)); }
+
+  /**
+    Geodetic Navigation Data – Message ID 41 over a PayloadView.
+    Check valid() before reading fields.
+  */
+  class GeodeticNavigationDataView : public PayloadView {
+  public:
+    GeodeticNavigationDataView(const PayloadView &in_view)
+      : PayloadView(in_view) {
+
+    }
+
+    bool valid() const {
+      return messageID() == GeodeticNavigationDataID
+        && m_length >= sizeof(GeodeticNavigationData) + 1;
+    }
+
+    SIRF_VIEW_FIELD(uint16_t,GeodeticNavigationData,navValid,u16)
+    SIRF_VIEW_FIELD(uint16_t,GeodeticNavigationData,navType,u16)
+    SIRF_VIEW_FIELD(uint16_t,GeodeticNavigationData,extendedWeekNumber,u16)
+    SIRF_VIEW_FIELD(uint32_t,GeodeticNavigationData,TOW,u32)
+    SIRF_VIEW_FIELD(uint16_t,GeodeticNavigationData,UTCYear,u16)
+    SIRF_VIEW_FIELD(uint8_t,GeodeticNavigationData,UTCMonth,u8)
+    SIRF_VIEW_FIELD(uint8_t,GeodeticNavigationData,UTCDay,u8)
+    SIRF_VIEW_FIELD(uint8_t,GeodeticNavigationData,UTCHour,u8)
+    SIRF_VIEW_FIELD(uint8_t,GeodeticNavigationData,UTCMinute,u8)
+    SIRF_VIEW_FIELD(uint16_t,GeodeticNavigationData,UTCSecond,u16)
+    SIRF_VIEW_FIELD(uint32_t,GeodeticNavigationData,satelliteIDList,u32)
+    SIRF_VIEW_FIELD(int32_t,GeodeticNavigationData,latitude,s32)
+    SIRF_VIEW_FIELD(int32_t,GeodeticNavigationData,longitude,s32)
+    SIRF_VIEW_FIELD(int32_t,GeodeticNavigationData,altitudeFromEllipsoid,s32)
+    SIRF_VIEW_FIELD(int32_t,GeodeticNavigationData,altitudeFromMSL,s32)
+    SIRF_VIEW_FIELD(uint16_t,GeodeticNavigationData,speedOverGround,u16)
+    SIRF_VIEW_FIELD(uint16_t,GeodeticNavigationData,courseOverGround,u16)
+    SIRF_VIEW_FIELD(int16_t,GeodeticNavigationData,climbRate,s16)
+    SIRF_VIEW_FIELD(uint32_t,GeodeticNavigationData,estimatedHorizontalPositionError,u32)
+    SIRF_VIEW_FIELD(uint8_t,GeodeticNavigationData,numberOfSVsInFix,u8)
+    SIRF_VIEW_FIELD(uint8_t,GeodeticNavigationData,HDOP,u8)
+  };
+
+#undef SIRF_VIEW_FIELD
+
   inline void write32(uint32_t *dst,uint32_t src) {
-    uint8_t *p = (uint8_t *)dst;
-    *p++ = (src >> 24) & 0xff;
-    *p++ = (src >> 16) & 0xff;
-    *p++ = (src >> 8) & 0xff;
-    *p++ = src & 0xff;
+    util::writeBE32(dst,src);
   }
 
   template<class T>
@@ -276,7 +502,7 @@ namespace SiRF {
       for (int i = 0;i < l;i++) {
         t += dat[i];
       }
-      return t & 0x7ff;
+      return t & 0x7fff;
     }
 
     void _write(uint8_t *dat,int l) {
@@ -296,7 +522,10 @@ namespace SiRF {
   class MessageParser {
   public:
     MessageParser()
-      : m_enabled(1) {
+      : m_layout(NULL),
+        m_msgPos(0),
+        m_enabled(1),
+        m_done(0) {
       m_msg.messageID = 0;
     }
 
@@ -304,18 +533,19 @@ namespace SiRF {
       bool res = false;
       if (m_enabled) {
         if (m_msg.messageID == 0) {
-          switch(c) {
-            case GeodeticNavigationDataID:
-              m_msg.messageID = c;
-              m_msgPos = 1;
-              res = true;
-              break;
+          m_layout = findMessageLayout(c);
+          if (m_layout) {
+            memset(&m_msg.messageBody,0xff,m_layout->length);
+            m_msg.messageID = c;
+            m_msgPos = 1;
+            res = true;
           }
         } else {
-          switch(m_msg.messageID) {
-            case GeodeticNavigationDataID:
-              res = _processGeodeticNavigationData(c);
-              break;
+          ((uint8_t *)&m_msg)[m_msgPos++] = c;
+          if (m_msgPos == m_layout->length + 1) {
+            finish();
+          } else {
+            res = true;
           }
         }
         if (!res)
@@ -324,12 +554,46 @@ namespace SiRF {
       return res;
     }
 
+    /**
+      Parse a whole payload at once
+      @param in_payload payload, message ID first
+      @param in_length payload length
+      @return true if the message was decoded
+    */
+    bool parse(const uint8_t *in_payload,size_t in_length) {
+      reset();
+      m_enabled = 0;
+      if (in_length == 0 || (m_layout = findMessageLayout(in_payload[0])) == NULL)
+        return false;
+      size_t l = in_length - 1;
+      if (l > m_layout->length)
+        l = m_layout->length;
+      m_msg.messageID = in_payload[0];
+      memcpy(&m_msg.messageBody,in_payload + 1,l);
+      memset((uint8_t *)&m_msg.messageBody + l,0xff,m_layout->length - l);
+      m_msgPos = l + 1;
+      finish();
+      return m_done;
+    }
+
+    /**
+      Called at the end of the payload, completes
+      a variable length message
+    */
+    void finish() {
+      if (m_layout && !m_done && m_msgPos >= m_layout->minLength + 1) {
+        _convert();
+        m_done = 1;
+      }
+    }
+
     const OutputMessage &lastMessage() const {
       return m_msg;
     }
 
     void reset() {
       m_msg.messageID = 0;
+      m_layout = NULL;
       m_msgPos = 0;
       m_enabled = 1;
       m_done = 0;
@@ -338,15 +602,55 @@ namespace SiRF {
     bool done() const {
       return m_done;
     }
+
+    /**
+      Copy the message in progress
+      @param out_data destination
+      @param in_size out_data size
+      @return bytes written, 0 if in_size is too small
+    */
+    size_t save(uint8_t *out_data,size_t in_size) const {
+      size_t body = m_layout ? m_layout->length : 0;
+      if (in_size < body + 4)
+        return 0;
+      out_data[0] = m_msg.messageID;
+      out_data[1] = m_msgPos;
+      out_data[2] = m_enabled;
+      out_data[3] = m_done;
+      memcpy(out_data + 4,&m_msg.messageBody,body);
+      return body + 4;
+    }
+
+    /**
+      Continue a message saved by save() of the same build
+      @return false if in_data is not a valid state, nothing is changed then
+    */
+    bool load(const uint8_t *in_data,size_t in_length) {
+      if (in_length < 4)
+        return false;
+      const MessageLayout *layout = in_data[0] ? findMessageLayout(in_data[0]) : NULL;
+      size_t body = layout ? layout->length : 0;
+      if ((in_data[0] && layout == NULL) || in_length != body + 4 || in_data[1] > body + 1)
+        return false;
+      m_layout = layout;
+      m_msg.messageID = in_data[0];
+      m_msgPos = in_data[1];
+      m_enabled = in_data[2] != 0;
+      m_done = in_data[3] != 0;
+      memcpy(&m_msg.messageBody,in_data + 4,body);
+      return true;
+    }
   private:
     OutputMessage
       m_msg;
+    const MessageLayout
+      *m_layout;
     uint8_t
       m_msgPos,
       m_enabled,
       m_done;
 
-    bool _processGeodeticNavigationData(int c);
+    void _convert();
   };
 
   template<class T>
@@ -354,37 +658,339 @@ namespace SiRF {
   public:
     PacketParser(T &serial,MessageParser &parser)
       : m_serial(serial),
-        m_parser(parser),
         m_state(START_SEQUENCE),
         m_tmpBufferPos(0),
-        m_handler(NULL) {
-
+        m_payloadLength(0),
+        m_payloadChecksum(0),
+        m_readPayload(0),
+        m_handler(NULL),
+        m_viewHandler(NULL),
+        m_payloadBuffer(NULL),
+        m_payloadBufferSize(0),
+        m_deferred(0),
+        m_rawHandler(NULL),
+        m_rawBuffer(NULL),
+        m_rawBufferSize(0),
+        m_rawAll(0),
+        m_capturing(0),
+        m_parser(parser),
+        m_windowStart(0),
+        m_windowPos(0),
+        m_windowLength(0),
+        m_overflowBytes(0),
+        m_retry(0),
+        m_frames(0),
+        m_resyncs(0),
+        m_discardedBytes(0) {
+      m_tmpBuffer[0] = 0;
+      m_tmpBuffer[1] = 0;
     }
     void polling() {
-      for (int l = m_serial.available();l > 0;l--) {
-    		int c = m_serial.read();
-        switch(m_state) {
-          case START_SEQUENCE:
-            _processStartSequence(c);
-            break;
-          case PAYLOAD_LENGTH:
-            _processPayloadLength(c);
-            break;
-          case PAYLOAD:
-            _processPayload(c);
-            break;
-          case CHECKSUM:
-            _processChecksum(c);
-            break;
-          case END_SEQUENCE:
-            _processEndSequence(c);
-            break;
+      uint8_t buf[POLLING_BUFFER_SIZE];
+      int l = m_serial.available();
+      while (l > 0) {
+        int n = l < POLLING_BUFFER_SIZE ? l : POLLING_BUFFER_SIZE;
+        for (int i = 0;i < n;i++) {
+          buf[i] = m_serial.read();
+        }
+        feed(buf,n);
+        l -= n;
+      }
+    }
+
+    /**
+      Parse received bytes.
+      Frames which are entirely in the buffer are located with memchr and
+      validated at once; only a frame split across calls goes through the
+      per byte state machine.
+      @param in_data received bytes
+      @param in_length number of bytes
+    */
+    void feed(const uint8_t *in_data,size_t in_length) {
+      const uint8_t *p = in_data;
+      const uint8_t *end = in_data + in_length;
+
+      // finish a frame started by a previous call
+      while (p < end && !_idle()) {
+        if (m_state == PAYLOAD && m_deferred) {
+          size_t n = m_payloadLength - m_tmpBufferPos;
+          if (n > (size_t)(end - p))
+            n = end - p;
+          _record(p,n);
+          if (m_tmpBufferPos == 0)
+            _startCapture(*p);
+          if (m_capturing)
+            memcpy(m_rawBuffer + 4 + m_tmpBufferPos,p,n);
+          memcpy(m_payloadBuffer + m_tmpBufferPos,p,n);
+          p += n;
+          m_tmpBufferPos += n;
+          if (m_tmpBufferPos == m_payloadLength)
+            _next(CHECKSUM);
+          continue;
+        }
+        _input(*p++);
+      }
+
+      while (p < end) {
+        const uint8_t *q = (const uint8_t *)memchr(p,0xa0,end - p);
+        if (q == NULL) {
+          m_discardedBytes += end - p;
+          return;
         }
-    	}
+        m_discardedBytes += q - p;
+        p = q;
+
+        size_t remain = end - p;
+        if (remain < 4) {
+          break;
+        }
+        if (p[1] != 0xa2) {
+          p += _falseStart(2);
+          continue;
+        }
+        if (p[2] > 0x7f) {
+          p += _falseStart(3);
+          continue;
+        }
+        uint16_t length = (p[2] << 8) | p[3];
+        if (length > SIRF_MAX_PAYLOAD_LENGTH) {
+          p += _falseStart(4);
+          continue;
+        }
+        if (remain < (size_t)length + 8) {
+          break;
+        }
+        const uint8_t *payload = p + 4;
+        const uint8_t *trailer = payload + length;
+        // frame bytes up to the one the state machine rejects, 0 if valid
+        size_t rejected = 0;
+        if (trailer[0] > 0x7f)
+          rejected = length + 5;
+        else
+        if (!_checkPayloadChecksum(util::byteSum(payload,length),(trailer[0] << 8) | trailer[1]))
+          rejected = length + 6;
+        else
+        if (trailer[2] != 0xb0)
+          rejected = length + 7;
+        else
+        if (trailer[3] != 0xb3)
+          rejected = length + 8;
+        if (rejected == 0) {
+          m_frames++;
+          if (m_viewHandler && length > 0) {
+            (*m_viewHandler)(PayloadView(payload,length));
+          }
+          if (m_rawHandler && length > 0 && _captures(payload[0])) {
+            (*m_rawHandler)(p,length + 8);
+          }
+          if (m_handler) {
+            m_parser.parse(payload,length);
+            _done();
+          }
+          p = trailer + 4;
+        } else {
+          p += _falseStart(rejected);
+        }
+      }
+
+      // keep the incomplete frame in the state machine
+      while (p < end) {
+        _input(*p++);
+      }
     }
+
     void setHandler(OutputMessageHandler handler) {
       m_handler = handler;
     }
+
+    /**
+      Receive validated payloads without decoding them.
+      A frame wholly inside one feed() call is viewed in place, a frame
+      split across calls only when it fits the payload buffer.
+      Both handlers may be set, the view handler is called first.
+      @param in_handler view handler
+    */
+    void setViewHandler(PayloadViewHandler in_handler) {
+      m_viewHandler = in_handler;
+    }
+
+    /**
+      Buffer for frames split across feed() calls. A payload which fits
+      is stored, its checksum and end sequence are checked, and only then
+      it is decoded; larger payloads are decoded while they arrive.
+      @param in_buffer payload buffer or NULL
+      @param in_size in_buffer size
+    */
+    void setPayloadBuffer(uint8_t *in_buffer,uint16_t in_size) {
+      m_payloadBuffer = in_buffer;
+      m_payloadBufferSize = in_buffer ? in_size : 0;
+    }
+
+    /**
+      Forward whole frames of message IDs MessageParser does not decode,
+      or of every message ID. Frames split across feed() calls are
+      assembled in in_buffer and dropped when they do not fit.
+      @param in_handler raw frame handler
+      @param in_buffer frame buffer, up to SIRF_MAX_PAYLOAD_LENGTH + 8 bytes
+      @param in_size in_buffer size
+      @param in_all true to forward decoded message IDs too
+    */
+    void setRawHandler(RawFrameHandler in_handler,uint8_t *in_buffer = NULL,uint16_t in_size = 0,bool in_all = false) {
+      m_rawHandler = in_handler;
+      m_rawBuffer = in_buffer;
+      m_rawBufferSize = in_buffer ? in_size : 0;
+      m_rawAll = in_all;
+    }
+
+    //! number of valid frames received
+    uint32_t frames() const {
+      return m_frames;
+    }
+
+    //! number of false frame starts abandoned
+    uint32_t resyncs() const {
+      return m_resyncs;
+    }
+
+    //! number of bytes which did not belong to a valid frame
+    uint32_t discardedBytes() const {
+      return m_discardedBytes;
+    }
+
+    void resetCounters() {
+      m_frames = 0;
+      m_resyncs = 0;
+      m_discardedBytes = 0;
+    }
+
+    /**
+      End the frame in progress, its stream was cut short as by a port
+      reset. Its bytes are rescanned for a frame start as after a bad
+      checksum, and whatever is left of them is discarded.
+    */
+    void cut() {
+      while (!_idle()) {
+        m_resyncs++;
+        _reset();
+        if (m_overflowBytes > 0) {
+          m_discardedBytes += m_windowLength - m_windowStart + m_overflowBytes;
+          break;
+        }
+        m_discardedBytes++;
+        m_windowPos = m_windowStart + 1;
+        while (m_windowPos < m_windowLength) {
+          if (_idle())
+            m_windowStart = m_windowPos;
+          _process(m_window[m_windowPos++]);
+        }
+      }
+      _clearWindow();
+    }
+
+    /**
+      Copy the state between two feed() calls, including the frame in
+      progress, the backtrack window, received payload bytes and the
+      message being decoded. Fields are stored big endian.
+      @param out_data destination
+      @param in_size out_data size
+      @return bytes written, 0 if in_size is too small
+    */
+    size_t save(uint8_t *out_data,size_t in_size) const {
+      uint16_t window = m_windowLength - m_windowStart;
+      uint16_t received = _received();
+      uint16_t payload = m_deferred ? received : 0;
+      uint16_t raw = m_capturing ? received : 0;
+      size_t l = STATE_HEADER_SIZE + window + payload + raw;
+      if (in_size < l)
+        return 0;
+      uint8_t *p = out_data;
+      *p++ = m_state;
+      *p++ = m_tmpBuffer[0];
+      *p++ = m_tmpBuffer[1];
+      util::writeBE16(p,m_tmpBufferPos); p += 2;
+      util::writeBE16(p,m_payloadLength); p += 2;
+      util::writeBE16(p,m_payloadChecksum); p += 2;
+      *p++ = m_readPayload;
+      *p++ = m_deferred;
+      *p++ = m_capturing;
+      util::writeBE16(p,m_overflowBytes); p += 2;
+      util::writeBE16(p,window); p += 2;
+      util::writeBE16(p,m_windowPos - m_windowStart); p += 2;
+      util::writeBE32(p,m_frames); p += 4;
+      util::writeBE32(p,m_resyncs); p += 4;
+      util::writeBE32(p,m_discardedBytes); p += 4;
+      memcpy(p,m_window + m_windowStart,window); p += window;
+      if (payload)
+        memcpy(p,m_payloadBuffer,payload);
+      p += payload;
+      if (raw)
+        memcpy(p,m_rawBuffer + 4,raw);
+      p += raw;
+      size_t n = m_parser.save(p,in_size - l);
+      return n ? l + n : 0;
+    }
+
+    /**
+      Continue from a state saved by save(). Payload and raw frame
+      buffers must be set as they were when the state was saved.
+      @return false if in_data is not a valid state for this parser,
+              nothing is changed then
+    */
+    bool load(const uint8_t *in_data,size_t in_length) {
+      if (in_length < STATE_HEADER_SIZE)
+        return false;
+      const uint8_t *p = in_data;
+      uint8_t state = p[0];
+      uint16_t tmpBufferPos = util::readBE16(p + 3);
+      uint16_t payloadLength = util::readBE16(p + 5);
+      uint8_t deferred = p[10] != 0;
+      uint8_t capturing = p[11] != 0;
+      uint16_t window = util::readBE16(p + 14);
+      uint16_t windowPos = util::readBE16(p + 16);
+      if (state > END_SEQUENCE || tmpBufferPos > (state == PAYLOAD ? payloadLength : 1) || payloadLength > SIRF_MAX_PAYLOAD_LENGTH ||
+          window > SIRF_RESYNC_WINDOW || windowPos > window)
+        return false;
+      // the flags are left over from the last frame outside a payload
+      bool frame = state >= PAYLOAD;
+      uint16_t received = state == PAYLOAD ? tmpBufferPos : frame ? payloadLength : 0;
+      uint16_t payload = deferred ? received : 0;
+      uint16_t raw = capturing ? received : 0;
+      size_t l = STATE_HEADER_SIZE + window + payload + raw;
+      if (in_length <= l ||
+          (frame && deferred && payloadLength > m_payloadBufferSize) ||
+          (frame && capturing && (m_rawHandler == NULL || payloadLength + 8 > m_rawBufferSize)))
+        return false;
+      if (!m_parser.load(in_data + l,in_length - l))
+        return false;
+
+      m_state = state;
+      m_tmpBuffer[0] = p[1];
+      m_tmpBuffer[1] = p[2];
+      m_tmpBufferPos = tmpBufferPos;
+      m_payloadLength = payloadLength;
+      m_payloadChecksum = util::readBE16(p + 7);
+      m_readPayload = p[9] != 0;
+      m_deferred = deferred;
+      m_capturing = capturing;
+      m_overflowBytes = util::readBE16(p + 12);
+      m_frames = util::readBE32(p + 18);
+      m_resyncs = util::readBE32(p + 22);
+      m_discardedBytes = util::readBE32(p + 26);
+      p += STATE_HEADER_SIZE;
+      m_windowStart = 0;
+      m_windowPos = windowPos;
+      m_windowLength = window;
+      memcpy(m_window,p,window); p += window;
+      if (payload)
+        memcpy(m_payloadBuffer,p,payload);
+      p += payload;
+      if (frame && capturing) {
+        _captureHeader();
+        if (raw)
+          memcpy(m_rawBuffer + 4,p,raw);
+      }
+      return true;
+    }
   private:
     enum {
       START_SEQUENCE,
@@ -393,25 +999,145 @@ namespace SiRF {
       CHECKSUM,
       END_SEQUENCE,
 
-      MAX_SIRF_PAYLOAD_LENGTH = 1024
+      POLLING_BUFFER_SIZE = 64,
+      STATE_HEADER_SIZE = 30    //!< fixed part of save()
     };
 
     T &m_serial;
 
     uint8_t m_state;
     uint8_t m_tmpBuffer[2];
-    int16_t m_tmpBufferPos;
-    int16_t m_payloadLength;
-    int16_t m_payloadChecksum;
+    uint16_t m_tmpBufferPos;
+    uint16_t m_payloadLength;
+    uint16_t m_payloadChecksum;
     uint8_t m_readPayload;
 
     OutputMessageHandler m_handler;
+    PayloadViewHandler m_viewHandler;
+    uint8_t *m_payloadBuffer;
+    uint16_t m_payloadBufferSize;
+    uint8_t m_deferred;
+    RawFrameHandler m_rawHandler;
+    uint8_t *m_rawBuffer;
+    uint16_t m_rawBufferSize;
+    uint8_t m_rawAll;
+    uint8_t m_capturing;
     MessageParser &m_parser;
 
+    /*
+      Backtrack window: the bytes of the frame in progress, from its
+      0xa0 (m_windowStart) to the last byte received (m_windowLength).
+      Bytes up to m_windowPos have been processed, the rest are waiting
+      to be rescanned after a false start.
+      m_overflowBytes counts bytes that did not fit.
+    */
+    uint8_t m_window[SIRF_RESYNC_WINDOW > 0 ? SIRF_RESYNC_WINDOW : 1];
+    uint16_t m_windowStart;
+    uint16_t m_windowPos;
+    uint16_t m_windowLength;
+    uint16_t m_overflowBytes;
+    uint8_t m_retry;        //!< the byte being input is to be input again
+
+    uint32_t m_frames;
+    uint32_t m_resyncs;
+    uint32_t m_discardedBytes;
+
     inline void _reset() {
       m_tmpBufferPos = 0;
       m_state = START_SEQUENCE;
     }
+    inline bool _idle() const {
+      return m_state == START_SEQUENCE && m_tmpBufferPos == 0;
+    }
+    //! payload bytes of the frame in progress received so far
+    inline uint16_t _received() const {
+      return m_state == PAYLOAD ? m_tmpBufferPos : m_state > PAYLOAD ? m_payloadLength : 0;
+    }
+    /*
+      A false start found in place, rejected at its in_length th byte.
+      Like _resync(), rescan from the byte after the 0xa0 when the state
+      machine would have kept those bytes in the window, else drop all
+      but the rejecting byte, so the result does not depend on how the
+      stream is chunked.
+      @return bytes to skip
+    */
+    inline size_t _falseStart(size_t in_length) {
+      m_resyncs++;
+      size_t n = in_length <= SIRF_RESYNC_WINDOW ? 1 : in_length - 1;
+      m_discardedBytes += n;
+      return n;
+    }
+
+    void _compactWindow() {
+      if (m_windowStart > 0) {
+        m_windowLength -= m_windowStart;
+        m_windowPos -= m_windowStart;
+        memmove(m_window,m_window + m_windowStart,m_windowLength);
+        m_windowStart = 0;
+      }
+    }
+
+    void _record(const uint8_t *in_data,size_t in_length) {
+      if (m_overflowBytes == 0 && m_windowLength + in_length > SIRF_RESYNC_WINDOW)
+        _compactWindow();
+      if (m_overflowBytes == 0 && m_windowLength + in_length <= SIRF_RESYNC_WINDOW) {
+        memcpy(m_window + m_windowLength,in_data,in_length);
+        m_windowLength += in_length;
+        m_windowPos = m_windowLength;
+      } else {
+        m_overflowBytes += in_length;
+      }
+    }
+
+    void _input(uint8_t c) {
+      if (m_overflowBytes == 0 && m_windowLength == SIRF_RESYNC_WINDOW)
+        _compactWindow();
+      if (m_overflowBytes > 0 || m_windowLength == SIRF_RESYNC_WINDOW) {
+        // without a window every byte of the frame counts here
+        m_overflowBytes++;
+        _process(c);
+        if (_idle())
+          _clearWindow();
+        if (m_retry) {
+          // c rejected the frame, it may start the next one
+          m_retry = 0;
+          _input(c);
+        }
+        return;
+      }
+      m_window[m_windowLength++] = c;
+      while (m_windowPos < m_windowLength) {
+        if (_idle())
+          m_windowStart = m_windowPos;
+        _process(m_window[m_windowPos++]);
+      }
+      if (_idle())
+        _clearWindow();
+    }
+
+    inline void _clearWindow() {
+      m_windowStart = 0;
+      m_windowPos = 0;
+      m_windowLength = 0;
+      m_overflowBytes = 0;
+    }
+
+    /*
+      Abandon the frame in progress and rescan the window
+      from the byte after its 0xa0
+    */
+    void _resync() {
+      m_resyncs++;
+      _reset();
+      if (m_overflowBytes > 0) {
+        m_discardedBytes += m_windowLength - m_windowStart + m_overflowBytes - 1;
+        m_retry = 1;
+        _clearWindow();
+      } else {
+        m_discardedBytes++;
+        m_windowPos = m_windowStart + 1;
+      }
+    }
     inline void _next(int next) {
       m_tmpBufferPos = 0;
       m_state = next;
@@ -422,8 +1148,48 @@ namespace SiRF {
       }
     }
 
-    inline bool _checkPayloadChecksum(int cs) {
-      return ((m_payloadChecksum & 0x7fff) == cs);
+    inline bool _captures(int in_messageID) const {
+      return m_rawAll || findMessageLayout(in_messageID) == NULL;
+    }
+
+    /*
+      Called with the first payload byte of a frame split across calls
+    */
+    inline void _startCapture(int in_messageID) {
+      m_capturing = m_payloadLength + 8 <= m_rawBufferSize && m_rawHandler && _captures(in_messageID);
+      if (m_capturing)
+        _captureHeader();
+    }
+
+    inline void _captureHeader() {
+      m_rawBuffer[0] = 0xa0;
+      m_rawBuffer[1] = 0xa2;
+      m_rawBuffer[2] = m_payloadLength >> 8;
+      m_rawBuffer[3] = m_payloadLength & 0xff;
+    }
+
+    static inline bool _checkPayloadChecksum(int sum,int cs) {
+      return ((sum & 0x7fff) == cs);
+    }
+
+    void _process(int c) {
+      switch(m_state) {
+        case START_SEQUENCE:
+          _processStartSequence(c);
+          break;
+        case PAYLOAD_LENGTH:
+          _processPayloadLength(c);
+          break;
+        case PAYLOAD:
+          _processPayload(c);
+          break;
+        case CHECKSUM:
+          _processChecksum(c);
+          break;
+        case END_SEQUENCE:
+          _processEndSequence(c);
+          break;
+      }
     }
 
     void _processStartSequence(int c) {
@@ -432,8 +1198,11 @@ namespace SiRF {
       } else
       if (m_tmpBufferPos == 1 && c == 0xa2) {
         _next(PAYLOAD_LENGTH);
+      } else
+      if (m_tmpBufferPos == 1) {
+        _resync();
       } else {
-        _reset();
+        m_discardedBytes++;
       }
     }
 
@@ -444,26 +1213,39 @@ namespace SiRF {
       } else
       if (m_tmpBufferPos == 1) {
         m_tmpBuffer[0] = c;
-        m_payloadLength = *((uint16_t *)m_tmpBuffer);
-        if (m_payloadLength < MAX_SIRF_PAYLOAD_LENGTH) {
+        m_payloadLength = (m_tmpBuffer[1] << 8) | m_tmpBuffer[0];
+        if (m_payloadLength <= SIRF_MAX_PAYLOAD_LENGTH) {
           m_payloadChecksum = 0;
-          m_readPayload = 1;
+          m_capturing = 0;
+          m_deferred = m_payloadLength <= m_payloadBufferSize;
+          m_readPayload = m_handler != NULL && !m_deferred;
           m_parser.reset();
-          _next(PAYLOAD);
+          _next(m_payloadLength > 0 ? PAYLOAD : CHECKSUM);
         } else {
-          _reset();
+          _resync();
         }
       } else {
-        _reset();
+        _resync();
       }
     }
 
     void _processPayload(int c) {
-      if (m_readPayload)
-        m_readPayload = m_parser.parse(c);
-      m_tmpBufferPos++;
+      if (m_tmpBufferPos == 0)
+        _startCapture(c);
+      if (m_capturing)
+        m_rawBuffer[4 + m_tmpBufferPos] = c;
+      if (m_deferred) {
+        m_payloadBuffer[m_tmpBufferPos++] = c;
+      } else {
+        if (m_readPayload)
+          m_readPayload = m_parser.parse(c);
+        m_payloadChecksum = (m_payloadChecksum + c) & 0x7fff;
+        m_tmpBufferPos++;
+      }
 
       if (m_tmpBufferPos == m_payloadLength) {
+        if (!m_deferred)
+          m_parser.finish();
         _next(CHECKSUM);
       }
     }
@@ -475,14 +1257,16 @@ namespace SiRF {
       } else
       if (m_tmpBufferPos == 1) {
         m_tmpBuffer[0] = c;
-        int checksum = *((uint16_t *)m_tmpBuffer);
-        if (_checkPayloadChecksum(checksum)) {
+        int checksum = (m_tmpBuffer[1] << 8) | m_tmpBuffer[0];
+        if (m_deferred)
+          m_payloadChecksum = util::byteSum(m_payloadBuffer,m_payloadLength) & 0x7fff;
+        if (_checkPayloadChecksum(m_payloadChecksum,checksum)) {
           _next(END_SEQUENCE);
         } else {
-          _reset();
+          _resync();
         }
       } else {
-        _reset();
+        _resync();
       }
     }
 
@@ -491,68 +1275,73 @@ namespace SiRF {
         m_tmpBufferPos = 1;
       } else
       if (m_tmpBufferPos == 1 && c == 0xb3) {
+        m_frames++;
+        if (m_capturing) {
+          uint8_t *trailer = m_rawBuffer + 4 + m_payloadLength;
+          trailer[0] = m_payloadChecksum >> 8;
+          trailer[1] = m_payloadChecksum & 0xff;
+          trailer[2] = 0xb0;
+          trailer[3] = 0xb3;
+          (*m_rawHandler)(m_rawBuffer,m_payloadLength + 8);
+        }
+        if (m_deferred && m_payloadLength > 0) {
+          if (m_viewHandler)
+            (*m_viewHandler)(PayloadView(m_payloadBuffer,m_payloadLength));
+          if (m_handler)
+            m_parser.parse(m_payloadBuffer,m_payloadLength);
+        }
         _done();
         _reset();
       } else {
-        _reset();
+        _resync();
       }
     }
   };
 
   inline void _swap16(void *io) {
-    uint8_t *p = (uint8_t *)io;
-    uint8_t t = p[0];
-    p[0] = p[1];
-    p[1] = t;
+    uint16_t v;
+    memcpy(&v,io,sizeof(v));
+    v = util::bswap16(v);
+    memcpy(io,&v,sizeof(v));
   }
 
   inline void _swap32(void *io) {
-    uint8_t *p = (uint8_t *)io;
-    uint8_t t = p[0];
-    p[0] = p[3];
-    p[3] = t;
-    t = p[1];
-    p[1] = p[2];
-    p[2] = t;
+    uint32_t v;
+    memcpy(&v,io,sizeof(v));
+    v = util::bswap32(v);
+    memcpy(io,&v,sizeof(v));
   }
 
-  inline bool
-  MessageParser::_processGeodeticNavigationData(int c) {
-    ((uint8_t *)&m_msg)[m_msgPos++] = c;
-    if (m_msgPos == sizeof(GeodeticNavigationData) + 1) {
-      _swap16(&m_msg.messageBody.geodeticNavigationData.navValid);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.navType);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.extendedWeekNumber);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.TOW);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.UTCYear);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.UTCSecond);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.satelliteIDList);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.latitude);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.longitude);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.altitudeFromEllipsoid);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.altitudeFromMSL);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.speedOverGround);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.courseOverGround);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.magneticVariation);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.climbRate);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.headingRate);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.estimatedHorizontalPositionError);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.estimatedVerticalPositionError);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.estimatedTimeError);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.estimatedHorizontalVelocityError);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.clockBias);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.clockBiasError);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.clockDrift);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.clockDriftError);
-      _swap32(&m_msg.messageBody.geodeticNavigationData.distance);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.distanceError);
-      _swap16(&m_msg.messageBody.geodeticNavigationData.headingError);
-
-      m_done = true;
-
-      return false;
-    }
-    return true;
+  /**
+    Big endian fields to host order, nothing to do on big endian hosts
+  */
+  inline void
+  MessageParser::_convert() {
+#ifndef GPS_BIG_ENDIAN_HOST
+    uint8_t *body = (uint8_t *)&m_msg.messageBody;
+#ifdef SIRF_USE_SHUFFLE
+    const ShuffleProgram &sp = shufflePrograms[m_layout - messageLayouts];
+    if (sp.count) {
+      for (uint8_t i = 0;i < sp.count;i++) {
+        __m128i *p = (__m128i *)(body + sp.offset[i]);
+        __m128i v = _mm_loadu_si128(p);
+        v = _mm_shuffle_epi8(v,_mm_loadu_si128((const __m128i *)sp.mask[i]));
+        _mm_storeu_si128(p,v);
+      }
+      return;
+    }
+#endif
+    for (uint8_t i = 0;i < m_layout->fieldCount;i++) {
+      const FieldLayout &f = m_layout->fields[i];
+      uint8_t *p = body + f.offset;
+      for (uint8_t n = 0;n < f.count;n++,p += f.stride) {
+        if (f.width == 2)
+          _swap16(p);
+        else
+          _swap32(p);
+      }
+    }
+#endif
   }
 
 } /* SiRF */
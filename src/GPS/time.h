@@ -0,0 +1,260 @@
+/**
+  @file time.h
+
+  UTC / GPS time conversion to epoch nanoseconds.
+  Table driven, locale and TZ independent, no allocation.
+
+  @author Osamu Takahashi
+*/
+#ifndef __GPS_time_h
+#define __GPS_time_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <GPS/nmea.h>
+#include <GPS/sirf.h>
+
+/**
+  Returned for unset (0xff filled) or out of range dates
+*/
+#define GPS_TIME_INVALID  INT64_MIN
+
+#define GPS_NANOS_PER_SECOND  1000000000LL
+#define GPS_SECONDS_PER_WEEK  604800L
+
+//! 1980-01-06 00:00:00 UTC in UNIX seconds
+#define GPS_EPOCH_UNIX        315964800L
+
+namespace GPS {
+
+namespace util {
+
+  /**
+    Days before the first of each month, counted from March 1st
+  */
+  constexpr uint16_t daysFromMarch[12] =
+      {
+        306,  337,    0,   31,   61,   92,  122,  153,  184,  214,
+        245,  275
+      } ;
+
+  /**
+    UNIX UTC seconds at which GPS - UTC became 1, 2, ... leapSecondCount seconds.
+    Update when IERS announces a new leap second
+  */
+  constexpr uint32_t leapSecondTable[] =
+      {
+        362793600UL,    // 1981-07-01
+        394329600UL,    // 1982-07-01
+        425865600UL,    // 1983-07-01
+        489024000UL,    // 1985-07-01
+        567993600UL,    // 1988-01-01
+        631152000UL,    // 1990-01-01
+        662688000UL,    // 1991-01-01
+        709948800UL,    // 1992-07-01
+        741484800UL,    // 1993-07-01
+        773020800UL,    // 1994-07-01
+        820454400UL,    // 1996-01-01
+        867715200UL,    // 1997-07-01
+        915148800UL,    // 1999-01-01
+        1136073600UL,   // 2006-01-01
+        1230768000UL,   // 2009-01-01
+        1341100800UL,   // 2012-07-01
+        1435708800UL,   // 2015-07-01
+        1483228800UL    // 2017-01-01
+      } ;
+
+  constexpr uint8_t leapSecondCount = sizeof(leapSecondTable) / sizeof(leapSecondTable[0]);
+
+  //! 400 year era of a year counted from March
+  constexpr int32_t eraOf(int32_t in_year) {
+    return (in_year >= 0 ? in_year : in_year - 399) / 400;
+  }
+
+  //! day within an era of a year of era and day of year counted from March 1st
+  constexpr uint32_t dayOfEra(uint32_t in_yoe,uint32_t in_doy) {
+    return in_yoe * 365 + in_yoe / 4 - in_yoe / 100 + in_doy;
+  }
+
+  //! days since 1970-01-01 of a year counted from March and day of that year
+  constexpr int32_t daysFromMarchYear(int32_t in_year,uint32_t in_doy) {
+    return eraOf(in_year) * 146097
+      + (int32_t)dayOfEra((uint32_t)(in_year - eraOf(in_year) * 400),in_doy) - 719468;
+  }
+
+  /**
+    Convert a proleptic Gregorian date to days since 1970-01-01,
+    usable as a constant expression
+    @param in_year full year
+    @param in_month 1 - 12
+    @param in_day 1 - 31
+    @return days since UNIX epoch
+  */
+  constexpr int32_t daysFromCivil(int in_year,unsigned in_month,unsigned in_day) {
+    return daysFromMarchYear(in_year - (in_month <= 2),daysFromMarch[in_month - 1] + in_day - 1);
+  }
+
+  /**
+    Convert days since 1970-01-01 to a proleptic Gregorian date
+    @see daysFromCivil
+  */
+  inline void civilFromDays(int32_t in_days,int *out_year,unsigned *out_month,unsigned *out_day) {
+    in_days += 719468;
+    int32_t era = (in_days >= 0 ? in_days : in_days - 146096) / 146097;
+    uint32_t doe = (uint32_t)(in_days - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    *out_day = doy - (153 * mp + 2) / 5 + 1;
+    *out_month = mp < 10 ? mp + 3 : mp - 9;
+    *out_year = (int)yoe + era * 400 + (*out_month <= 2);
+  }
+
+  /**
+    GPS - UTC offset at a UTC instant
+    @param in_unix UNIX UTC seconds
+    @return leap seconds
+  */
+  inline int leapSecondsAtUTC(int64_t in_unix) {
+    int n = leapSecondCount;
+    while (n > 0 && in_unix < (int64_t)leapSecondTable[n - 1])
+      n--;
+    return n;
+  }
+
+  /**
+    GPS - UTC offset at a GPS instant
+    @param in_gps GPS seconds expressed on the UNIX time line
+    @return leap seconds
+  */
+  inline int leapSecondsAtGPS(int64_t in_gps) {
+    int n = leapSecondCount;
+    while (n > 0 && in_gps < (int64_t)leapSecondTable[n - 1] + n)
+      n--;
+    return n;
+  }
+
+  /**
+    Convert UTC calendar fields to UNIX epoch nanoseconds
+    @return nanoseconds or GPS_TIME_INVALID
+  */
+  inline int64_t utcToEpochNanos(int in_year,unsigned in_month,unsigned in_day,
+                                 unsigned in_hour,unsigned in_min,unsigned in_sec,uint32_t in_nanos) {
+    if (in_month - 1 >= 12 || in_day - 1 >= 31)
+      return GPS_TIME_INVALID;
+    int64_t s = (int64_t)daysFromCivil(in_year,in_month,in_day) * 86400
+      + in_hour * 3600L + in_min * 60L + in_sec;
+    return s * GPS_NANOS_PER_SECOND + in_nanos;
+  }
+
+  /**
+    Convert GPS week and time of week to UNIX UTC epoch nanoseconds
+    @param in_week extended (not modulo 1024) GPS week
+    @param in_towNanos time of week in nanoseconds
+    @return nanoseconds
+  */
+  inline int64_t gpsToEpochNanos(uint16_t in_week,int64_t in_towNanos) {
+    int64_t gps = GPS_EPOCH_UNIX + (int64_t)in_week * GPS_SECONDS_PER_WEEK
+      + in_towNanos / GPS_NANOS_PER_SECOND;
+    int64_t ns = (gps - leapSecondsAtGPS(gps)) * GPS_NANOS_PER_SECOND;
+    return ns + in_towNanos % GPS_NANOS_PER_SECOND;
+  }
+
+  /**
+    Convert UNIX UTC epoch nanoseconds to GPS week and time of week
+    @param in_nanos UNIX UTC epoch nanoseconds
+    @param out_week extended GPS week
+    @param out_towNanos time of week in nanoseconds
+  */
+  inline void epochNanosToGPS(int64_t in_nanos,uint16_t *out_week,int64_t *out_towNanos) {
+    int64_t s = in_nanos / GPS_NANOS_PER_SECOND;
+    int64_t g = s + leapSecondsAtUTC(s) - GPS_EPOCH_UNIX;
+    *out_week = g / GPS_SECONDS_PER_WEEK;
+    *out_towNanos = (g % GPS_SECONDS_PER_WEEK) * GPS_NANOS_PER_SECOND
+      + in_nanos % GPS_NANOS_PER_SECOND;
+  }
+
+  /**
+    Two digit NMEA year to full year, 80 - 99 are 19xx
+  */
+  inline int fullYear(unsigned in_year) {
+    return in_year + (in_year < 80 ? 2000 : 1900);
+  }
+
+  /**
+    UTC epoch nanoseconds of a NMEA date and time
+    @return nanoseconds or GPS_TIME_INVALID
+  */
+  inline int64_t epochNanos(const NMEA::Date &in_date,const NMEA::UTCTime &in_time) {
+    uint16_t msec = in_time.msec;
+    if (in_date.year > 99 || in_time.hour > 23)
+      return GPS_TIME_INVALID;
+    return utcToEpochNanos(fullYear(in_date.year),in_date.mon,in_date.day,
+      in_time.hour,in_time.min,in_time.sec,(msec < 1000 ? msec : 0) * 1000000UL);
+  }
+
+#ifdef NMEA_USE_RMC
+  inline int64_t epochNanos(const NMEA::RMC &in_rmc) {
+    return epochNanos(in_rmc.date,in_rmc.utcTime);
+  }
+#endif
+
+#ifdef NMEA_USE_ZDA
+  inline int64_t epochNanos(const NMEA::ZDA &in_zda) {
+    uint16_t msec = in_zda.utcTime.msec;
+    if (in_zda.year < 0 || in_zda.utcTime.hour > 23)
+      return GPS_TIME_INVALID;
+    return utcToEpochNanos(in_zda.year,in_zda.month,in_zda.day,
+      in_zda.utcTime.hour,in_zda.utcTime.min,in_zda.utcTime.sec,(msec < 1000 ? msec : 0) * 1000000UL);
+  }
+#endif
+
+#ifdef NMEA_USE_151
+  /**
+    UTC epoch nanoseconds from $PSRF151 week and time of week (s)
+  */
+  inline int64_t epochNanos(const NMEA::_151 &in_151) {
+    if (in_151.gpsWeek == 0xffff || in_151.gpsTOW >= GPS_SECONDS_PER_WEEK)
+      return GPS_TIME_INVALID;
+    return gpsToEpochNanos(in_151.gpsWeek,(int64_t)in_151.gpsTOW * GPS_NANOS_PER_SECOND);
+  }
+#endif
+
+  /**
+    UTC epoch nanoseconds from MID 41 extendedWeekNumber and TOW (ms)
+  */
+  inline int64_t epochNanos(const SiRF::GeodeticNavigationData &in_data) {
+    return gpsToEpochNanos(in_data.extendedWeekNumber,in_data.TOW * 1000000LL);
+  }
+
+  /**
+    Batch conversion
+    @param in_src array of RMC, ZDA, _151 or GeodeticNavigationData
+    @param in_n number of elements
+    @param out_nanos output, in_n elements
+  */
+  template<class M>
+  void epochNanos(const M *in_src,size_t in_n,int64_t *out_nanos) {
+    for (size_t i = 0;i < in_n;i++) {
+      out_nanos[i] = epochNanos(in_src[i]);
+    }
+  }
+
+  /**
+    Batch GPS week / TOW conversion
+    @param in_week extended GPS weeks
+    @param in_towMillis times of week in milliseconds
+    @param in_n number of elements
+    @param out_nanos output, in_n elements
+  */
+  inline void gpsToEpochNanos(const uint16_t *in_week,const uint32_t *in_towMillis,size_t in_n,int64_t *out_nanos) {
+    for (size_t i = 0;i < in_n;i++) {
+      out_nanos[i] = gpsToEpochNanos(in_week[i],in_towMillis[i] * 1000000LL);
+    }
+  }
+
+} /* util */
+
+} /* GPS */
+
+#endif /* __GPS_time_h */
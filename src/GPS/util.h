@@ -14,8 +14,15 @@
 #include <inttypes.h>
 #include <ctype.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define MAX_STRING_INPUT_BUFFER_SIZE  32
 
+//! longest NMEA output sentence without the checksum and CR LF
+#define NMEA_MAX_SENTENCE_LENGTH      77
+
 namespace GPS {
 
 namespace NMEA {
@@ -72,6 +79,19 @@ namespace NMEA {
   typedef NMEA_FLOAT decimal168_t;
   typedef NMEA_FLOAT decimal88_t;
 #endif
+
+#ifdef NMEA_USE_COORD_E7
+  /**
+    latitude / longitude in signed 1e-7 degrees,
+    south and west are negative
+  */
+  typedef int32_t coordinate_t;
+#else
+  /**
+    latitude / longitude in raw (d)ddmm.mmmm format
+  */
+  typedef decimal1616_t coordinate_t;
+#endif
 }
 
 namespace util {
@@ -212,75 +232,358 @@ namespace util {
     return t * sign;
   }
 
+  /**
+    Exact powers of ten, 1e0 - 1e22
+  */
+  extern const double pow10Table[];
+
+  /**
+    A template function; decoding decimal string to floating point value
+    Up to 15 significant digits are accumulated into an integer mantissa
+    below 2^53, which is scaled once by an exact power of ten from
+    pow10Table, so the result is the correctly rounded double of those
+    digits for up to 22 fractional digits. Later digits are truncated.
+    A float result is rounded from that double, so it may be one ulp off
+    in rare halfway cases.
+    @param F output type, float or double
+    @param in_buffer source buffer
+    @param in_p position in the buffer
+    @param in_length buffer length
+    @return decoded value
+  */
+  template<class F>
+  F decodeFloat(const int8_t *in_buffer,int in_p,int in_length) {
+    uint64_t t = 0;
+    const int8_t *p = in_buffer + in_p;
+    int i = in_p;
+    int digits = 0,fc = 0,dropped = 0;
+    bool negative = false;
+
+    if (*p == '-') {
+      negative = true;
+      p++;
+      i++;
+    }
+
+    for (;*p != '.' && i < in_length;i++,p++) {
+      if (isdigit(*p)) {
+        if (digits < 15) {
+          t = t * 10 + *p - '0';
+          digits += (t != 0);
+        } else {
+          dropped++;
+        }
+      }
+    }
+    if (*p == '.') {
+      p++;
+      i++;
+      for (;isdigit(*p) && i < in_length && digits < 15 && fc < 22;i++,p++,fc++) {
+        t = t * 10 + *p - '0';
+        digits += (t != 0);
+      }
+    }
+    // t < 10^15 < 2^53 and pow10Table[] are exact, so a single IEEE operation
+    // rounds correctly (Clinger's fast path)
+    double d = (double)t;
+    if (fc)
+      d /= pow10Table[fc];
+    else
+    if (dropped)
+      d *= pow10Table[dropped < 22 ? dropped : 22];
+    return (F)(negative ? -d : d);
+  }
+
+  /**
+    Decoding (d)ddmm.mmmmmmm string to signed 1e-7 degrees, integer only.
+    Up to 7 fractional digits of minutes are used, the result is rounded.
+    @param in_buffer source buffer
+    @param in_p position in the buffer
+    @param in_length buffer length
+    @return decoded value
+  */
+  inline int32_t decodeCoordinateE7(const int8_t *in_buffer,int in_p,int in_length) {
+    uint32_t t = 0,f = 0;
+    const int8_t *p = in_buffer + in_p;
+    int i = in_p;
+    bool negative = false;
+
+    if (*p == '-') {
+      negative = true;
+      p++;
+      i++;
+    }
+
+    for (;*p != '.' && i < in_length;i++,p++) {
+      if (isdigit(*p)) {
+        t = t * 10 + *p - '0';
+      }
+    }
+    if (*p == '.') {
+      int fc = 0;
+      p++;
+      i++;
+      for (;isdigit(*p) && i < in_length && fc < 7;i++,p++,fc++) {
+        f = f * 10 + *p - '0';
+      }
+      while (fc < 7) {
+        f *= 10;
+        fc++;
+      }
+    }
+    // minutes in 1e-7 units, at most 599999999
+    uint32_t m = (t % 100) * 10000000UL + f;
+    int32_t v = (t / 100) * 10000000UL + (m + 30) / 60;
+    return negative ? -v : v;
+  }
+
+  /**
+    Apply N/S or E/W indicator to a decoded coordinate
+    Only NMEA_USE_COORD_E7 coordinates are signed, others are returned as is
+    @param in_c decoded coordinate
+    @param in_indicator 'N', 'S', 'E' or 'W'
+    @return signed coordinate
+  */
+  inline NMEA::coordinate_t applyHemisphere(NMEA::coordinate_t in_c,int in_indicator) {
+#ifdef NMEA_USE_COORD_E7
+    if (in_indicator == 'S' || in_indicator == 'W')
+      return -in_c;
+#else
+    (void)in_indicator;
+#endif
+    return in_c;
+  }
+
+  /**
+    32 bit FNV-1a hash, used as a cheap message fingerprint
+    @param in_data source bytes
+    @param in_length number of bytes
+    @return hash value
+  */
+  inline uint32_t fingerprint(const void *in_data,size_t in_length) {
+    const uint8_t *p = (const uint8_t *)in_data;
+    uint32_t h = 2166136261UL;
+    for (size_t i = 0;i < in_length;i++) {
+      h ^= p[i];
+      h *= 16777619UL;
+    }
+    return h;
+  }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define GPS_BIG_ENDIAN_HOST
+#endif
+
+  inline uint16_t bswap16(uint16_t in_v) {
+    return __builtin_bswap16(in_v);
+  }
+
+  inline uint32_t bswap32(uint32_t in_v) {
+    return __builtin_bswap32(in_v);
+  }
+
+  /**
+    Load a big endian value from unaligned memory
+  */
+  inline uint16_t readBE16(const void *in_p) {
+    uint16_t v;
+    memcpy(&v,in_p,sizeof(v));
+#ifdef GPS_BIG_ENDIAN_HOST
+    return v;
+#else
+    return bswap16(v);
+#endif
+  }
+
+  inline uint32_t readBE32(const void *in_p) {
+    uint32_t v;
+    memcpy(&v,in_p,sizeof(v));
+#ifdef GPS_BIG_ENDIAN_HOST
+    return v;
+#else
+    return bswap32(v);
+#endif
+  }
+
+  /**
+    Store a value to unaligned memory in big endian order
+  */
+  inline void writeBE16(void *out_p,uint16_t in_v) {
+#ifndef GPS_BIG_ENDIAN_HOST
+    in_v = bswap16(in_v);
+#endif
+    memcpy(out_p,&in_v,sizeof(in_v));
+  }
+
+  inline void writeBE32(void *out_p,uint32_t in_v) {
+#ifndef GPS_BIG_ENDIAN_HOST
+    in_v = bswap32(in_v);
+#endif
+    memcpy(out_p,&in_v,sizeof(in_v));
+  }
+
+  /**
+    Sum of bytes, SiRF checksums are its low 15 bits
+  */
+  inline uint32_t byteSum(const uint8_t *in_data,size_t in_length) {
+    uint32_t t = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (;i + 16 <= in_length;i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(in_data + i));
+      acc = _mm_add_epi64(acc,_mm_sad_epu8(v,zero));
+    }
+    t = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc,8));
+#endif
+    for (;i < in_length;i++) {
+      t += in_data[i];
+    }
+    return t;
+  }
+
+  /**
+    Decimal representation of a integer, without a terminator
+    @param out_str at least 11 characters
+    @param in_v value
+    @return number of characters written
+  */
+  inline int formatDecimal(char *out_str,int32_t in_v) {
+    char digits[10];
+    uint32_t u = in_v < 0 ? 0 - (uint32_t)in_v : (uint32_t)in_v;
+    int n = 0;
+    do {
+      digits[n++] = '0' + u % 10;
+      u /= 10;
+    } while (u);
+    int l = 0;
+    if (in_v < 0) {
+      out_str[l++] = '-';
+    }
+    while (n) {
+      out_str[l++] = digits[--n];
+    }
+    return l;
+  }
+
+  /**
+    NMEA checksum (XOR) of a string, usable as a constant expression
+    @param in_str characters between '$' and '*'
+  */
+  constexpr uint8_t nmeaChecksum(const char *in_str,uint8_t in_checksum = 0) {
+    return *in_str ? nmeaChecksum(in_str + 1,in_checksum ^ (uint8_t)*in_str) : in_checksum;
+  }
+
   /**
     A Output port wrapper class
-    Automatically calicurating NMEA type checksum
+    A sentence is assembled in a fixed buffer with its NMEA type checksum
+    and written to the port at once by end().
+    Characters beyond NMEA_MAX_SENTENCE_LENGTH are dropped.
     for internal use
   */
   template<class T>
   class PortWrapper {
   public:
     PortWrapper(T &in_port)
-      : m_port(in_port) {
+      : m_port(in_port),
+        m_length(0),
+        m_checksum(0) {
       }
     void begin() {
+      m_length = 0;
       m_checksum = 0;
-      m_segment = 0;
+    }
+    /**
+      Start a sentence with a constant prefix
+      @param in_prefix starting with '$'
+      @param in_length length of in_prefix
+      @param in_checksum nmeaChecksum() of in_prefix without '$'
+    */
+    void begin(const char *in_prefix,uint8_t in_length,uint8_t in_checksum) {
+      memcpy(m_buffer,in_prefix,in_length);
+      m_length = in_length;
+      m_checksum = in_checksum;
     }
     void end() {
-      _makeChecksumString();
-      m_port.write(m_buffer,5);
+      m_buffer[m_length++] = '*';
+      m_buffer[m_length++] = _hex(m_checksum >> 4);
+      m_buffer[m_length++] = _hex(m_checksum & 0x0f);
+      m_buffer[m_length++] = '\r';
+      m_buffer[m_length++] = '\n';
+      m_port.write(m_buffer,m_length);
     }
     PortWrapper &operator<<(const char *str) {
-      int l = strlen(str);
-      m_port.write(str,l);
-      _calcChecksum(str,l);
+      _append(str,strlen(str));
       return *this;
     }
     PortWrapper &operator<<(char c) {
-      m_port.write(c);
-      m_checksum ^= c;
+      _append(&c,1);
       return *this;
     }
     PortWrapper &operator<<(int i) {
-      //itoa(i,m_buffer,10);
-      sprintf(m_buffer,"%d",i);
-      return *this << m_buffer;
+      char digits[11];
+      _append(digits,formatDecimal(digits,i));
+      return *this;
     }
   private:
     T &m_port;
-    char m_buffer[16];
-    uint8_t m_segment;
-    int m_checksum;
-
-    void _calcChecksum(const char *in_str,int in_l) {
-      const char *p;
-
-      if (m_segment == 0) {
-        m_segment++;
+    // room for "*hh\r\n"
+    char m_buffer[NMEA_MAX_SENTENCE_LENGTH + 5];
+    uint8_t m_length;
+    uint8_t m_checksum;
+
+    void _append(const char *in_str,size_t in_l) {
+      if (in_l > (size_t)(NMEA_MAX_SENTENCE_LENGTH - m_length)) {
+        in_l = NMEA_MAX_SENTENCE_LENGTH - m_length;
+      }
+      if (in_l == 0) {
+        return;
+      }
+      char *p = m_buffer + m_length;
+      memcpy(p,in_str,in_l);
+      if (m_length == 0) {
+        // '$' is not checksummed
+        p++;
         in_l--;
-        p = in_str + 1;
-      } else {
-        p = in_str;
+        m_length++;
       }
-
-      for (int i = 0;i < in_l;i++) {
-        m_checksum ^= *p++;
+      m_length += in_l;
+      for (size_t i = 0;i < in_l;i++) {
+        m_checksum ^= p[i];
       }
     }
-    char _hex(int v) {
-      if (v < 10) {
-        return '0' + v;
-      }
-      return 'A' + v - 10;
+    static char _hex(int v) {
+      return v < 10 ? '0' + v : 'A' + v - 10;
     }
-    void _makeChecksumString() {
-      m_buffer[0] = '*';
-      m_buffer[1] = _hex((m_checksum >> 4) & 0x0f);
-      m_buffer[2] = _hex(m_checksum & 0x0f);
-      m_buffer[3] = '\r';
-      m_buffer[4] = '\n';
+  };
+
+  /**
+    Input stream over a chunk of received bytes,
+    lets stream driven parsers take data pushed to them
+  */
+  class ChunkStream {
+  public:
+    ChunkStream()
+      : m_p(NULL),
+        m_length(0) {
     }
+
+    void set(const uint8_t *in_data,size_t in_length) {
+      m_p = in_data;
+      m_length = in_length;
+    }
+
+    int available() const { return m_length > 0; }
+    int read() {
+      if (m_length == 0)
+        return -1;
+      m_length--;
+      return *m_p++;
+    }
+  private:
+    const uint8_t *m_p;
+    size_t m_length;
   };
 
   /**
@@ -304,7 +607,9 @@ namespace util {
         return -2;
       }
       if (m_stream.available()) {
-        m_buffer[m_currentPosition] = m_stream.read();
+        // line noise above 7 bit ASCII would read as end of input and overrun yy_ec
+        uint8_t c = m_stream.read();
+        m_buffer[m_currentPosition] = c < 0x80 ? c : 0x01;
         m_bufferLength++;
         return m_buffer[m_currentPosition++];
       }
@@ -317,6 +622,22 @@ namespace util {
       m_currentPosition = pos;
     }
 
+    //! bytes read ahead of the token in progress, for Parser::save()
+    const int8_t *data() const {
+      return m_buffer;
+    }
+    int currentPosition() const {
+      return m_currentPosition;
+    }
+    int bufferedLength() const {
+      return m_bufferLength;
+    }
+    void assign(const int8_t *in_data,int in_position,int in_length) {
+      memcpy(m_buffer,in_data,in_length);
+      m_currentPosition = in_position;
+      m_bufferLength = in_length;
+    }
+
     int operator[](uint16_t n) const {
       if (n < m_bufferLength) {
         return m_buffer[n];
@@ -366,29 +687,32 @@ namespace util {
       decodeDecimal<int8_t,uint8_t,2>(m_buffer,0,m_currentPosition,&out_d->integerPart,&out_d->fractionalPart);
     }
 #else
-    // Work in progress...
     void decodeDecimal_4_4(NMEA::decimal1616_t *out_d) const {
-      NMEA_FLOAT i,f;
-      decodeDecimal<NMEA_FLOAT,NMEA_FLOAT,4>(m_buffer,0,m_currentPosition,&i,&f);
-      *out_d = i + f / 10000.0;
+      *out_d = decodeFloat<NMEA_FLOAT>(m_buffer,0,m_currentPosition);
     }
     void decodeDecimal_4_3(NMEA::decimal1616_t *out_d) const {
-      NMEA_FLOAT i,f;
-      decodeDecimal<NMEA_FLOAT,NMEA_FLOAT,4>(m_buffer,0,m_currentPosition,&i,&f);
-      *out_d = i + f / 1000.0;
+      *out_d = decodeFloat<NMEA_FLOAT>(m_buffer,0,m_currentPosition);
     }
-    void decodeDecimal_4_2(NMEA::decimal1616_t *out_d) const {
-      NMEA_FLOAT i,f;
-      decodeDecimal<NMEA_FLOAT,NMEA_FLOAT,4>(m_buffer,0,m_currentPosition,&i,&f);
-      *out_d = i + f / 100.0;
+    void decodeDecimal_4_2(NMEA::decimal168_t *out_d) const {
+      *out_d = decodeFloat<NMEA_FLOAT>(m_buffer,0,m_currentPosition);
     }
     void decodeDecimal_2_2(NMEA::decimal88_t *out_d) const {
-      NMEA_FLOAT i,f;
-      decodeDecimal<NMEA_FLOAT,NMEA_FLOAT,4>(m_buffer,0,m_currentPosition,&i,&f);
-      *out_d = i + f / 100.0;
+      *out_d = decodeFloat<NMEA_FLOAT>(m_buffer,0,m_currentPosition);
     }
 #endif /* NMEA_USE_FLOAT */
 
+    NMEA::coordinate_t decodeCoordinate() const {
+#ifdef NMEA_USE_COORD_E7
+      return decodeCoordinateE7(m_buffer,0,m_currentPosition);
+#else
+      // decodeDecimal() leaves fractionalPart alone without a '.'
+      NMEA::coordinate_t c;
+      memset(&c,0xff,sizeof(c));
+      decodeDecimal_4_4(&c);
+      return c;
+#endif
+    }
+
     int16_t decodeInt16() const {
       return decodeInteger<int16_t>(m_buffer,0,m_currentPosition);
     }
@@ -0,0 +1,117 @@
+#include "GPS/checkpoint.h"
+
+namespace GPS {
+
+namespace {
+
+  enum {
+    HEADER_SIZE = 4,
+    SECTION_HEADER_SIZE = 3,
+    FINGERPRINT_SIZE = 4
+  };
+
+} /* namespace */
+
+  CheckpointWriter::CheckpointWriter(uint8_t *out_blob,size_t in_size)
+    : m_blob(out_blob),
+      m_size(in_size),
+      m_length(HEADER_SIZE),
+      m_failed(in_size < HEADER_SIZE + FINGERPRINT_SIZE) {
+    if (!m_failed) {
+      m_blob[0] = 'G';
+      m_blob[1] = 'C';
+      m_blob[2] = CHECKPOINT_VERSION;
+      m_blob[3] = 0;
+    }
+  }
+
+  void CheckpointWriter::add(const NMEA::ParserState &in_state) {
+    uint8_t *p = _begin(CHECKPOINT_NMEA);
+    if (p && _room() >= sizeof(NMEA::ParserState)) {
+      memcpy(p,&in_state,sizeof(NMEA::ParserState));
+      _end(sizeof(NMEA::ParserState));
+    } else {
+      _end(0);
+    }
+  }
+
+  size_t CheckpointWriter::finish() {
+    if (m_failed)
+      return 0;
+    util::writeBE32(m_blob + m_length,util::fingerprint(m_blob,m_length));
+    return m_length + FINGERPRINT_SIZE;
+  }
+
+  uint8_t *CheckpointWriter::_begin(uint8_t in_tag) {
+    if (m_failed || _room() == 0)
+      return NULL;
+    m_blob[m_length] = in_tag;
+    return m_blob + m_length + SECTION_HEADER_SIZE;
+  }
+
+  void CheckpointWriter::_end(size_t in_length) {
+    if (m_failed)
+      return;
+    if (in_length == 0 || in_length > 0xffff || m_blob[3] == 0xff) {
+      m_failed = true;
+      return;
+    }
+    util::writeBE16(m_blob + m_length + 1,in_length);
+    m_length += SECTION_HEADER_SIZE + in_length;
+    m_blob[3]++;
+  }
+
+  //! bytes left for section data
+  size_t CheckpointWriter::_room() const {
+    size_t used = m_length + SECTION_HEADER_SIZE + FINGERPRINT_SIZE;
+    return m_size > used ? m_size - used : 0;
+  }
+
+  CheckpointReader::CheckpointReader(const uint8_t *in_blob,size_t in_length)
+    : m_blob(in_blob),
+      m_length(in_length),
+      m_valid(false) {
+    if (in_length < HEADER_SIZE + FINGERPRINT_SIZE ||
+        in_blob[0] != 'G' || in_blob[1] != 'C' || in_blob[2] != CHECKPOINT_VERSION)
+      return;
+    size_t end = in_length - FINGERPRINT_SIZE;
+    if (util::readBE32(in_blob + end) != util::fingerprint(in_blob,end))
+      return;
+    size_t pos = HEADER_SIZE;
+    for (int i = 0;i < in_blob[3];i++) {
+      if (pos + SECTION_HEADER_SIZE > end)
+        return;
+      pos += SECTION_HEADER_SIZE + util::readBE16(in_blob + pos + 1);
+    }
+    m_valid = pos == end;
+  }
+
+  bool CheckpointReader::restore(NMEA::ParserState *out_state) const {
+    size_t l;
+    const uint8_t *p = _find(CHECKPOINT_NMEA,&l);
+    if (p == NULL || l != sizeof(NMEA::ParserState))
+      return false;
+    NMEA::ParserState state;
+    memcpy(&state,p,sizeof(state));
+    if (!NMEA::validState(state))
+      return false;
+    memcpy(out_state,&state,sizeof(state));
+    return true;
+  }
+
+  const uint8_t *CheckpointReader::_find(uint8_t in_tag,size_t *out_length) const {
+    if (!m_valid)
+      return NULL;
+    size_t pos = HEADER_SIZE;
+    for (int i = 0;i < m_blob[3];i++) {
+      size_t l = util::readBE16(m_blob + pos + 1);
+      if (m_blob[pos] == in_tag) {
+        *out_length = l;
+        return m_blob + pos + SECTION_HEADER_SIZE;
+      }
+      pos += SECTION_HEADER_SIZE + l;
+    }
+    return NULL;
+  }
+
+} /* GPS */
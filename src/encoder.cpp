@@ -0,0 +1,412 @@
+#include "GPS/encoder.h"
+
+namespace GPS {
+
+namespace NMEA {
+
+namespace {
+
+  const char DIGIT_PAIRS[] =
+      "0001020304050607080910111213141516171819"
+      "2021222324252627282930313233343536373839"
+      "4041424344454647484950515253545556575859"
+      "6061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+
+  const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+  int countDigits(uint32_t in_v) {
+    int n = 1;
+    while (in_v >= 10) {
+      in_v /= 10;
+      n++;
+    }
+    return n;
+  }
+
+  char *putUnsigned(char *p,uint32_t in_v) {
+    char t[10];
+    char *q = t + sizeof(t);
+    while (in_v >= 100) {
+      q -= 2;
+      memcpy(q,DIGIT_PAIRS + (in_v % 100) * 2,2);
+      in_v /= 100;
+    }
+    if (in_v >= 10) {
+      q -= 2;
+      memcpy(q,DIGIT_PAIRS + in_v * 2,2);
+    } else {
+      *--q = '0' + in_v;
+    }
+    size_t n = t + sizeof(t) - q;
+    memcpy(p,q,n);
+    return p + n;
+  }
+
+  //! at least in_width digits, zero padded
+  char *putPadded(char *p,uint32_t in_v,int in_width) {
+    for (int n = countDigits(in_v);n < in_width;n++) {
+      *p++ = '0';
+    }
+    return putUnsigned(p,in_v);
+  }
+
+  char *putSigned(char *p,int32_t in_v,int in_width) {
+    if (in_v < 0) {
+      *p++ = '-';
+      return putPadded(p,0 - (uint32_t)in_v,in_width);
+    }
+    return putPadded(p,in_v,in_width);
+  }
+
+  char *putInt8(char *p,int8_t in_v,int in_width = 1) {
+    return in_v == -1 ? p : putSigned(p,in_v,in_width);
+  }
+
+  char *putChar(char *p,int8_t in_c) {
+    if (in_c != -1) {
+      *p++ = in_c;
+    }
+    return p;
+  }
+
+  char *putTime(char *p,const UTCTime &in_t) {
+    if (in_t.hour == 0xff) {
+      return p;
+    }
+    memcpy(p,DIGIT_PAIRS + in_t.hour % 100 * 2,2);
+    memcpy(p + 2,DIGIT_PAIRS + in_t.min % 100 * 2,2);
+    memcpy(p + 4,DIGIT_PAIRS + in_t.sec % 100 * 2,2);
+    p += 6;
+    if (in_t.msec != 0xffff) {
+      *p++ = '.';
+      p = putPadded(p,in_t.msec,3);
+    }
+    return p;
+  }
+
+  char *putDate(char *p,const Date &in_d) {
+    if (in_d.day == 0xff) {
+      return p;
+    }
+    memcpy(p,DIGIT_PAIRS + in_d.day % 100 * 2,2);
+    memcpy(p + 2,DIGIT_PAIRS + in_d.mon % 100 * 2,2);
+    memcpy(p + 4,DIGIT_PAIRS + in_d.year % 100 * 2,2);
+    return p + 6;
+  }
+
+#ifndef NMEA_USE_FLOAT
+  template<class I,class F>
+  char *putDecimal(char *p,I in_i,F in_f,int in_digits,int in_width) {
+    if (in_i == (I)-1 && in_f == (F)~0) {
+      return p;
+    }
+    p = putSigned(p,in_i,in_width);
+    *p++ = '.';
+    return putPadded(p,in_f,in_digits);
+  }
+
+  char *putDecimal(char *p,const decimal88_t &in_d,int in_digits,int in_width = 1) {
+    return putDecimal(p,in_d.integerPart,in_d.fractionalPart,in_digits,in_width);
+  }
+
+  char *putDecimal(char *p,const decimal168_t &in_d,int in_digits,int in_width = 1) {
+    return putDecimal(p,in_d.integerPart,in_d.fractionalPart,in_digits,in_width);
+  }
+
+#ifndef NMEA_USE_COORD_E7
+  char *putDecimal(char *p,const decimal1616_t &in_d,int in_digits,int in_width = 1) {
+    return putDecimal(p,in_d.integerPart,in_d.fractionalPart,in_digits,in_width);
+  }
+#endif
+#else
+  char *putDecimal(char *p,NMEA_FLOAT in_d,int in_digits,int in_width = 1) {
+    static const uint32_t SCALE[] = { 1,10,100,1000,10000 };
+    if (in_d != in_d) {
+      return p;
+    }
+    double s = (double)in_d * SCALE[in_digits];
+    if (s < 0) {
+      *p++ = '-';
+      s = -s;
+    }
+    // keep the integer part within the 16 bits of the integer build,
+    // so no sentence is longer than NMEA_ENCODER_SENTENCE_SIZE
+    if (s > 32768.0 * SCALE[in_digits] - 1) {
+      s = 32768.0 * SCALE[in_digits] - 1;
+    }
+    uint32_t v = (uint32_t)(s + 0.5);
+    p = putPadded(p,v / SCALE[in_digits],in_width);
+    *p++ = '.';
+    return putPadded(p,v % SCALE[in_digits],in_digits);
+  }
+#endif /* NMEA_USE_FLOAT */
+
+#ifdef NMEA_USE_COORD_E7
+  char *putCoordinate(char *p,coordinate_t in_c,int in_width) {
+    if (in_c == -1) {
+      return p;
+    }
+    uint32_t a = in_c < 0 ? 0 - (uint32_t)in_c : in_c;
+    // 1e-6 minutes are finer than 1e-7 degrees, so Parser restores in_c exactly
+    uint32_t m = ((a % 10000000UL) * 60 + 5) / 10;
+    p = putPadded(p,(a / 10000000UL) * 100 + m / 1000000UL,in_width);
+    *p++ = '.';
+    return putPadded(p,m % 1000000UL,6);
+  }
+#else
+  char *putCoordinate(char *p,const coordinate_t &in_c,int in_width) {
+    return putDecimal(p,in_c,4,in_width);
+  }
+#endif
+
+  char *putHemisphere(char *p,int8_t in_indicator,const coordinate_t &in_c,char in_positive,char in_negative) {
+    if (in_indicator != -1) {
+      *p++ = in_indicator;
+    }
+#ifdef NMEA_USE_COORD_E7
+    else
+    if (in_c != -1) {
+      *p++ = in_c < 0 ? in_negative : in_positive;
+    }
+#else
+    (void)in_c;
+    (void)in_positive;
+    (void)in_negative;
+#endif
+    return p;
+  }
+
+} /* namespace */
+
+  size_t Encoder::encode(const Message &in_msg) {
+    switch(in_msg.messageID) {
+#ifdef NMEA_USE_GGA
+      case NMEA_GPGGA:
+        return encode(in_msg.gga);
+#endif
+#ifdef NMEA_USE_GSA
+      case NMEA_GPGSA:
+        return encode(in_msg.gsa);
+#endif
+#ifdef NMEA_USE_GSV
+      case NMEA_GPGSV:
+        return encode(in_msg.gsv);
+#endif
+#ifdef NMEA_USE_RMC
+      case NMEA_GPRMC:
+        return encode(in_msg.rmc);
+#endif
+#ifdef NMEA_USE_VTG
+      case NMEA_GPVTG:
+        return encode(in_msg.vtg);
+#endif
+#ifdef NMEA_USE_ZDA
+      case NMEA_GPZDA:
+        return encode(in_msg.zda);
+#endif
+    }
+    return 0;
+  }
+
+  size_t Encoder::encode(const GGA &in_gga) {
+    char *s = _begin("$GPGGA");
+    char *p = s + 6;
+    *p++ = ',';
+    p = putTime(p,in_gga.utcTime);
+    *p++ = ',';
+    p = putCoordinate(p,in_gga.latitude,4);
+    *p++ = ',';
+    p = putHemisphere(p,in_gga.nsIndicator,in_gga.latitude,'N','S');
+    *p++ = ',';
+    p = putCoordinate(p,in_gga.longitude,5);
+    *p++ = ',';
+    p = putHemisphere(p,in_gga.ewIndicator,in_gga.longitude,'E','W');
+    *p++ = ',';
+    p = putInt8(p,in_gga.positionFixIndicator);
+    *p++ = ',';
+    p = putInt8(p,in_gga.satelitesUsed,2);
+    *p++ = ',';
+    p = putDecimal(p,in_gga.hdop,2);
+    *p++ = ',';
+    p = putDecimal(p,in_gga.mslAltitude,2);
+    *p++ = ',';
+    p = putChar(p,in_gga.units);
+    *p++ = ',';
+    p = putDecimal(p,in_gga.geoidSeparation,2);
+    *p++ = ',';
+    p = putChar(p,in_gga.units2);
+    *p++ = ',';
+    if (in_gga.ageOfDiffCorr != 0xffff) {
+      // Parser reads the age only in decimal form
+      p = putUnsigned(p,in_gga.ageOfDiffCorr);
+      *p++ = '.';
+      *p++ = '0';
+    }
+    *p++ = ',';
+    if (in_gga.diffRefStationID != 0xffff) {
+      p = putPadded(p,in_gga.diffRefStationID,4);
+    }
+    return _end(s,p);
+  }
+
+  size_t Encoder::encode(const GSA &in_gsa) {
+    char *s = _begin("$GPGSA");
+    char *p = s + 6;
+    *p++ = ',';
+    p = putChar(p,in_gsa.mode1);
+    *p++ = ',';
+    p = putInt8(p,in_gsa.mode2);
+    for (int i = 0;i < 12;i++) {
+      *p++ = ',';
+      p = putInt8(p,in_gsa.satelliteUsed[i],2);
+    }
+    *p++ = ',';
+    p = putDecimal(p,in_gsa.pdop,2);
+    *p++ = ',';
+    p = putDecimal(p,in_gsa.hdop,2);
+    *p++ = ',';
+    p = putDecimal(p,in_gsa.vdop,2);
+    return _end(s,p);
+  }
+
+  size_t Encoder::encode(const GSV &in_gsv) {
+    char *s = _begin("$GPGSV");
+    char *p = s + 6;
+    *p++ = ',';
+    p = putInt8(p,in_gsv.numberOfMessages);
+    *p++ = ',';
+    p = putInt8(p,in_gsv.messageNumber);
+    *p++ = ',';
+    p = putInt8(p,in_gsv.satellitesInView,2);
+
+    // satellites on this page, as Parser expects them
+    int n = 4;
+    if (in_gsv.messageNumber >= 1 && in_gsv.satellitesInView >= 0) {
+      n = in_gsv.satellitesInView - 4 * (in_gsv.messageNumber - 1);
+      n = n < 0 ? 0 : n > 4 ? 4 : n;
+    }
+    for (int i = 0;i < n;i++) {
+      *p++ = ',';
+      p = putInt8(p,in_gsv.satellites[i].satelliteID,2);
+      *p++ = ',';
+      p = putInt8(p,in_gsv.satellites[i].elevation,2);
+      *p++ = ',';
+      if (in_gsv.satellites[i].azimuth != -1) {
+        p = putSigned(p,in_gsv.satellites[i].azimuth,3);
+      }
+      *p++ = ',';
+      p = putInt8(p,in_gsv.satellites[i].snr,2);
+    }
+    return _end(s,p);
+  }
+
+  size_t Encoder::encode(const RMC &in_rmc) {
+    char *s = _begin("$GPRMC");
+    char *p = s + 6;
+    *p++ = ',';
+    p = putTime(p,in_rmc.utcTime);
+    *p++ = ',';
+    p = putChar(p,in_rmc.status);
+    *p++ = ',';
+    p = putCoordinate(p,in_rmc.latitude,4);
+    *p++ = ',';
+    p = putHemisphere(p,in_rmc.nsIndicator,in_rmc.latitude,'N','S');
+    *p++ = ',';
+    p = putCoordinate(p,in_rmc.longitude,5);
+    *p++ = ',';
+    p = putHemisphere(p,in_rmc.ewIndicator,in_rmc.longitude,'E','W');
+    *p++ = ',';
+    p = putDecimal(p,in_rmc.speedOverGround,2);
+    *p++ = ',';
+    p = putDecimal(p,in_rmc.courseOverGround,2);
+    *p++ = ',';
+    p = putDate(p,in_rmc.date);
+    *p++ = ',';
+    p = putDecimal(p,in_rmc.magneticVariation,2);
+    *p++ = ',';
+    p = putChar(p,in_rmc.ewIndicator2);
+    if (in_rmc.mode != -1) {
+      *p++ = ',';
+      *p++ = in_rmc.mode;
+    }
+    return _end(s,p);
+  }
+
+  size_t Encoder::encode(const VTG &in_vtg) {
+    char *s = _begin("$GPVTG");
+    char *p = s + 6;
+    *p++ = ',';
+    p = putDecimal(p,in_vtg.course,2);
+    *p++ = ',';
+    p = putChar(p,in_vtg.reference);
+    *p++ = ',';
+    p = putDecimal(p,in_vtg.course2,2);
+    *p++ = ',';
+    p = putChar(p,in_vtg.reference2);
+    *p++ = ',';
+    p = putDecimal(p,in_vtg.speed,2);
+    *p++ = ',';
+    p = putChar(p,in_vtg.units);
+    *p++ = ',';
+    p = putDecimal(p,in_vtg.speed2,2);
+    *p++ = ',';
+    p = putChar(p,in_vtg.units2);
+    if (in_vtg.mode != -1) {
+      *p++ = ',';
+      *p++ = in_vtg.mode;
+    }
+    return _end(s,p);
+  }
+
+  size_t Encoder::encode(const ZDA &in_zda) {
+    char *s = _begin("$GPZDA");
+    char *p = s + 6;
+    *p++ = ',';
+    p = putTime(p,in_zda.utcTime);
+    *p++ = ',';
+    p = putInt8(p,in_zda.day,2);
+    *p++ = ',';
+    p = putInt8(p,in_zda.month,2);
+    *p++ = ',';
+    if (in_zda.year != -1) {
+      p = putSigned(p,in_zda.year,4);
+    }
+    *p++ = ',';
+    p = putInt8(p,in_zda.localZoneHour,2);
+    *p++ = ',';
+    p = putInt8(p,in_zda.localZoneMinutes,2);
+    return _end(s,p);
+  }
+
+  char *Encoder::_begin(const char *in_prefix) {
+    // write in place unless the sentence might not fit
+    char *s = m_size - m_length >= NMEA_ENCODER_SENTENCE_SIZE ? m_buffer + m_length : m_scratch;
+    memcpy(s,in_prefix,6);
+    return s;
+  }
+
+  size_t Encoder::_end(char *in_start,char *in_p) {
+    uint8_t cs = 0;
+    for (const char *q = in_start + 1;q < in_p;q++) {
+      cs ^= *q;
+    }
+    in_p[0] = '*';
+    in_p[1] = HEX_DIGITS[cs >> 4];
+    in_p[2] = HEX_DIGITS[cs & 0x0f];
+    in_p[3] = '\r';
+    in_p[4] = '\n';
+    size_t n = in_p + 5 - in_start;
+    if (in_start == m_scratch) {
+      if (n > m_size - m_length) {
+        return 0;
+      }
+      memcpy(m_buffer + m_length,in_start,n);
+    }
+    m_length += n;
+    return n;
+  }
+
+} /* NMEA */
+
+} /* GPS */
@@ -0,0 +1,39 @@
+#include "GPS/engine.h"
+
+namespace GPS {
+
+namespace NMEA {
+
+  thread_local Engine *Engine::s_engine = NULL;
+
+  Engine::Engine()
+    : m_parser(m_stream),
+      m_handler(NULL),
+      m_current(0) {
+    m_parser.setHandler(_handler);
+  }
+
+  void Engine::reset(ParserState *out_state) {
+    memset(out_state,0,sizeof(ParserState));
+    memset(&out_state->message,0xff,sizeof(Message));
+  }
+
+  void Engine::feed(uint32_t in_stream,ParserState *io_state,const uint8_t *in_data,size_t in_length) {
+    Engine *outer = s_engine;
+    s_engine = this;
+    m_current = in_stream;
+    m_parser.load(*io_state);
+    m_stream.set(in_data,in_length);
+    m_parser.yyparse();
+    m_parser.save(io_state);
+    s_engine = outer;
+  }
+
+  void Engine::_handler(const Message &in_msg) {
+    if (s_engine->m_handler)
+      (*s_engine->m_handler)(s_engine->m_current,in_msg);
+  }
+
+} /* NMEA */
+
+} /* GPS */
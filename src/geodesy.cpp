@@ -0,0 +1,417 @@
+#include "GPS/geodesy.h"
+
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace GPS {
+
+namespace Geodesy {
+
+namespace {
+
+  const double DEG2RAD = 0.017453292519943295;
+  const double RAD2DEG = 57.295779513082323;
+  const double PI = 3.141592653589793238;
+  const double PIO2 = 1.570796326794896619;
+  const double PIO4 = 0.785398163397448310;
+
+  // pi / 2 split for Cody-Waite reduction
+  const double PIO2_1 = 1.570796251296997070;
+  const double PIO2_2 = 7.549789415861596353e-8;
+  const double PIO2_3 = 5.390302858158119053e-15;
+
+  const double WGS84_B = GPS_WGS84_A * (1.0 - GPS_WGS84_F);
+  const double WGS84_E2 = GPS_WGS84_F * (2.0 - GPS_WGS84_F);
+  const double WGS84_EP2 = WGS84_E2 / (1.0 - WGS84_E2);
+
+  /*
+    Vector types. Every type provides broadcast construction, load, store,
+    arithmetic operators, comparisons returning a mask, and the free
+    functions select, sqrt, abs, round, floor and copysign.
+  */
+
+  struct Scalar {
+    typedef bool mask;
+    enum { WIDTH = 1 };
+
+    double v;
+
+    Scalar() {}
+    Scalar(double d) : v(d) {}
+
+    static Scalar load(const double *p) { return Scalar(*p); }
+    void store(double *p) const { *p = v; }
+  };
+
+  inline Scalar operator+(Scalar a,Scalar b) { return a.v + b.v; }
+  inline Scalar operator-(Scalar a,Scalar b) { return a.v - b.v; }
+  inline Scalar operator*(Scalar a,Scalar b) { return a.v * b.v; }
+  inline Scalar operator/(Scalar a,Scalar b) { return a.v / b.v; }
+  inline Scalar operator-(Scalar a) { return -a.v; }
+  inline bool operator<(Scalar a,Scalar b) { return a.v < b.v; }
+  inline bool operator>(Scalar a,Scalar b) { return a.v > b.v; }
+  inline bool operator==(Scalar a,Scalar b) { return a.v == b.v; }
+  inline Scalar select(bool m,Scalar a,Scalar b) { return m ? a : b; }
+  inline Scalar sqrt(Scalar a) { return ::sqrt(a.v); }
+  inline Scalar abs(Scalar a) { return ::fabs(a.v); }
+  inline Scalar round(Scalar a) { return ::rint(a.v); }
+  inline Scalar floor(Scalar a) { return ::floor(a.v); }
+  inline Scalar copysign(Scalar a,Scalar b) { return ::copysign(a.v,b.v); }
+
+#if defined(__AVX__)
+
+  struct VectorMask {
+    __m256d m;
+    VectorMask(__m256d x) : m(x) {}
+  };
+
+  struct Vector {
+    typedef VectorMask mask;
+    enum { WIDTH = 4 };
+
+    __m256d v;
+
+    Vector() {}
+    Vector(double d) : v(_mm256_set1_pd(d)) {}
+    Vector(__m256d x) : v(x) {}
+
+    static Vector load(const double *p) { return _mm256_loadu_pd(p); }
+    void store(double *p) const { _mm256_storeu_pd(p,v); }
+  };
+
+  inline Vector operator+(Vector a,Vector b) { return _mm256_add_pd(a.v,b.v); }
+  inline Vector operator-(Vector a,Vector b) { return _mm256_sub_pd(a.v,b.v); }
+  inline Vector operator*(Vector a,Vector b) { return _mm256_mul_pd(a.v,b.v); }
+  inline Vector operator/(Vector a,Vector b) { return _mm256_div_pd(a.v,b.v); }
+  inline Vector operator-(Vector a) { return _mm256_xor_pd(a.v,_mm256_set1_pd(-0.0)); }
+  inline VectorMask operator<(Vector a,Vector b) { return _mm256_cmp_pd(a.v,b.v,_CMP_LT_OQ); }
+  inline VectorMask operator>(Vector a,Vector b) { return _mm256_cmp_pd(a.v,b.v,_CMP_GT_OQ); }
+  inline VectorMask operator==(Vector a,Vector b) { return _mm256_cmp_pd(a.v,b.v,_CMP_EQ_OQ); }
+  inline VectorMask operator&(VectorMask a,VectorMask b) { return _mm256_and_pd(a.m,b.m); }
+  inline VectorMask operator|(VectorMask a,VectorMask b) { return _mm256_or_pd(a.m,b.m); }
+  inline VectorMask operator!(VectorMask a) { return _mm256_xor_pd(a.m,_mm256_castsi256_pd(_mm256_set1_epi32(-1))); }
+  inline Vector select(VectorMask m,Vector a,Vector b) { return _mm256_blendv_pd(b.v,a.v,m.m); }
+  inline Vector sqrt(Vector a) { return _mm256_sqrt_pd(a.v); }
+  inline Vector abs(Vector a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0),a.v); }
+  inline Vector round(Vector a) { return _mm256_round_pd(a.v,_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  inline Vector floor(Vector a) { return _mm256_floor_pd(a.v); }
+  inline Vector copysign(Vector a,Vector b) {
+    __m256d s = _mm256_set1_pd(-0.0);
+    return _mm256_or_pd(_mm256_andnot_pd(s,a.v),_mm256_and_pd(s,b.v));
+  }
+
+#elif defined(__SSE2__)
+
+  struct VectorMask {
+    __m128d m;
+    VectorMask(__m128d x) : m(x) {}
+  };
+
+  struct Vector {
+    typedef VectorMask mask;
+    enum { WIDTH = 2 };
+
+    __m128d v;
+
+    Vector() {}
+    Vector(double d) : v(_mm_set1_pd(d)) {}
+    Vector(__m128d x) : v(x) {}
+
+    static Vector load(const double *p) { return _mm_loadu_pd(p); }
+    void store(double *p) const { _mm_storeu_pd(p,v); }
+  };
+
+  inline Vector operator+(Vector a,Vector b) { return _mm_add_pd(a.v,b.v); }
+  inline Vector operator-(Vector a,Vector b) { return _mm_sub_pd(a.v,b.v); }
+  inline Vector operator*(Vector a,Vector b) { return _mm_mul_pd(a.v,b.v); }
+  inline Vector operator/(Vector a,Vector b) { return _mm_div_pd(a.v,b.v); }
+  inline Vector operator-(Vector a) { return _mm_xor_pd(a.v,_mm_set1_pd(-0.0)); }
+  inline VectorMask operator<(Vector a,Vector b) { return _mm_cmplt_pd(a.v,b.v); }
+  inline VectorMask operator>(Vector a,Vector b) { return _mm_cmpgt_pd(a.v,b.v); }
+  inline VectorMask operator==(Vector a,Vector b) { return _mm_cmpeq_pd(a.v,b.v); }
+  inline VectorMask operator&(VectorMask a,VectorMask b) { return _mm_and_pd(a.m,b.m); }
+  inline VectorMask operator|(VectorMask a,VectorMask b) { return _mm_or_pd(a.m,b.m); }
+  inline VectorMask operator!(VectorMask a) { return _mm_xor_pd(a.m,_mm_castsi128_pd(_mm_set1_epi32(-1))); }
+  inline Vector select(VectorMask m,Vector a,Vector b) {
+    return _mm_or_pd(_mm_and_pd(m.m,a.v),_mm_andnot_pd(m.m,b.v));
+  }
+  inline Vector sqrt(Vector a) { return _mm_sqrt_pd(a.v); }
+  inline Vector abs(Vector a) { return _mm_andnot_pd(_mm_set1_pd(-0.0),a.v); }
+#if defined(__SSE4_1__)
+  inline Vector round(Vector a) { return _mm_round_pd(a.v,_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  inline Vector floor(Vector a) { return _mm_floor_pd(a.v); }
+#else
+  inline Vector round(Vector a) {
+    // exact for |a| < 2^51, larger values are integers already
+    Vector magic(6755399441055744.0);
+    Vector r = (a + magic) - magic;
+    return select(abs(a) < Vector(2251799813685248.0),r,a);
+  }
+  inline Vector floor(Vector a) {
+    Vector r = round(a);
+    return r - select(r > a,Vector(1.0),Vector(0.0));
+  }
+#endif
+  inline Vector copysign(Vector a,Vector b) {
+    __m128d s = _mm_set1_pd(-0.0);
+    return _mm_or_pd(_mm_andnot_pd(s,a.v),_mm_and_pd(s,b.v));
+  }
+
+#else
+
+  typedef Scalar Vector;
+
+#endif
+
+  /*
+    Elementary functions, Cephes polynomials
+  */
+
+  template<class V>
+  inline V _min(V a,V b) { return select(a < b,a,b); }
+
+  template<class V>
+  inline V _max(V a,V b) { return select(a > b,a,b); }
+
+  template<class V>
+  void _sincos(V x,V *out_sin,V *out_cos) {
+    V q = round(x * V(2.0 / PI));
+    V r = ((x - q * V(PIO2_1)) - q * V(PIO2_2)) - q * V(PIO2_3);
+    V m = q - V(4.0) * floor(q * V(0.25));
+    V zz = r * r;
+
+    V ps = V(1.58962301576546568060e-10);
+    ps = ps * zz + V(-2.50507477628578072866e-8);
+    ps = ps * zz + V(2.75573136213857245213e-6);
+    ps = ps * zz + V(-1.98412698295895385996e-4);
+    ps = ps * zz + V(8.33333333332211858878e-3);
+    ps = ps * zz + V(-1.66666666666666307295e-1);
+    V s = r + r * zz * ps;
+
+    V pc = V(-1.13585365213876817300e-11);
+    pc = pc * zz + V(2.08757008419747316778e-9);
+    pc = pc * zz + V(-2.75573141792967388112e-7);
+    pc = pc * zz + V(2.48015872888517045348e-5);
+    pc = pc * zz + V(-1.38888888888730564116e-3);
+    pc = pc * zz + V(4.16666666666665929218e-2);
+    V c = V(1.0) - V(0.5) * zz + zz * zz * pc;
+
+    typename V::mask swap = (m == V(1.0)) | (m == V(3.0));
+    V rs = select(swap,c,s);
+    V rc = select(swap,s,c);
+    *out_sin = select(m > V(1.5),-rs,rs);
+    *out_cos = select((m == V(1.0)) | (m == V(2.0)),-rc,rc);
+  }
+
+  template<class V>
+  V _atan(V x) {
+    V ax = abs(x);
+    typename V::mask big = ax > V(2.41421356237309504880);
+    typename V::mask mid = (ax > V(0.66)) & !big;
+    V xr = select(big,V(-1.0) / ax,select(mid,(ax - V(1.0)) / (ax + V(1.0)),ax));
+    V y = select(big,V(PIO2),select(mid,V(PIO4),V(0.0)));
+    V more = select(big,V(6.123233995736765886130e-17),select(mid,V(3.061616997868382943065e-17),V(0.0)));
+    V z = xr * xr;
+
+    V p = V(-8.750608600031904122785e-1);
+    p = p * z + V(-1.615753718733365076637e1);
+    p = p * z + V(-7.500855792314704667340e1);
+    p = p * z + V(-1.228866684490136173410e2);
+    p = p * z + V(-6.485021904942025371773e1);
+
+    V q = z + V(2.485846490142306297962e1);
+    q = q * z + V(1.650270098316988542046e2);
+    q = q * z + V(4.328810604912902668951e2);
+    q = q * z + V(4.853903996359136964868e2);
+    q = q * z + V(1.945506571482613964425e2);
+
+    V r = xr * (z * p / q) + xr;
+    return copysign(y + (r + more),x);
+  }
+
+  template<class V>
+  V _atan2(V y,V x) {
+    V ay = abs(y);
+    V t = _atan(ay / abs(x));
+    t = select(ay == V(0.0),V(0.0),t);
+    t = select(x < V(0.0),V(PI) - t,t);
+    return copysign(t,y);
+  }
+
+  /*
+    Kernels; each advances io_i over as many whole vectors as fit
+  */
+
+  template<class V>
+  void _haversine(const double *lat1,const double *lon1,const double *lat2,const double *lon2,
+                  double *out,size_t &io_i,size_t n) {
+    for (size_t i = io_i;i + V::WIDTH <= n;i += V::WIDTH,io_i = i) {
+      V p1 = V::load(lat1 + i) * V(DEG2RAD);
+      V p2 = V::load(lat2 + i) * V(DEG2RAD);
+      V dl = (V::load(lon2 + i) - V::load(lon1 + i)) * V(DEG2RAD);
+      V s1,c1,s2,c2,sp,cp,sl,cl;
+      _sincos(p1,&s1,&c1);
+      _sincos(p2,&s2,&c2);
+      _sincos((p2 - p1) * V(0.5),&sp,&cp);
+      _sincos(dl * V(0.5),&sl,&cl);
+      // 1 - a is formed directly to stay accurate near antipodes
+      V k = c1 * c2 * sl * sl;
+      V a = _max(sp * sp + k,V(0.0));
+      V b = _max(cp * cp - k,V(0.0));
+      V c = V(2.0) * _atan2(sqrt(a),sqrt(b));
+      (c * V(GPS_EARTH_RADIUS)).store(out + i);
+    }
+  }
+
+  template<class V>
+  void _equirectangular(const double *lat1,const double *lon1,const double *lat2,const double *lon2,
+                        double *out,size_t &io_i,size_t n) {
+    for (size_t i = io_i;i + V::WIDTH <= n;i += V::WIDTH,io_i = i) {
+      V p1 = V::load(lat1 + i) * V(DEG2RAD);
+      V p2 = V::load(lat2 + i) * V(DEG2RAD);
+      V dl = (V::load(lon2 + i) - V::load(lon1 + i)) * V(DEG2RAD);
+      dl = dl - V(2.0 * PI) * round(dl * V(0.5 / PI));
+      V s,c;
+      _sincos((p1 + p2) * V(0.5),&s,&c);
+      V x = dl * c;
+      V y = p2 - p1;
+      (sqrt(x * x + y * y) * V(GPS_EARTH_RADIUS)).store(out + i);
+    }
+  }
+
+  template<class V>
+  void _initialBearing(const double *lat1,const double *lon1,const double *lat2,const double *lon2,
+                       double *out,size_t &io_i,size_t n) {
+    for (size_t i = io_i;i + V::WIDTH <= n;i += V::WIDTH,io_i = i) {
+      V p1 = V::load(lat1 + i) * V(DEG2RAD);
+      V p2 = V::load(lat2 + i) * V(DEG2RAD);
+      V dl = (V::load(lon2 + i) - V::load(lon1 + i)) * V(DEG2RAD);
+      V s1,c1,s2,c2,sp,cp,sl,cl;
+      _sincos(p1,&s1,&c1);
+      _sincos(p2,&s2,&c2);
+      _sincos(p2 - p1,&sp,&cp);
+      _sincos(dl * V(0.5),&sl,&cl);
+      // c1 s2 - s1 c2 cos(dl) rewritten without cancellation for short segments
+      V x = sp + V(2.0) * s1 * c2 * sl * sl;
+      V t = _atan2(V(2.0) * sl * cl * c2,x) * V(RAD2DEG);
+      select(t < V(0.0),t + V(360.0),t).store(out + i);
+    }
+  }
+
+  template<class V>
+  void _ecefToLLA(const double *x,const double *y,const double *z,
+                  double *lat,double *lon,double *alt,size_t &io_i,size_t n) {
+    for (size_t i = io_i;i + V::WIDTH <= n;i += V::WIDTH,io_i = i) {
+      V vx = V::load(x + i);
+      V vy = V::load(y + i);
+      V vz = V::load(z + i);
+      V p = sqrt(vx * vx + vy * vy);
+
+      // Bowring, parametric latitude from the position, then refined once
+      V su = vz * V(GPS_WGS84_A);
+      V cu = p * V(WGS84_B);
+      V sn,cs;
+      for (int k = 0;k < 2;k++) {
+        V r = sqrt(su * su + cu * cu);
+        su = su / r;
+        cu = cu / r;
+        sn = vz + V(WGS84_EP2 * WGS84_B) * su * su * su;
+        cs = p - V(WGS84_E2 * GPS_WGS84_A) * cu * cu * cu;
+        su = sn * V(WGS84_B);
+        cu = cs * V(GPS_WGS84_A);
+      }
+      V h = sqrt(sn * sn + cs * cs);
+      V sp = sn / h;
+      V cp = cs / h;
+      V w = sqrt(V(1.0) - V(WGS84_E2) * sp * sp);
+
+      (_atan2(sn,cs) * V(RAD2DEG)).store(lat + i);
+      (_atan2(vy,vx) * V(RAD2DEG)).store(lon + i);
+      (p * cp + vz * sp - V(GPS_WGS84_A) * w).store(alt + i);
+    }
+  }
+
+  template<class V>
+  void _llaToECEF(const double *lat,const double *lon,const double *alt,
+                  double *x,double *y,double *z,size_t &io_i,size_t n) {
+    for (size_t i = io_i;i + V::WIDTH <= n;i += V::WIDTH,io_i = i) {
+      V sp,cp,sl,cl;
+      _sincos(V::load(lat + i) * V(DEG2RAD),&sp,&cp);
+      _sincos(V::load(lon + i) * V(DEG2RAD),&sl,&cl);
+      V h = V::load(alt + i);
+      V nn = V(GPS_WGS84_A) / sqrt(V(1.0) - V(WGS84_E2) * sp * sp);
+      V r = (nn + h) * cp;
+      (r * cl).store(x + i);
+      (r * sl).store(y + i);
+      ((nn * V(1.0 - WGS84_E2) + h) * sp).store(z + i);
+    }
+  }
+
+} /* namespace */
+
+  void haversine(const double *in_lat1,const double *in_lon1,
+                 const double *in_lat2,const double *in_lon2,
+                 double *out_distance,size_t in_n) {
+    size_t i = 0;
+    _haversine<Vector>(in_lat1,in_lon1,in_lat2,in_lon2,out_distance,i,in_n);
+    _haversine<Scalar>(in_lat1,in_lon1,in_lat2,in_lon2,out_distance,i,in_n);
+  }
+
+  void equirectangular(const double *in_lat1,const double *in_lon1,
+                       const double *in_lat2,const double *in_lon2,
+                       double *out_distance,size_t in_n) {
+    size_t i = 0;
+    _equirectangular<Vector>(in_lat1,in_lon1,in_lat2,in_lon2,out_distance,i,in_n);
+    _equirectangular<Scalar>(in_lat1,in_lon1,in_lat2,in_lon2,out_distance,i,in_n);
+  }
+
+  void initialBearing(const double *in_lat1,const double *in_lon1,
+                      const double *in_lat2,const double *in_lon2,
+                      double *out_bearing,size_t in_n) {
+    size_t i = 0;
+    _initialBearing<Vector>(in_lat1,in_lon1,in_lat2,in_lon2,out_bearing,i,in_n);
+    _initialBearing<Scalar>(in_lat1,in_lon1,in_lat2,in_lon2,out_bearing,i,in_n);
+  }
+
+  double odometer(const double *in_lat,const double *in_lon,double *out_cumulative,size_t in_n) {
+    double segment[64];
+    double total = 0;
+
+    if (out_cumulative && in_n > 0)
+      out_cumulative[0] = 0;
+    for (size_t i = 1;i < in_n;i += 64) {
+      size_t l = in_n - i < 64 ? in_n - i : 64;
+      haversine(in_lat + i - 1,in_lon + i - 1,in_lat + i,in_lon + i,segment,l);
+      for (size_t j = 0;j < l;j++) {
+        total += segment[j];
+        if (out_cumulative)
+          out_cumulative[i + j] = total;
+      }
+    }
+    return total;
+  }
+
+  void ecefToLLA(const double *in_x,const double *in_y,const double *in_z,
+                 double *out_lat,double *out_lon,double *out_alt,size_t in_n) {
+    size_t i = 0;
+    _ecefToLLA<Vector>(in_x,in_y,in_z,out_lat,out_lon,out_alt,i,in_n);
+    _ecefToLLA<Scalar>(in_x,in_y,in_z,out_lat,out_lon,out_alt,i,in_n);
+  }
+
+  void llaToECEF(const double *in_lat,const double *in_lon,const double *in_alt,
+                 double *out_x,double *out_y,double *out_z,size_t in_n) {
+    size_t i = 0;
+    _llaToECEF<Vector>(in_lat,in_lon,in_alt,out_x,out_y,out_z,i,in_n);
+    _llaToECEF<Scalar>(in_lat,in_lon,in_alt,out_x,out_y,out_z,i,in_n);
+  }
+
+} /* Geodesy */
+
+} /* GPS */
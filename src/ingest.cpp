@@ -0,0 +1,205 @@
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <new>
+#include "GPS/ingest.h"
+
+namespace GPS {
+
+  struct EpollIngest::Stream {
+    typedef SiRF::PacketParser<util::ChunkStream> PacketParser;
+    typedef Demux<util::ChunkStream,PacketParser> StreamDemux;
+
+    Stream(uint32_t in_id,int in_fd)
+      : id(in_id),
+        fd(in_fd),
+        open(true),
+        removed(false),
+        nmeaHandler(NULL),
+        sirfHandler(NULL),
+        context(NULL),
+        sirf(chunk,messageParser),
+        demux(chunk,sirf),
+        nmea(demux) {
+      memset(&stats,0,sizeof(stats));
+    }
+
+    uint32_t id;
+    int fd;
+    bool open;
+    bool removed;         //!< by a handler while being fed
+    StreamMessageHandler nmeaHandler;
+    StreamOutputHandler sirfHandler;
+    void *context;
+    StreamStats stats;
+
+    util::ChunkStream chunk;
+    SiRF::MessageParser messageParser;
+    PacketParser sirf;
+    StreamDemux demux;
+    NMEA::Parser<StreamDemux> nmea;
+  };
+
+  thread_local EpollIngest::Stream *EpollIngest::s_current = NULL;
+
+  EpollIngest::EpollIngest(uint32_t in_maxStreams,size_t in_chunkSize)
+    : m_epoll(epoll_create1(EPOLL_CLOEXEC)),
+      m_maxStreams(in_maxStreams),
+      m_count(0),
+      m_streams(new(std::nothrow) Stream *[in_maxStreams]),
+      m_free(new(std::nothrow) uint32_t[in_maxStreams]),
+      m_freeCount(0),
+      m_chunk(new(std::nothrow) uint8_t[in_chunkSize]),
+      m_chunkSize(in_chunkSize),
+      m_wakeups(0),
+      m_closedHandler(NULL) {
+    if (m_streams && m_free) {
+      for (uint32_t i = 0;i < in_maxStreams;i++) {
+        m_streams[i] = NULL;
+        m_free[m_freeCount++] = in_maxStreams - 1 - i;
+      }
+    }
+  }
+
+  EpollIngest::~EpollIngest() {
+    if (m_streams) {
+      for (uint32_t i = 0;i < m_maxStreams;i++)
+        delete m_streams[i];
+    }
+    delete [] m_streams;
+    delete [] m_free;
+    delete [] m_chunk;
+    if (m_epoll >= 0)
+      close(m_epoll);
+  }
+
+  int32_t EpollIngest::add(int in_fd,StreamMessageHandler in_nmea,StreamOutputHandler in_sirf,void *in_context) {
+    if (!valid() || m_freeCount == 0)
+      return -1;
+    uint32_t id = m_free[m_freeCount - 1];
+    Stream *s = new(std::nothrow) Stream(id,in_fd);
+    if (s == NULL)
+      return -1;
+    s->nmeaHandler = in_nmea;
+    s->sirfHandler = in_sirf;
+    s->context = in_context;
+    s->nmea.setHandler(_nmeaHandler);
+    s->sirf.setHandler(_sirfHandler);
+
+    fcntl(in_fd,F_SETFL,fcntl(in_fd,F_GETFL) | O_NONBLOCK);
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u32 = id;
+    if (epoll_ctl(m_epoll,EPOLL_CTL_ADD,in_fd,&ev) != 0) {
+      delete s;
+      return -1;
+    }
+    m_freeCount--;
+    m_streams[id] = s;
+    m_count++;
+    return id;
+  }
+
+  void EpollIngest::remove(uint32_t in_stream) {
+    if (in_stream >= m_maxStreams || m_streams[in_stream] == NULL)
+      return;
+    Stream *s = m_streams[in_stream];
+    if (s->open)
+      epoll_ctl(m_epoll,EPOLL_CTL_DEL,s->fd,NULL);
+    m_streams[in_stream] = NULL;
+    m_count--;
+    if (s == s_current) {
+      // its parsers are still running, _service() releases it
+      s->removed = true;
+      return;
+    }
+    delete s;
+    m_free[m_freeCount++] = in_stream;
+  }
+
+  int EpollIngest::poll(int in_timeoutMs) {
+    struct epoll_event events[INGEST_EVENTS];
+    int n = epoll_wait(m_epoll,events,INGEST_EVENTS,in_timeoutMs);
+    if (n < 0)
+      return errno == EINTR ? 0 : -1;
+    if (n > 0)
+      m_wakeups++;
+    for (int i = 0;i < n;i++)
+      _service(events[i].data.u32);
+    return n;
+  }
+
+  const StreamStats *EpollIngest::stats(uint32_t in_stream) const {
+    if (in_stream >= m_maxStreams || m_streams[in_stream] == NULL)
+      return NULL;
+    return &m_streams[in_stream]->stats;
+  }
+
+  void *EpollIngest::context(uint32_t in_stream) const {
+    if (in_stream >= m_maxStreams || m_streams[in_stream] == NULL)
+      return NULL;
+    return m_streams[in_stream]->context;
+  }
+
+  bool EpollIngest::open(uint32_t in_stream) const {
+    return in_stream < m_maxStreams && m_streams[in_stream] != NULL && m_streams[in_stream]->open;
+  }
+
+  /*
+    One chunk per readable stream and wakeup, level triggered epoll
+    reports the rest again, so a busy stream cannot starve the others
+  */
+  void EpollIngest::_service(uint32_t in_stream) {
+    Stream *s = m_streams[in_stream];
+    if (s == NULL || !s->open)
+      return;
+    ssize_t n = read(s->fd,m_chunk,m_chunkSize);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EINTR)
+        _close(s);
+      return;
+    }
+    if (n == 0) {
+      _close(s);
+      return;
+    }
+
+    s->stats.bytes += n;
+    s->stats.reads++;
+    s->chunk.set(m_chunk,n);
+    s_current = s;
+    s->nmea.yyparse();
+    s_current = NULL;
+    if (s->removed) {
+      delete s;
+      m_free[m_freeCount++] = in_stream;
+      return;
+    }
+    s->stats.messages = s->nmea.messages();
+    s->stats.frames = s->sirf.frames();
+    s->stats.discarded = s->sirf.discardedBytes();
+  }
+
+  void EpollIngest::_nmeaHandler(const NMEA::Message &in_msg) {
+    if (s_current->nmeaHandler && !s_current->removed)
+      (*s_current->nmeaHandler)(s_current->id,in_msg);
+  }
+
+  void EpollIngest::_sirfHandler(const SiRF::OutputMessage &in_msg) {
+    if (s_current->sirfHandler && !s_current->removed)
+      (*s_current->sirfHandler)(s_current->id,in_msg);
+  }
+
+  void EpollIngest::_close(Stream *io_stream) {
+    epoll_ctl(m_epoll,EPOLL_CTL_DEL,io_stream->fd,NULL);
+    io_stream->open = false;
+    if (m_closedHandler)
+      (*m_closedHandler)(io_stream->id);
+  }
+
+} /* GPS */
+
+#endif /* __linux__ */
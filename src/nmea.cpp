@@ -114,6 +114,47 @@ namespace NMEA {
          63,   63,   63,   63,   63,   63,   63,   63,   63,   63
       } ;
 
+  bool validState(const ParserState &in_state) {
+    if (in_state.lexerState >= YY_MAX_STATE || in_state.lastAcceptingState >= YY_MAX_STATE)
+      return false;
+    if (in_state.length > MAX_STRING_INPUT_BUFFER_SIZE || in_state.position > in_state.length ||
+        in_state.lastAcceptingPosition > in_state.length)
+      return false;
+    uint16_t step = in_state.parserState & NMEA_STATE_MASK;
+    switch(in_state.parserState & ~NMEA_STATE_MASK) {
+      case STATE_0:
+        return step <= 1;
+      case STATE_GGA:
+      case STATE_GLL:
+      case STATE_GSA:
+      case STATE_GSV:
+      case STATE_MSS:
+      case STATE_RMC:
+      case STATE_VTG:
+      case STATE_ZDA:
+      case STATE_150:
+      case STATE_151:
+      case STATE_152:
+      case STATE_154:
+        return true;
+      case STATE_WAIT_NL:
+      case STATE_ERROR:
+        return step == 0;
+    }
+    return false;
+  }
+
 } /* NMEA */
 
+namespace util {
+
+  const double pow10Table[23] =
+      {
+          1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+          1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+          1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+      } ;
+
+} /* util */
+
 } /* GPS */
@@ -0,0 +1,248 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "GPS/scheduler.h"
+
+namespace GPS {
+
+namespace {
+
+  typedef std::chrono::steady_clock Clock;
+
+  uint64_t nanosSince(Clock::time_point in_t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - in_t).count();
+  }
+
+} /* namespace */
+
+  struct Scheduler::Stream {
+    Stream() : scheduled(false) {
+      NMEA::Engine::reset(&state);
+    }
+
+    std::mutex lock;
+    std::vector<uint8_t> pending;
+    bool scheduled;                 //!< on a deque or being parsed
+    NMEA::ParserState state;
+  };
+
+  struct Scheduler::Worker {
+    Worker() : busyNanos(0),tasks(0),steals(0),bytes(0) {}
+
+    std::mutex lock;
+    std::deque<uint32_t> queue;     //!< owner takes the back, thieves the front
+    std::thread thread;
+    NMEA::Engine engine;
+    std::vector<uint8_t> chunk;
+
+    std::atomic<uint64_t> busyNanos;
+    std::atomic<uint64_t> tasks;
+    std::atomic<uint64_t> steals;
+    std::atomic<uint64_t> bytes;
+  };
+
+  struct Scheduler::Shared {
+    Shared() : queued(0),active(0),running(false) {}
+
+    std::mutex lock;
+    std::condition_variable wake;   //!< workers wait for tasks
+    std::condition_variable idle;   //!< wait() waits for active == 0
+    std::atomic<uint32_t> queued;   //!< tasks on deques
+    uint32_t active;                //!< streams scheduled
+    bool running;
+    Clock::time_point start;
+  };
+
+  Scheduler::Scheduler(uint32_t in_streams,unsigned in_workers)
+    : m_streamCount(in_streams),
+      m_workerCount(in_workers ? in_workers : 1),
+      m_streams(new Stream[in_streams]),
+      m_workers(new Worker[in_workers ? in_workers : 1]),
+      m_shared(new Shared),
+      m_handler(NULL) {
+    m_shared->start = Clock::now();
+  }
+
+  Scheduler::~Scheduler() {
+    stop();
+    delete [] m_streams;
+    delete [] m_workers;
+    delete m_shared;
+  }
+
+  void Scheduler::setHandler(NMEA::StreamHandler in_handler) {
+    m_handler = in_handler;
+    for (unsigned i = 0;i < m_workerCount;i++)
+      m_workers[i].engine.setHandler(in_handler);
+  }
+
+  void Scheduler::start() {
+    {
+      std::lock_guard<std::mutex> l(m_shared->lock);
+      if (m_shared->running)
+        return;
+      m_shared->running = true;
+      m_shared->start = Clock::now();
+    }
+    for (unsigned i = 0;i < m_workerCount;i++)
+      m_workers[i].thread = std::thread(&Scheduler::_run,this,i);
+  }
+
+  void Scheduler::stop() {
+    {
+      std::lock_guard<std::mutex> l(m_shared->lock);
+      if (!m_shared->running)
+        return;
+      m_shared->running = false;
+    }
+    m_shared->wake.notify_all();
+    for (unsigned i = 0;i < m_workerCount;i++)
+      m_workers[i].thread.join();
+  }
+
+  bool Scheduler::submit(uint32_t in_stream,const uint8_t *in_data,size_t in_length) {
+    if (in_stream >= m_streamCount)
+      return false;
+    Stream &s = m_streams[in_stream];
+    bool schedule;
+    {
+      std::lock_guard<std::mutex> l(s.lock);
+      if (s.pending.size() + in_length > SCHEDULER_MAX_PENDING)
+        return false;
+      s.pending.insert(s.pending.end(),in_data,in_data + in_length);
+      schedule = !s.scheduled;
+      s.scheduled = true;
+    }
+    if (schedule) {
+      {
+        std::lock_guard<std::mutex> l(m_shared->lock);
+        m_shared->active++;
+      }
+      // a stream starts on its home worker, stealing spreads the load
+      _push(in_stream % m_workerCount,in_stream,true);
+    }
+    return true;
+  }
+
+  void Scheduler::wait() {
+    std::unique_lock<std::mutex> l(m_shared->lock);
+    while (m_shared->active > 0)
+      m_shared->idle.wait(l);
+  }
+
+  const NMEA::ParserState &Scheduler::state(uint32_t in_stream) const {
+    return m_streams[in_stream].state;
+  }
+
+  WorkerStats Scheduler::stats(unsigned in_worker) const {
+    const Worker &w = m_workers[in_worker];
+    WorkerStats s;
+    s.busyNanos = w.busyNanos;
+    s.tasks = w.tasks;
+    s.steals = w.steals;
+    s.bytes = w.bytes;
+    return s;
+  }
+
+  double Scheduler::utilisation(unsigned in_worker) const {
+    uint64_t elapsed = nanosSince(m_shared->start);
+    return elapsed ? (double)m_workers[in_worker].busyNanos / elapsed : 0;
+  }
+
+  void Scheduler::_push(unsigned in_worker,uint32_t in_stream,bool in_back) {
+    Worker &w = m_workers[in_worker];
+    {
+      std::lock_guard<std::mutex> l(w.lock);
+      if (in_back)
+        w.queue.push_back(in_stream);
+      else
+        w.queue.push_front(in_stream);
+      m_shared->queued++;
+    }
+    {
+      // pairs with the predicate check in _run(), no lost wakeup
+      std::lock_guard<std::mutex> l(m_shared->lock);
+    }
+    m_shared->wake.notify_one();
+  }
+
+  bool Scheduler::_take(unsigned in_worker,uint32_t *out_stream) {
+    {
+      Worker &w = m_workers[in_worker];
+      std::lock_guard<std::mutex> l(w.lock);
+      if (!w.queue.empty()) {
+        *out_stream = w.queue.back();
+        w.queue.pop_back();
+        m_shared->queued--;
+        return true;
+      }
+    }
+    for (unsigned i = 1;i < m_workerCount;i++) {
+      Worker &victim = m_workers[(in_worker + i) % m_workerCount];
+      std::lock_guard<std::mutex> l(victim.lock);
+      if (!victim.queue.empty()) {
+        *out_stream = victim.queue.front();
+        victim.queue.pop_front();
+        m_shared->queued--;
+        m_workers[in_worker].steals++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Scheduler::_run(unsigned in_worker) {
+    for (;;) {
+      uint32_t stream;
+      if (_take(in_worker,&stream)) {
+        _parse(in_worker,stream);
+        continue;
+      }
+      std::unique_lock<std::mutex> l(m_shared->lock);
+      while (m_shared->running && m_shared->queued == 0)
+        m_shared->wake.wait(l);
+      if (!m_shared->running)
+        return;
+    }
+  }
+
+  /*
+    One batch of a stream per task; a stream which received more
+    meanwhile goes to the front of the deque behind other streams
+  */
+  void Scheduler::_parse(unsigned in_worker,uint32_t in_stream) {
+    Worker &w = m_workers[in_worker];
+    Stream &s = m_streams[in_stream];
+    {
+      std::lock_guard<std::mutex> l(s.lock);
+      w.chunk.swap(s.pending);
+    }
+
+    Clock::time_point t = Clock::now();
+    if (!w.chunk.empty())
+      w.engine.feed(in_stream,&s.state,&w.chunk[0],w.chunk.size());
+    w.busyNanos += nanosSince(t);
+    w.bytes += w.chunk.size();
+    w.tasks++;
+    w.chunk.clear();
+
+    bool more;
+    {
+      std::lock_guard<std::mutex> l(s.lock);
+      more = !s.pending.empty();
+      s.scheduled = more;
+    }
+    if (more) {
+      _push(in_worker,in_stream,false);
+      return;
+    }
+    std::lock_guard<std::mutex> l(m_shared->lock);
+    if (--m_shared->active == 0)
+      m_shared->idle.notify_all();
+  }
+
+} /* GPS */
@@ -0,0 +1,573 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "GPS/simulator.h"
+#include "GPS/encoder.h"
+#include "GPS/time.h"
+
+namespace GPS {
+
+namespace {
+
+  const double EARTH_RADIUS = 6378137.0;
+  const double DEGREES = 180.0 / M_PI;
+  const double KNOTS = 3600.0 / 1852.0;
+
+  //! PRN, elevation, azimuth and C/N0 of the satellites in view
+  const uint16_t SATELLITES[SIMULATOR_SATELLITES][4] = {
+    {  2, 62,  48, 44 },
+    {  5, 25, 305, 38 },
+    { 12, 41, 126, 41 },
+    { 15, 12, 198, 33 },
+    { 21, 74, 240, 46 },
+    { 24, 33,  80, 40 },
+    { 26, 18, 355, 35 },
+    { 29, 50, 165, 43 }
+  };
+
+#ifdef NMEA_USE_COORD_E7
+  NMEA::coordinate_t toCoordinate(double in_degrees) {
+    return (int32_t)floor(in_degrees * 1e7 + 0.5);
+  }
+#else
+  //! (d)ddmm.mmmm of the absolute value
+  NMEA::coordinate_t toCoordinate(double in_degrees) {
+    double a = fabs(in_degrees);
+    uint32_t d = (uint32_t)a;
+    uint32_t m = (uint32_t)((a - d) * 600000 + 0.5);
+    if (m >= 600000) {
+      m -= 600000;
+      d++;
+    }
+    uint32_t v = d * 1000000 + m;
+    NMEA::coordinate_t c;
+# ifndef NMEA_USE_FLOAT
+    c.integerPart = v / 10000;
+    c.fractionalPart = v % 10000;
+# else
+    c = v / 10000.0;
+# endif
+    return c;
+  }
+#endif
+
+#ifndef NMEA_USE_FLOAT
+  //! two fractional digits, clamped to the integer part
+  template<class D>
+  void setDecimal(D *out_d,double in_v) {
+    const double limit = sizeof(out_d->integerPart) == 1 ? 127.99 : 32767.99;
+    if (in_v > limit) {
+      in_v = limit;
+    } else
+    if (in_v < -limit) {
+      in_v = -limit;
+    }
+    long v = (long)(fabs(in_v) * 100 + 0.5);
+    out_d->integerPart = (in_v < 0 ? -1 : 1) * (v / 100);
+    out_d->fractionalPart = v % 100;
+  }
+#else
+  void setDecimal(NMEA_FLOAT *out_d,double in_v) {
+    *out_d = in_v;
+  }
+#endif
+
+  void setTime(NMEA::UTCTime *out_time,int64_t in_nanos) {
+    int64_t ms = in_nanos / 1000000;
+    int32_t s = (int32_t)(ms / 1000 % 86400);
+    out_time->hour = s / 3600;
+    out_time->min = s / 60 % 60;
+    out_time->sec = s % 60;
+    out_time->msec = ms % 1000;
+  }
+
+  uint8_t hexValue(uint8_t in_c) {
+    if (in_c >= '0' && in_c <= '9') {
+      return in_c - '0';
+    }
+    if (in_c >= 'A' && in_c <= 'F') {
+      return in_c - 'A' + 10;
+    }
+    return 0xff;
+  }
+
+} /* namespace */
+
+  Simulator::Simulator(uint32_t in_seed)
+    : m_seed(in_seed ? in_seed : 1),
+      m_speed(0),
+      m_heading(0),
+      m_turnRate(0),
+      m_noise(0),
+      m_errorRate(0),
+      m_epochs(0),
+      m_hz(1),
+      m_protocol(NMEA::PROTOCOL_NMEA),
+      m_baud(4800),
+      m_queries(0),
+      m_mid41Rate(1),
+      m_ackCount(0),
+      m_inLength(0) {
+    setStart(35.6812,139.7671,40.0,util::utcToEpochNanos(2020,1,1,0,0,0,0));
+    memset(m_rates,0,sizeof(m_rates));
+    m_rates[NMEA::MSG_GGA] = 1;
+    m_rates[NMEA::MSG_GSA] = 1;
+    m_rates[NMEA::MSG_GSV] = 1;
+    m_rates[NMEA::MSG_RMC] = 1;
+    m_rates[NMEA::MSG_VTG] = 1;
+    m_rates[NMEA::MSG_ZDA] = 1;
+  }
+
+  void Simulator::setStart(double in_lat,double in_lon,double in_alt,int64_t in_epochNanos) {
+    m_lat = m_reportedLat = in_lat;
+    m_lon = m_reportedLon = in_lon;
+    m_alt = in_alt;
+    m_time = in_epochNanos;
+    m_epochs = 0;
+  }
+
+  void Simulator::setMotion(double in_speed,double in_heading,double in_turnRate) {
+    m_speed = in_speed;
+    m_heading = in_heading;
+    m_turnRate = in_turnRate;
+  }
+
+  void Simulator::setEpochRate(uint8_t in_hz) {
+    m_hz = in_hz < 1 ? 1 : in_hz > 10 ? 10 : in_hz;
+  }
+
+  void Simulator::setNoise(double in_meters) {
+    m_noise = in_meters;
+  }
+
+  void Simulator::setErrorRate(double in_probability) {
+    m_errorRate = in_probability;
+  }
+
+  void Simulator::setProtocol(NMEA::ProtocolType in_protocol) {
+    m_protocol = in_protocol;
+    m_inLength = 0;
+  }
+
+  void Simulator::setRate(uint8_t in_message,uint8_t in_rate) {
+    if (in_message <= NMEA::MSG_ZDA) {
+      m_rates[in_message] = in_rate;
+    }
+  }
+
+  void Simulator::setBinaryRate(uint8_t in_messageID,uint8_t in_rate) {
+    if (in_messageID == SiRF::GeodeticNavigationDataID) {
+      m_mid41Rate = in_rate;
+    }
+  }
+
+  size_t Simulator::epoch(uint8_t *out_buffer,size_t in_size) {
+    if (m_epochs > 0) {
+      _move();
+    }
+    double n = _gaussian() * m_noise;
+    double e = _gaussian() * m_noise;
+    m_reportedLat = m_lat + n / EARTH_RADIUS * DEGREES;
+    m_reportedLon = m_lon + e / (EARTH_RADIUS * cos(m_lat / DEGREES)) * DEGREES;
+
+    // acknowledgments go out before the receiver switches protocol
+    size_t l = 0;
+    for (uint8_t i = 0;i < m_ackCount;i++) {
+      uint8_t ack[2] = { SiRF::CommandAcknowledgmentID, m_acks[i] };
+      l += _sirfFrame(ack,sizeof(ack),out_buffer + l,in_size - l);
+    }
+    m_ackCount = 0;
+
+    if (m_protocol == NMEA::PROTOCOL_NMEA) {
+      l += _nmea(out_buffer + l,in_size - l);
+    } else {
+      l += _binary(out_buffer + l,in_size - l);
+    }
+    m_queries = 0;
+    m_epochs++;
+    return l;
+  }
+
+  void Simulator::receive(const uint8_t *in_data,size_t in_length) {
+    for (size_t i = 0;i < in_length;i++) {
+      _input(in_data[i]);
+    }
+  }
+
+  uint32_t Simulator::_random() {
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+  }
+
+  //! approximately normal, sum of uniforms
+  double Simulator::_gaussian() {
+    double t = 0;
+    for (int i = 0;i < 12;i++) {
+      t += _random() / 4294967296.0;
+    }
+    return t - 6;
+  }
+
+  void Simulator::_move() {
+    double dt = 1.0 / m_hz;
+    double h = m_heading / DEGREES;
+    m_lat += m_speed * cos(h) * dt / EARTH_RADIUS * DEGREES;
+    m_lon += m_speed * sin(h) * dt / (EARTH_RADIUS * cos(m_lat / DEGREES)) * DEGREES;
+    if (m_lon >= 180) {
+      m_lon -= 360;
+    } else
+    if (m_lon < -180) {
+      m_lon += 360;
+    }
+    m_heading = fmod(m_heading + m_turnRate * dt + 360,360);
+    m_time += GPS_NANOS_PER_SECOND / m_hz;
+  }
+
+  void Simulator::_corrupt(uint8_t *io_data,size_t in_length) {
+    if (in_length > 0 && m_errorRate > 0 && _random() / 4294967296.0 < m_errorRate) {
+      uint32_t r = _random();
+      io_data[(r >> 3) % in_length] ^= 1 << (r & 7);
+    }
+  }
+
+  void Simulator::_input(uint8_t in_c) {
+    if (m_inLength == 0) {
+      // a receiver ignores the protocol it is not using
+      if ((m_protocol == NMEA::PROTOCOL_NMEA && in_c == '$') ||
+          (m_protocol == NMEA::PROTOCOL_SiRF_binary && in_c == 0xa0)) {
+        m_in[m_inLength++] = in_c;
+      }
+      return;
+    }
+    if (m_in[0] == '$') {
+      if (in_c == '\n') {
+        m_in[m_inLength] = 0;
+        _sentence();
+        m_inLength = 0;
+      } else
+      if (m_inLength < sizeof(m_in) - 1) {
+        m_in[m_inLength++] = in_c;
+      } else {
+        m_inLength = 0;
+      }
+      return;
+    }
+    m_in[m_inLength++] = in_c;
+    if (m_inLength == 2 && in_c != 0xa2) {
+      m_inLength = 0;
+    } else
+    if (m_inLength >= 4) {
+      size_t total = ((m_in[2] & 0x7f) << 8 | m_in[3]) + 8;
+      if (total > sizeof(m_in)) {
+        m_inLength = 0;
+      } else
+      if (m_inLength == total) {
+        _frame();
+        m_inLength = 0;
+      }
+    }
+  }
+
+  void Simulator::_sentence() {
+    char *s = (char *)m_in;
+    char *star = strchr(s,'*');
+    if (star == NULL || hexValue(star[1]) > 15 || hexValue(star[2]) > 15) {
+      return;
+    }
+    uint8_t checksum = hexValue(star[1]) << 4 | hexValue(star[2]);
+    *star = 0;
+    if (util::nmeaChecksum(s + 1) != checksum) {
+      return;
+    }
+    long f[4] = { -1, -1, -1, -1 };
+    char *p = strchr(s,',');
+    for (int i = 0;i < 4 && p != NULL;i++) {
+      f[i] = strtol(p + 1,NULL,10);
+      p = strchr(p + 1,',');
+    }
+    if (strncmp(s,"$PSRF100,",9) == 0) {
+      if (f[1] > 0) {
+        m_baud = f[1];
+      }
+      if (f[0] == NMEA::PROTOCOL_SiRF_binary) {
+        m_protocol = NMEA::PROTOCOL_SiRF_binary;
+      }
+    } else
+    if (strncmp(s,"$PSRF103,",9) == 0 && f[0] >= 0 && f[0] <= NMEA::MSG_ZDA) {
+      if (f[1] == NMEA::QUERY) {
+        m_queries |= 1 << f[0];
+      } else
+      if (f[1] == NMEA::SET_RATE && f[2] >= 0 && f[2] <= 255) {
+        m_rates[f[0]] = f[2];
+      }
+    }
+  }
+
+  void Simulator::_frame() {
+    uint16_t length = (m_in[2] & 0x7f) << 8 | m_in[3];
+    const uint8_t *payload = m_in + 4;
+    uint16_t checksum = payload[length] << 8 | payload[length + 1];
+    if (length == 0 || checksum != (util::byteSum(payload,length) & 0x7fff) ||
+        payload[length + 2] != 0xb0 || payload[length + 3] != 0xb3) {
+      return;
+    }
+    const uint8_t *body = payload + 1;
+    switch(payload[0]) {
+      case SiRF::SetBinarySerialPortID:
+        if (length < 1 + sizeof(SiRF::SetBinarySerialPort)) {
+          return;
+        }
+        m_baud = util::readBE32(body + offsetof(SiRF::SetBinarySerialPort,bitRate));
+        break;
+      case SiRF::SetProtocolID:
+        if (length < 1 + sizeof(SiRF::SetProtocol)) {
+          return;
+        }
+        if (body[offsetof(SiRF::SetProtocol,protocol)] == SiRF::Protocol_NMEA) {
+          m_protocol = NMEA::PROTOCOL_NMEA;
+        }
+        break;
+      case SiRF::SetMessageRateID:
+        if (length < 1 + sizeof(SiRF::SetMessageRate)) {
+          return;
+        }
+        setBinaryRate(body[offsetof(SiRF::SetMessageRate,messageIDToBeSet)],
+                      body[offsetof(SiRF::SetMessageRate,updateRate)]);
+        break;
+      default:
+        return;
+    }
+    if (m_ackCount < sizeof(m_acks)) {
+      m_acks[m_ackCount++] = payload[0];
+    }
+  }
+
+  bool Simulator::_due(uint8_t in_message) {
+    uint8_t rate = m_rates[in_message];
+    return (m_queries & (1 << in_message)) || (rate != 0 && m_epochs % rate == 0);
+  }
+
+  size_t Simulator::_nmea(uint8_t *out_buffer,size_t in_size) {
+    NMEA::Encoder encoder((char *)out_buffer,in_size);
+    NMEA::UTCTime utcTime;
+    setTime(&utcTime,m_time);
+    NMEA::coordinate_t latitude = toCoordinate(m_reportedLat);
+    NMEA::coordinate_t longitude = toCoordinate(m_reportedLon);
+    int8_t ns = m_reportedLat < 0 ? 'S' : 'N';
+    int8_t ew = m_reportedLon < 0 ? 'W' : 'E';
+    size_t l = 0,n;
+
+#ifdef NMEA_USE_GGA
+    if (_due(NMEA::MSG_GGA)) {
+      NMEA::GGA gga;
+      memset(&gga,0xff,sizeof(gga));
+      gga.utcTime = utcTime;
+      gga.latitude = latitude;
+      gga.nsIndicator = ns;
+      gga.longitude = longitude;
+      gga.ewIndicator = ew;
+      gga.positionFixIndicator = 1;
+      gga.satelitesUsed = SIMULATOR_SATELLITES;
+      setDecimal(&gga.hdop,1.0);
+      setDecimal(&gga.mslAltitude,m_alt);
+      gga.units = 'M';
+      setDecimal(&gga.geoidSeparation,36.7);
+      gga.units2 = 'M';
+      if ((n = encoder.encode(gga)) > 0) {
+        _corrupt(out_buffer + l,n);
+        l += n;
+      }
+    }
+#endif
+#ifdef NMEA_USE_GSA
+    if (_due(NMEA::MSG_GSA)) {
+      NMEA::GSA gsa;
+      memset(&gsa,0xff,sizeof(gsa));
+      gsa.mode1 = 'A';
+      gsa.mode2 = 3;
+      for (int i = 0;i < SIMULATOR_SATELLITES;i++) {
+        gsa.satelliteUsed[i] = SATELLITES[i][0];
+      }
+      setDecimal(&gsa.pdop,1.8);
+      setDecimal(&gsa.hdop,1.0);
+      setDecimal(&gsa.vdop,1.5);
+      if ((n = encoder.encode(gsa)) > 0) {
+        _corrupt(out_buffer + l,n);
+        l += n;
+      }
+    }
+#endif
+#ifdef NMEA_USE_GSV
+    if (_due(NMEA::MSG_GSV)) {
+      const int pages = (SIMULATOR_SATELLITES + 3) / 4;
+      for (int page = 0;page < pages;page++) {
+        NMEA::GSV gsv;
+        memset(&gsv,0xff,sizeof(gsv));
+        gsv.numberOfMessages = pages;
+        gsv.messageNumber = page + 1;
+        gsv.satellitesInView = SIMULATOR_SATELLITES;
+        for (int i = 0;i < 4 && page * 4 + i < SIMULATOR_SATELLITES;i++) {
+          const uint16_t *sat = SATELLITES[page * 4 + i];
+          gsv.satellites[i].satelliteID = sat[0];
+          gsv.satellites[i].elevation = sat[1];
+          gsv.satellites[i].azimuth = sat[2];
+          gsv.satellites[i].snr = sat[3] + (int)(_random() % 5) - 2;
+        }
+        if ((n = encoder.encode(gsv)) > 0) {
+          _corrupt(out_buffer + l,n);
+          l += n;
+        }
+      }
+    }
+#endif
+#ifdef NMEA_USE_RMC
+    if (_due(NMEA::MSG_RMC)) {
+      int year;
+      unsigned month,day;
+      util::civilFromDays((int32_t)(m_time / GPS_NANOS_PER_SECOND / 86400),&year,&month,&day);
+      NMEA::RMC rmc;
+      memset(&rmc,0xff,sizeof(rmc));
+      rmc.utcTime = utcTime;
+      rmc.status = 'A';
+      rmc.latitude = latitude;
+      rmc.nsIndicator = ns;
+      rmc.longitude = longitude;
+      rmc.ewIndicator = ew;
+      setDecimal(&rmc.speedOverGround,m_speed * KNOTS);
+      setDecimal(&rmc.courseOverGround,m_heading);
+      rmc.date.day = day;
+      rmc.date.mon = month;
+      rmc.date.year = year % 100;
+      rmc.mode = 'A';
+      if ((n = encoder.encode(rmc)) > 0) {
+        _corrupt(out_buffer + l,n);
+        l += n;
+      }
+    }
+#endif
+#ifdef NMEA_USE_VTG
+    if (_due(NMEA::MSG_VTG)) {
+      NMEA::VTG vtg;
+      memset(&vtg,0xff,sizeof(vtg));
+      setDecimal(&vtg.course,m_heading);
+      vtg.reference = 'T';
+      vtg.reference2 = 'M';
+      setDecimal(&vtg.speed,m_speed * KNOTS);
+      vtg.units = 'N';
+      setDecimal(&vtg.speed2,m_speed * 3.6);
+      vtg.units2 = 'K';
+      vtg.mode = 'A';
+      if ((n = encoder.encode(vtg)) > 0) {
+        _corrupt(out_buffer + l,n);
+        l += n;
+      }
+    }
+#endif
+#ifdef NMEA_USE_ZDA
+    if (_due(NMEA::MSG_ZDA)) {
+      int year;
+      unsigned month,day;
+      util::civilFromDays((int32_t)(m_time / GPS_NANOS_PER_SECOND / 86400),&year,&month,&day);
+      NMEA::ZDA zda;
+      memset(&zda,0xff,sizeof(zda));
+      zda.utcTime = utcTime;
+      zda.day = day;
+      zda.month = month;
+      zda.year = year;
+      zda.localZoneHour = 0;
+      zda.localZoneMinutes = 0;
+      if ((n = encoder.encode(zda)) > 0) {
+        _corrupt(out_buffer + l,n);
+        l += n;
+      }
+    }
+#endif
+    return l;
+  }
+
+  size_t Simulator::_binary(uint8_t *out_buffer,size_t in_size) {
+    if (m_mid41Rate == 0 || m_epochs % m_mid41Rate != 0) {
+      return 0;
+    }
+    uint8_t payload[1 + sizeof(SiRF::GeodeticNavigationData)];
+    uint8_t *body = payload + 1;
+    memset(payload,0,sizeof(payload));
+    payload[0] = SiRF::GeodeticNavigationDataID;
+
+    uint16_t week;
+    int64_t tow;
+    util::epochNanosToGPS(m_time,&week,&tow);
+    int64_t ms = m_time / 1000000;
+    int year;
+    unsigned month,day;
+    util::civilFromDays((int32_t)(ms / 86400000),&year,&month,&day);
+    uint32_t satellites = 0;
+    for (int i = 0;i < SIMULATOR_SATELLITES;i++) {
+      satellites |= 1UL << (SATELLITES[i][0] - 1);
+    }
+
+    // 3+ SV KF solution
+    util::writeBE16(body + offsetof(SiRF::GeodeticNavigationData,navType),4);
+    util::writeBE16(body + offsetof(SiRF::GeodeticNavigationData,extendedWeekNumber),week);
+    util::writeBE32(body + offsetof(SiRF::GeodeticNavigationData,TOW),(uint32_t)(tow / 1000000));
+    util::writeBE16(body + offsetof(SiRF::GeodeticNavigationData,UTCYear),year);
+    body[offsetof(SiRF::GeodeticNavigationData,UTCMonth)] = month;
+    body[offsetof(SiRF::GeodeticNavigationData,UTCDay)] = day;
+    body[offsetof(SiRF::GeodeticNavigationData,UTCHour)] = ms / 3600000 % 24;
+    body[offsetof(SiRF::GeodeticNavigationData,UTCMinute)] = ms / 60000 % 60;
+    util::writeBE16(body + offsetof(SiRF::GeodeticNavigationData,UTCSecond),ms % 60000);
+    util::writeBE32(body + offsetof(SiRF::GeodeticNavigationData,satelliteIDList),satellites);
+    util::writeBE32(body + offsetof(SiRF::GeodeticNavigationData,latitude),
+                    (uint32_t)(int32_t)floor(m_reportedLat * 1e7 + 0.5));
+    util::writeBE32(body + offsetof(SiRF::GeodeticNavigationData,longitude),
+                    (uint32_t)(int32_t)floor(m_reportedLon * 1e7 + 0.5));
+    util::writeBE32(body + offsetof(SiRF::GeodeticNavigationData,altitudeFromEllipsoid),
+                    (uint32_t)(int32_t)((m_alt + 36.7) * 100));
+    util::writeBE32(body + offsetof(SiRF::GeodeticNavigationData,altitudeFromMSL),
+                    (uint32_t)(int32_t)(m_alt * 100));
+    // WGS-84
+    body[offsetof(SiRF::GeodeticNavigationData,mapDatum)] = 21;
+    util::writeBE16(body + offsetof(SiRF::GeodeticNavigationData,speedOverGround),(uint16_t)(m_speed * 100));
+    util::writeBE16(body + offsetof(SiRF::GeodeticNavigationData,courseOverGround),(uint16_t)(m_heading * 100));
+    body[offsetof(SiRF::GeodeticNavigationData,numberOfSVsInFix)] = SIMULATOR_SATELLITES;
+    // 0.2 steps
+    body[offsetof(SiRF::GeodeticNavigationData,HDOP)] = 5;
+
+    return _sirfFrame(payload,sizeof(payload),out_buffer,in_size);
+  }
+
+  size_t Simulator::_sirfFrame(const uint8_t *in_payload,uint16_t in_length,uint8_t *out_buffer,size_t in_size) {
+    size_t total = in_length + 8;
+    if (total > in_size) {
+      return 0;
+    }
+    uint16_t checksum = util::byteSum(in_payload,in_length) & 0x7fff;
+    out_buffer[0] = 0xa0;
+    out_buffer[1] = 0xa2;
+    util::writeBE16(out_buffer + 2,in_length);
+    memcpy(out_buffer + 4,in_payload,in_length);
+    util::writeBE16(out_buffer + 4 + in_length,checksum);
+    out_buffer[total - 2] = 0xb0;
+    out_buffer[total - 1] = 0xb3;
+    _corrupt(out_buffer,total);
+    return total;
+  }
+
+  size_t SimulatorPort::step() {
+    if (m_position == m_length) {
+      m_position = m_length = 0;
+    }
+    size_t l = m_simulator.epoch(m_buffer + m_length,sizeof(m_buffer) - m_length);
+    if (m_baud != m_simulator.baud()) {
+      // framing errors of a mismatched baud rate
+      for (size_t i = m_length;i < m_length + l;i++) {
+        m_buffer[i] = m_buffer[i] * 7 + 3;
+      }
+    }
+    m_length += l;
+    return l;
+  }
+
+} /* GPS */
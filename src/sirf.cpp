@@ -0,0 +1,195 @@
+#include "GPS/sirf.h"
+
+#define SIRF_FIELD(s,f,flags) \
+  { offsetof(s,f),sizeof(((s *)0)->f),flags,1,0 }
+#define SIRF_ARRAY_FIELD(s,a,e,f,flags) \
+  { offsetof(s,a) + offsetof(e,f),sizeof(((e *)0)->f),flags,SIRF_CHANNELS,sizeof(e) }
+#define SIRF_LAYOUT(id,s,minLength,fields) \
+  { id,minLength,sizeof(s),sizeof(fields) / sizeof(fields[0]),fields }
+
+namespace GPS {
+
+namespace SiRF {
+
+#ifdef SIRF_USE_2
+  static const FieldLayout measureNavigationDataOutFields[] =
+      {
+        SIRF_FIELD(MeasureNavigationDataOut,xPosition,FIELD_SIGNED),
+        SIRF_FIELD(MeasureNavigationDataOut,yPosition,FIELD_SIGNED),
+        SIRF_FIELD(MeasureNavigationDataOut,zPosition,FIELD_SIGNED),
+        SIRF_FIELD(MeasureNavigationDataOut,xVelocity,FIELD_SIGNED),
+        SIRF_FIELD(MeasureNavigationDataOut,yVelocity,FIELD_SIGNED),
+        SIRF_FIELD(MeasureNavigationDataOut,zVelocity,FIELD_SIGNED),
+        SIRF_FIELD(MeasureNavigationDataOut,GPSWeek,0),
+        SIRF_FIELD(MeasureNavigationDataOut,GPSTOW,0)
+      } ;
+#endif
+
+#ifdef SIRF_USE_4
+  static const FieldLayout measuredTrackerDataOutFields[] =
+      {
+        SIRF_FIELD(MeasuredTrackerDataOut,GPSWeek,0),
+        SIRF_FIELD(MeasuredTrackerDataOut,GPSTOW,0),
+        SIRF_ARRAY_FIELD(MeasuredTrackerDataOut,channels,TrackerChannel,state,0)
+      } ;
+#endif
+
+#ifdef SIRF_USE_7
+  static const FieldLayout clockStatusDataFields[] =
+      {
+        SIRF_FIELD(ClockStatusData,extendedGPSWeek,0),
+        SIRF_FIELD(ClockStatusData,GPSTOW,0),
+        SIRF_FIELD(ClockStatusData,clockDrift,0),
+        SIRF_FIELD(ClockStatusData,clockBias,0),
+        SIRF_FIELD(ClockStatusData,estimatedGPSTime,0)
+      } ;
+#endif
+
+#ifdef SIRF_USE_9
+  static const FieldLayout CPUThroughputFields[] =
+      {
+        SIRF_FIELD(CPUThroughput,segStatMax,0),
+        SIRF_FIELD(CPUThroughput,segStatLat,0),
+        SIRF_FIELD(CPUThroughput,aveTrkTime,0),
+        SIRF_FIELD(CPUThroughput,lastMillisecond,0)
+      } ;
+#endif
+
+#ifdef SIRF_USE_13
+  static const FieldLayout visibleListFields[] =
+      {
+        SIRF_ARRAY_FIELD(VisibleList,SVs,VisibleSV,azimuth,FIELD_SIGNED),
+        SIRF_ARRAY_FIELD(VisibleList,SVs,VisibleSV,elevation,FIELD_SIGNED)
+      } ;
+#endif
+
+#ifdef SIRF_USE_41
+  static const FieldLayout geodeticNavigationDataFields[] =
+      {
+        SIRF_FIELD(GeodeticNavigationData,navValid,0),
+        SIRF_FIELD(GeodeticNavigationData,navType,0),
+        SIRF_FIELD(GeodeticNavigationData,extendedWeekNumber,0),
+        SIRF_FIELD(GeodeticNavigationData,TOW,0),
+        SIRF_FIELD(GeodeticNavigationData,UTCYear,0),
+        SIRF_FIELD(GeodeticNavigationData,UTCSecond,0),
+        SIRF_FIELD(GeodeticNavigationData,satelliteIDList,0),
+        SIRF_FIELD(GeodeticNavigationData,latitude,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,longitude,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,altitudeFromEllipsoid,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,altitudeFromMSL,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,speedOverGround,0),
+        SIRF_FIELD(GeodeticNavigationData,courseOverGround,0),
+        SIRF_FIELD(GeodeticNavigationData,magneticVariation,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,climbRate,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,headingRate,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,estimatedHorizontalPositionError,0),
+        SIRF_FIELD(GeodeticNavigationData,estimatedVerticalPositionError,0),
+        SIRF_FIELD(GeodeticNavigationData,estimatedTimeError,0),
+        SIRF_FIELD(GeodeticNavigationData,estimatedHorizontalVelocityError,0),
+        SIRF_FIELD(GeodeticNavigationData,clockBias,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,clockBiasError,0),
+        SIRF_FIELD(GeodeticNavigationData,clockDrift,FIELD_SIGNED),
+        SIRF_FIELD(GeodeticNavigationData,clockDriftError,0),
+        SIRF_FIELD(GeodeticNavigationData,distance,0),
+        SIRF_FIELD(GeodeticNavigationData,distanceError,0),
+        SIRF_FIELD(GeodeticNavigationData,headingError,0)
+      } ;
+#endif
+
+  const MessageLayout messageLayouts[] =
+      {
+#ifdef SIRF_USE_2
+        SIRF_LAYOUT(MeasureNavigationDataOutID,MeasureNavigationDataOut,
+                    sizeof(MeasureNavigationDataOut),measureNavigationDataOutFields),
+#endif
+#ifdef SIRF_USE_4
+        SIRF_LAYOUT(MeasuredTrackerDataOutID,MeasuredTrackerDataOut,
+                    sizeof(MeasuredTrackerDataOut),measuredTrackerDataOutFields),
+#endif
+#ifdef SIRF_USE_7
+        SIRF_LAYOUT(ClockStatusDataID,ClockStatusData,
+                    sizeof(ClockStatusData),clockStatusDataFields),
+#endif
+#ifdef SIRF_USE_9
+        SIRF_LAYOUT(CPUThroughputID,CPUThroughput,
+                    sizeof(CPUThroughput),CPUThroughputFields),
+#endif
+#ifdef SIRF_USE_11
+        { CommandAcknowledgmentID,sizeof(CommandAcknowledgment),sizeof(CommandAcknowledgment),0,NULL },
+#endif
+#ifdef SIRF_USE_13
+        // visibleSVs followed by 0 - 12 entries
+        SIRF_LAYOUT(VisibleListID,VisibleList,
+                    1,visibleListFields),
+#endif
+#ifdef SIRF_USE_41
+        SIRF_LAYOUT(GeodeticNavigationDataID,GeodeticNavigationData,
+                    sizeof(GeodeticNavigationData),geodeticNavigationDataFields),
+#endif
+      } ;
+
+  const uint8_t messageLayoutCount = sizeof(messageLayouts) / sizeof(messageLayouts[0]);
+
+#ifdef SIRF_USE_SHUFFLE
+  ShuffleProgram shufflePrograms[sizeof(messageLayouts) / sizeof(messageLayouts[0])];
+
+  static void buildShuffleProgram(const MessageLayout &in_layout,ShuffleProgram &out_program) {
+    uint8_t width[256];
+
+    out_program.count = 0;
+    if (in_layout.length < 16)
+      return;
+
+    memset(width,0,sizeof(width));
+    for (uint8_t i = 0;i < in_layout.fieldCount;i++) {
+      const FieldLayout &f = in_layout.fields[i];
+      for (uint8_t n = 0;n < f.count;n++) {
+        width[f.offset + n * f.stride] = f.width;
+      }
+    }
+
+    int pos = 0;
+    while (true) {
+      while (pos < in_layout.length && width[pos] == 0)
+        pos++;
+      if (pos >= in_layout.length)
+        break;
+      if (out_program.count == SIRF_MAX_SHUFFLE_SEGMENTS) {
+        out_program.count = 0;
+        return;
+      }
+
+      int seg = pos;
+      if (seg > in_layout.length - 16)
+        seg = in_layout.length - 16;
+      uint8_t *mask = out_program.mask[out_program.count];
+      for (int i = 0;i < 16;i++)
+        mask[i] = i;
+      while (pos < seg + 16) {
+        int w = width[pos];
+        if (w == 0) {
+          pos++;
+          continue;
+        }
+        if (pos + w > seg + 16)
+          break;
+        for (int i = 0;i < w;i++)
+          mask[pos - seg + i] = pos - seg + w - 1 - i;
+        pos += w;
+      }
+      out_program.offset[out_program.count++] = seg;
+    }
+  }
+
+  static struct ShuffleProgramBuilder {
+    ShuffleProgramBuilder() {
+      for (uint8_t i = 0;i < messageLayoutCount;i++) {
+        buildShuffleProgram(messageLayouts[i],shufflePrograms[i]);
+      }
+    }
+  } shuffleProgramBuilder;
+#endif
+
+} /* SiRF */
+
+} /* GPS */
@@ -0,0 +1,66 @@
+#ifndef __PtyPort_h
+#define __PtyPort_h
+
+#include <CUnit/CUnit.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <termios.h>
+
+inline speed_t speedOf(long in_baud) {
+  switch(in_baud) {
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+  }
+  return B0;
+}
+
+inline long baudOf(speed_t in_speed) {
+  const long rates[] = { 4800, 9600, 19200, 38400, 57600, 115200 };
+  for (size_t i = 0;i < sizeof(rates) / sizeof(rates[0]);i++) {
+    if (speedOf(rates[i]) == in_speed)
+      return rates[i];
+  }
+  return 0;
+}
+
+/**
+  Host side of a pseudo terminal, opened like a serial device
+*/
+class PtyPort {
+public:
+  PtyPort(int in_fd) : m_fd(in_fd),m_length(0),m_pos(0) {}
+  void begin(long in_baud) {
+    struct termios t;
+    tcgetattr(m_fd,&t);
+    cfmakeraw(&t);
+    cfsetispeed(&t,speedOf(in_baud));
+    cfsetospeed(&t,speedOf(in_baud));
+    tcsetattr(m_fd,TCSANOW,&t);
+  }
+  void flush() { tcdrain(m_fd); }
+  int available() {
+    if (m_pos == m_length) {
+      int n = ::read(m_fd,m_in,sizeof(m_in));
+      m_length = n > 0 ? n : 0;
+      m_pos = 0;
+    }
+    return m_length - m_pos;
+  }
+  int read() { return m_in[m_pos++]; }
+  void write(uint8_t c) { write(&c,1); }
+  void write(const uint8_t *in_data,int in_length) {
+    CU_ASSERT(::write(m_fd,in_data,in_length) == in_length);
+  }
+  void write(const char *in_data,int in_length) { write((const uint8_t *)in_data,in_length); }
+private:
+  int m_fd;
+  uint8_t m_in[256];
+  int m_length;
+  int m_pos;
+};
+
+#endif /* __PtyPort_h */
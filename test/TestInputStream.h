@@ -0,0 +1,20 @@
+#ifndef __TestInputStream_h
+#define __TestInputStream_h
+
+#include <inttypes.h>
+
+/**
+  A stream over a null terminated string, read like a serial port
+*/
+class TestInputStream {
+public:
+  TestInputStream(const char *in_data) : m_p(in_data) {}
+
+  void set(const char *in_data) { m_p = in_data; }
+  int available() const { return *m_p != 0; }
+  int read() { return *m_p ? (uint8_t)*m_p++ : -1; }
+private:
+  const char *m_p;
+};
+
+#endif /* __TestInputStream_h */
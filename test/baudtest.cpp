@@ -0,0 +1,214 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/baud.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include "PtyPort.h"
+#endif
+
+namespace {
+
+/**
+  Receiver behaviour: follows $PSRF100 up to its highest rate and
+  talks garbage when the host listens at another rate
+*/
+class StandIn {
+public:
+  StandIn(long in_baud,long in_maxBaud)
+    : baud(in_baud),maxBaud(in_maxBaud),m_lineLength(0) {}
+
+  void receive(const uint8_t *in_data,int in_length) {
+    for (int i = 0;i < in_length;i++) {
+      char c = in_data[i];
+      if (c == '\n') {
+        m_line[m_lineLength] = 0;
+        _command();
+        m_lineLength = 0;
+      } else
+      if (m_lineLength < (int)sizeof(m_line) - 1) {
+        m_line[m_lineLength++] = c;
+      }
+    }
+  }
+
+  //! one second of output as heard at in_hostBaud
+  int output(long in_hostBaud,char *out_buffer) {
+    const char *zda = "$GPZDA,181813,14,10,2003,00,00*4F\r\n";
+    int l = strlen(zda);
+    memcpy(out_buffer,zda,l);
+    if (in_hostBaud != baud) {
+      for (int i = 0;i < l;i++)
+        out_buffer[i] = (char)(out_buffer[i] * 7 + 3);
+    }
+    return l;
+  }
+
+  long baud;
+  long maxBaud;
+private:
+  char m_line[96];
+  int m_lineLength;
+
+  void _command() {
+    if (strncmp(m_line,"$PSRF100,1,",11) == 0) {
+      long b = atol(m_line + 11);
+      if (b <= maxBaud)
+        baud = b;
+    }
+  }
+};
+
+class SimPort {
+public:
+  SimPort(StandIn &in_receiver,long in_baud)
+    : baud(in_baud),m_receiver(in_receiver),m_length(0),m_pos(0) {}
+  void begin(long in_baud) { baud = in_baud; }
+  void flush() {}
+  int available() const { return m_length - m_pos; }
+  int read() { return (uint8_t)m_in[m_pos++]; }
+  void write(uint8_t c) { m_receiver.receive(&c,1); }
+  void write(const uint8_t *in_data,int in_length) { m_receiver.receive(in_data,in_length); }
+  void write(const char *in_data,int in_length) { write((const uint8_t *)in_data,in_length); }
+
+  void tick() {
+    m_length = m_receiver.output(baud,m_in);
+    m_pos = 0;
+  }
+
+  long baud;
+private:
+  StandIn &m_receiver;
+  char m_in[128];
+  int m_length;
+  int m_pos;
+};
+
+int g_done = 0;
+bool g_reached = false;
+long g_baud = 0;
+
+void baudHandler(long in_baud,bool in_reached) {
+  g_done++;
+  g_reached = in_reached;
+  g_baud = in_baud;
+}
+
+} /* namespace */
+
+void test_baud_upgrade(void) {
+  StandIn receiver(9600,115200);
+  SimPort port(receiver,9600);
+  GPS::NMEA::Parser<SimPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<SimPort> sirf(port,messageParser);
+  GPS::BaudNegotiator<SimPort> negotiator(port,nmea,sirf,9600,GPS::NMEA::PROTOCOL_NMEA,3000);
+  negotiator.setHandler(baudHandler);
+  g_done = 0;
+
+  CU_ASSERT(negotiator.upgrade(115200,0));
+  CU_ASSERT(!negotiator.upgrade(115200,0));
+  for (uint32_t t = 0;t < 30000 && negotiator.busy();t += 1000) {
+    port.tick();
+    negotiator.update(t);
+  }
+  CU_ASSERT(g_done == 1);
+  CU_ASSERT(g_reached);
+  CU_ASSERT(negotiator.baud() == 115200);
+  CU_ASSERT(port.baud == 115200 && receiver.baud == 115200);
+  CU_ASSERT(negotiator.failures() == 0);
+}
+
+void test_baud_rollback(void) {
+  StandIn receiver(9600,38400);
+  SimPort port(receiver,9600);
+  GPS::NMEA::Parser<SimPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<SimPort> sirf(port,messageParser);
+  GPS::BaudNegotiator<SimPort> negotiator(port,nmea,sirf,9600,GPS::NMEA::PROTOCOL_NMEA,3000);
+  negotiator.setHandler(baudHandler);
+  g_done = 0;
+
+  CU_ASSERT(negotiator.upgrade(115200,0));
+  for (uint32_t t = 0;t < 60000 && negotiator.busy();t += 1000) {
+    port.tick();
+    negotiator.update(t);
+  }
+  // 57600 is not heard, the port goes back to 38400
+  CU_ASSERT(g_done == 1);
+  CU_ASSERT(!g_reached);
+  CU_ASSERT(g_baud == 38400);
+  CU_ASSERT(port.baud == 38400 && receiver.baud == 38400);
+  CU_ASSERT(negotiator.failures() == 1);
+}
+
+#ifdef __linux__
+
+namespace {
+
+/**
+  Receiver side, judges the host rate from the terminal settings
+*/
+void serviceStandIn(int in_master,StandIn &io_receiver) {
+  uint8_t buf[256];
+  int n;
+  while ((n = ::read(in_master,buf,sizeof(buf))) > 0)
+    io_receiver.receive(buf,n);
+
+  struct termios t;
+  tcgetattr(in_master,&t);
+  char out[128];
+  int l = io_receiver.output(baudOf(cfgetospeed(&t)),out);
+  CU_ASSERT(::write(in_master,out,l) == l);
+}
+
+} /* namespace */
+
+void test_baud_pty(void) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  CU_ASSERT_FATAL(master >= 0);
+  CU_ASSERT_FATAL(grantpt(master) == 0 && unlockpt(master) == 0);
+  int slave = open(ptsname(master),O_RDWR | O_NOCTTY | O_NONBLOCK);
+  CU_ASSERT_FATAL(slave >= 0);
+  fcntl(master,F_SETFL,fcntl(master,F_GETFL) | O_NONBLOCK);
+
+  StandIn receiver(9600,57600);
+  PtyPort port(slave);
+  port.begin(9600);
+  GPS::NMEA::Parser<PtyPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<PtyPort> sirf(port,messageParser);
+  GPS::BaudNegotiator<PtyPort> negotiator(port,nmea,sirf,9600,GPS::NMEA::PROTOCOL_NMEA,3000);
+  negotiator.setHandler(baudHandler);
+  g_done = 0;
+
+  CU_ASSERT(negotiator.upgrade(115200,0));
+  for (uint32_t t = 0;t < 60000 && negotiator.busy();t += 1000) {
+    serviceStandIn(master,receiver);
+    negotiator.update(t);
+  }
+  CU_ASSERT(g_done == 1);
+  CU_ASSERT(g_baud == 57600);
+  CU_ASSERT(receiver.baud == 57600);
+  CU_ASSERT(negotiator.failures() == 1);
+
+  close(slave);
+  close(master);
+}
+
+#endif /* __linux__ */
+
+void init_baudtest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Baud", NULL, NULL);
+  CU_add_test(suite, "test_baud_upgrade", test_baud_upgrade);
+  CU_add_test(suite, "test_baud_rollback", test_baud_rollback);
+#ifdef __linux__
+  CU_add_test(suite, "test_baud_pty", test_baud_pty);
+#endif
+}
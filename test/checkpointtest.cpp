@@ -0,0 +1,261 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/checkpoint.h>
+#include <GPS/simulator.h>
+#include "TestInputStream.h"
+
+#include <string.h>
+#include <new>
+
+namespace {
+
+enum {
+  EPOCHS = 8,
+  MAX_EVENTS = 256
+};
+
+uint32_t g_events[MAX_EVENTS];
+uint32_t g_eventCount = 0;
+
+void log(uint32_t in_event) {
+  if (g_eventCount < MAX_EVENTS)
+    g_events[g_eventCount++] = in_event;
+}
+
+void nmeaHandler(const GPS::NMEA::Message &in_msg) {
+  log(GPS::util::fingerprint(&in_msg,sizeof(in_msg)));
+}
+
+void sirfHandler(const GPS::SiRF::OutputMessage &in_msg) {
+  const GPS::SiRF::MessageLayout *layout = GPS::SiRF::findMessageLayout(in_msg.messageID);
+  log(GPS::util::fingerprint(&in_msg,layout ? layout->length + 1 : 1) ^ 1);
+}
+
+void rawHandler(const uint8_t *in_frame,uint16_t in_length) {
+  log(GPS::util::fingerprint(in_frame,in_length) ^ 2);
+}
+
+//! parsers of a stream carrying NMEA and SiRF binary
+struct Stack {
+  typedef GPS::SiRF::PacketParser<GPS::util::ChunkStream> PacketParser;
+  typedef GPS::Demux<GPS::util::ChunkStream,PacketParser> StreamDemux;
+
+  Stack(bool in_buffers)
+    : sirf(chunk,messageParser),
+      demux(chunk,sirf),
+      nmea(demux) {
+    nmea.setHandler(nmeaHandler);
+    sirf.setHandler(sirfHandler);
+    if (in_buffers) {
+      sirf.setPayloadBuffer(payload,sizeof(payload));
+      sirf.setRawHandler(rawHandler,raw,sizeof(raw),true);
+    }
+  }
+
+  void feed(const uint8_t *in_data,size_t in_length) {
+    chunk.set(in_data,in_length);
+    nmea.yyparse();
+  }
+
+  size_t checkpoint(uint8_t *out_blob,size_t in_size) const {
+    GPS::CheckpointWriter writer(out_blob,in_size);
+    writer.add(nmea);
+    writer.add(demux);
+    writer.add(sirf);
+    return writer.finish();
+  }
+
+  bool restore(const uint8_t *in_blob,size_t in_length) {
+    GPS::CheckpointReader reader(in_blob,in_length);
+    return reader.valid() && reader.restore(&nmea) && reader.restore(&demux) && reader.restore(&sirf);
+  }
+
+  GPS::util::ChunkStream chunk;
+  GPS::SiRF::MessageParser messageParser;
+  PacketParser sirf;
+  StreamDemux demux;
+  GPS::NMEA::Parser<StreamDemux> nmea;
+  uint8_t payload[128];
+  uint8_t raw[136];
+};
+
+//! a Stack in memory filled with a pattern, state which is not restored shows
+Stack *poisoned(void *out_storage,bool in_buffers) {
+  memset(out_storage,0x55,sizeof(Stack));
+  return new(out_storage) Stack(in_buffers);
+}
+
+/*
+  NMEA and SiRF binary epochs in turn, with bit errors, and a false
+  frame start in front of a copy of the last frame, which is found
+  again by rescanning the backtrack window
+*/
+size_t generate(uint8_t *out_buffer,size_t in_size) {
+  GPS::Simulator sim(7);
+  sim.setMotion(10,45,2);
+  sim.setErrorRate(0.05);
+  size_t l = 0,frame = 0,frameLength = 0;
+  for (int i = 0;i < EPOCHS;i++) {
+    sim.setProtocol(i & 1 ? GPS::NMEA::PROTOCOL_SiRF_binary : GPS::NMEA::PROTOCOL_NMEA);
+    frame = l;
+    frameLength = sim.epoch(out_buffer + l,in_size - l);
+    l += frameLength;
+  }
+  static const uint8_t falseStart[] = { 0xa0,0xa2,0x00,0x05 };
+  memcpy(out_buffer + l,falseStart,sizeof(falseStart));
+  memcpy(out_buffer + l + sizeof(falseStart),out_buffer + frame,frameLength);
+  return l + sizeof(falseStart) + frameLength;
+}
+
+} /* namespace */
+
+void test_checkpoint_every_split(void) {
+  uint8_t data[SIMULATOR_EPOCH_SIZE * (EPOCHS + 1)];
+  size_t length = generate(data,sizeof(data));
+
+  for (int buffers = 0;buffers < 2;buffers++) {
+    Stack reference(buffers);
+    g_eventCount = 0;
+    reference.feed(data,length);
+    uint32_t expected[MAX_EVENTS];
+    uint32_t expectedCount = g_eventCount;
+    memcpy(expected,g_events,sizeof(expected));
+    CU_ASSERT(reference.nmea.messages() > 0 && reference.sirf.frames() > 0 && reference.sirf.resyncs() > 0);
+
+    size_t failures = 0,largest = 0;
+    for (size_t split = 0;split <= length;split++) {
+      g_eventCount = 0;
+      Stack before(buffers);
+      uint64_t storage[sizeof(Stack) / sizeof(uint64_t) + 1];
+      Stack &after = *poisoned(storage,buffers);
+      uint8_t blob[CHECKPOINT_MAX_SIZE];
+      before.feed(data,split);
+      size_t l = before.checkpoint(blob,sizeof(blob));
+      if (l > largest)
+        largest = l;
+      if (l == 0 || !after.restore(blob,l)) {
+        failures++;
+        continue;
+      }
+      after.feed(data + split,length - split);
+      if (g_eventCount != expectedCount || memcmp(g_events,expected,expectedCount * sizeof(uint32_t)) != 0 ||
+          after.nmea.messages() != reference.nmea.messages() ||
+          after.sirf.frames() != reference.sirf.frames() ||
+          after.sirf.resyncs() != reference.sirf.resyncs() ||
+          after.sirf.discardedBytes() != reference.sirf.discardedBytes() ||
+          after.demux.textBytes() != reference.demux.textBytes() ||
+          after.demux.binaryBytes() != reference.demux.binaryBytes())
+        failures++;
+    }
+    CU_ASSERT(failures == 0);
+    CU_ASSERT(largest <= CHECKPOINT_MAX_SIZE);
+  }
+}
+
+void test_checkpoint_nmea(void) {
+  const char *zda = "$GPZDA,181813,14,10,2003,00,00*4F\r\n";
+  GPS::util::ChunkStream stream;
+  GPS::NMEA::Parser<GPS::util::ChunkStream> parser(stream);
+  parser.setHandler(nmeaHandler);
+  g_eventCount = 0;
+  stream.set((const uint8_t *)zda,20);
+  parser.yyparse();
+
+  uint8_t blob[CHECKPOINT_MAX_SIZE];
+  GPS::CheckpointWriter writer(blob,sizeof(blob));
+  writer.add(parser);
+  size_t l = writer.finish();
+  CU_ASSERT(l == 4 + 3 + sizeof(GPS::NMEA::ParserState) + 4);
+
+  // into a detached state, then a parser of another stream class
+  GPS::CheckpointReader reader(blob,l);
+  GPS::NMEA::ParserState state;
+  CU_ASSERT(reader.valid());
+  CU_ASSERT(reader.restore(&state));
+  CU_ASSERT(state.parserState != 0);
+  TestInputStream rest(zda + 20);
+  GPS::NMEA::Parser<TestInputStream> other(rest);
+  other.setHandler(nmeaHandler);
+  CU_ASSERT(reader.restore(&other));
+  other.yyparse();
+  CU_ASSERT(g_eventCount == 1);
+  CU_ASSERT(other.messages() == 1);
+
+  // no other sections
+  Stack stack(false);
+  CU_ASSERT(!reader.restore(&stack.demux));
+  CU_ASSERT(!reader.restore(&stack.sirf));
+}
+
+void test_checkpoint_invalid(void) {
+  uint8_t data[SIMULATOR_EPOCH_SIZE];
+  GPS::Simulator sim(3);
+  sim.setProtocol(GPS::NMEA::PROTOCOL_SiRF_binary);
+  size_t length = sim.epoch(data,sizeof(data));
+  CU_ASSERT(length > 20 && data[0] == 0xa0);
+
+  // in the middle of a payload kept in the payload buffer
+  Stack stack(true);
+  stack.feed(data,20);
+  uint8_t blob[CHECKPOINT_MAX_SIZE];
+  size_t l = stack.checkpoint(blob,sizeof(blob));
+  CU_ASSERT(l > 0);
+  CU_ASSERT(stack.checkpoint(blob,l - 1) == 0);
+  l = stack.checkpoint(blob,sizeof(blob));
+
+  Stack other(true);
+  CU_ASSERT(other.restore(blob,l));
+
+  // a parser without the payload buffer cannot continue
+  Stack unbuffered(false);
+  GPS::CheckpointReader reader(blob,l);
+  CU_ASSERT(!reader.restore(&unbuffered.sirf));
+  unbuffered.feed(data,length);
+  CU_ASSERT(unbuffered.sirf.frames() == 1);
+
+  blob[l / 2] ^= 0x10;
+  CU_ASSERT(!GPS::CheckpointReader(blob,l).valid());
+  blob[l / 2] ^= 0x10;
+  CU_ASSERT(GPS::CheckpointReader(blob,l).valid());
+  blob[2] = GPS::CHECKPOINT_VERSION + 1;
+  GPS::util::writeBE32(blob + l - 4,GPS::util::fingerprint(blob,l - 4));
+  CU_ASSERT(!GPS::CheckpointReader(blob,l).valid());
+  CU_ASSERT(!GPS::CheckpointReader(blob,3).valid());
+
+  // NMEA states out of range of the lexer tables and the parser
+  GPS::NMEA::ParserState good;
+  TestInputStream stream("$GPGGA,002153.000,33");
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.yyparse();
+  parser.save(&good);
+  CU_ASSERT(GPS::NMEA::validState(good));
+  for (int i = 0;i < 8;i++) {
+    GPS::NMEA::ParserState bad = good;
+    switch(i) {
+      case 0: bad.lexerState = YY_MAX_STATE; break;
+      case 1: bad.lastAcceptingState = 0xff; break;
+      case 2: bad.lastAcceptingPosition = bad.length + 1; break;
+      case 3: bad.position = bad.length + 1; break;
+      case 4: bad.length = MAX_STRING_INPUT_BUFFER_SIZE + 1; break;
+      case 5: bad.parserState = GPS::NMEA::STATE_0 | 2; break;
+      case 6: bad.parserState = GPS::NMEA::STATE_WAIT_NL | 1; break;
+      case 7: bad.parserState = TK2ST(NMEA_TOKEN_PSRF155); break;
+    }
+    GPS::CheckpointWriter writer(blob,sizeof(blob));
+    writer.add(bad);
+    l = writer.finish();
+    GPS::CheckpointReader r(blob,l);
+    CU_ASSERT(r.valid());
+    GPS::NMEA::ParserState restored;
+    CU_ASSERT(!r.restore(&restored));
+  }
+}
+
+void init_checkpointtest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Checkpoint", NULL, NULL);
+  CU_add_test(suite, "test_checkpoint_every_split", test_checkpoint_every_split);
+  CU_add_test(suite, "test_checkpoint_nmea", test_checkpoint_nmea);
+  CU_add_test(suite, "test_checkpoint_invalid", test_checkpoint_invalid);
+}
@@ -0,0 +1,166 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/command.h>
+
+#include <string.h>
+
+namespace {
+
+class MockPort {
+public:
+  MockPort() : writes(0),outLength(0) {}
+  void write(const uint8_t *in_data,int in_length) {
+    memcpy(out + outLength,in_data,in_length);
+    outLength += in_length;
+    writes++;
+  }
+  void clear() {
+    writes = 0;
+    outLength = 0;
+  }
+
+  int writes;
+  uint8_t out[1024];
+  int outLength;
+};
+
+typedef GPS::CommandEngine<MockPort> Engine;
+
+int g_completed = 0;
+int g_acknowledged = 0;
+uint16_t g_last = 0;
+
+void commandHandler(uint16_t in_command,bool in_acknowledged) {
+  g_completed++;
+  g_acknowledged += in_acknowledged;
+  g_last = in_command;
+}
+
+void reset() {
+  g_completed = 0;
+  g_acknowledged = 0;
+}
+
+GPS::NMEA::Message nmeaAck(int in_ackID) {
+  GPS::NMEA::Message msg;
+  memset(&msg,0xff,sizeof(msg));
+  msg.messageID = NMEA_PSRF154;
+  msg.eeAck.ackID = in_ackID;
+  return msg;
+}
+
+GPS::SiRF::OutputMessage sirfAck(int in_ackID) {
+  GPS::SiRF::OutputMessage msg;
+  msg.messageID = GPS::SiRF::CommandAcknowledgmentID;
+  msg.messageBody.commandAcknowledgment.ackID = in_ackID;
+  return msg;
+}
+
+} /* namespace */
+
+void test_command_pipelined(void) {
+  MockPort port;
+  Engine engine(port,1000);
+  engine.setHandler(commandHandler);
+  reset();
+
+  int32_t a = engine.queryRateControl(GPS::NMEA::MSG_GGA,GPS::NMEA::SET_RATE,1,1);
+  int32_t b = engine.setMessageRate(0,41,1);
+  int32_t c = engine.setProtocol(GPS::SiRF::Protocol_NMEA);
+  CU_ASSERT(a >= 0 && b >= 0 && c >= 0);
+  CU_ASSERT(engine.pending() == 3);
+  CU_ASSERT(port.writes == 0);
+
+  engine.update(0);
+  // three different IDs are all in flight
+  CU_ASSERT(port.writes == 3);
+  CU_ASSERT(memcmp(port.out,"$PSRF103,0,0,1,1*25\r\n",21) == 0);
+  CU_ASSERT(port.out[21] == 0xa0 && port.out[25] == GPS::SiRF::SetMessageRateID);
+
+  CU_ASSERT(engine.acknowledge(sirfAck(GPS::SiRF::SetProtocolID)));
+  CU_ASSERT(g_completed == 1 && g_acknowledged == 1 && g_last == c);
+  CU_ASSERT(!engine.acknowledge(sirfAck(GPS::SiRF::SetProtocolID)));
+  CU_ASSERT(engine.acknowledge(nmeaAck(103)));
+  CU_ASSERT(g_last == a);
+  CU_ASSERT(engine.acknowledge(sirfAck(GPS::SiRF::SetMessageRateID)));
+  CU_ASSERT(g_last == b);
+  CU_ASSERT(engine.pending() == 0);
+  CU_ASSERT(engine.failures() == 0);
+}
+
+void test_command_sameID(void) {
+  MockPort port;
+  Engine engine(port,1000);
+  engine.setHandler(commandHandler);
+  reset();
+
+  int32_t a = engine.setMessageRate(0,41,1);
+  int32_t b = engine.setMessageRate(0,2,0);
+  engine.update(0);
+  CU_ASSERT(port.writes == 1);
+  CU_ASSERT(port.out[6] == 41);
+
+  // the second one goes out after the first is acknowledged
+  engine.acknowledge(sirfAck(GPS::SiRF::SetMessageRateID));
+  CU_ASSERT(g_last == a);
+  engine.update(10);
+  CU_ASSERT(port.writes == 2);
+  engine.acknowledge(sirfAck(GPS::SiRF::SetMessageRateID));
+  CU_ASSERT(g_last == b);
+  CU_ASSERT(g_acknowledged == 2);
+}
+
+void test_command_retry(void) {
+  MockPort port;
+  Engine engine(port,100,1);
+  engine.setHandler(commandHandler);
+  reset();
+
+  engine.setSerialPort(GPS::NMEA::PROTOCOL_SiRF_binary,38400);
+  engine.update(0);
+  engine.update(99);
+  CU_ASSERT(port.writes == 1);
+  engine.update(100);
+  CU_ASSERT(port.writes == 2);
+  CU_ASSERT(g_completed == 0);
+  engine.update(200);
+  CU_ASSERT(port.writes == 2);
+  CU_ASSERT(g_completed == 1 && g_acknowledged == 0);
+  CU_ASSERT(engine.failures() == 1);
+  CU_ASSERT(engine.pending() == 0);
+}
+
+void test_command_pacing(void) {
+  MockPort port;
+  Engine engine(port);
+  engine.setPacing(30);
+  int n = 0;
+  while (engine.queryRateControl(GPS::NMEA::MSG_GGA,GPS::NMEA::SET_RATE,n,1) >= 0)
+    n++;
+  CU_ASSERT(n == COMMAND_ENGINE_SLOTS);
+
+  // one 21 byte sentence per update
+  engine.update(0);
+  CU_ASSERT(port.writes == 1);
+  engine.update(1);
+  CU_ASSERT(port.writes == 1);
+
+  // different IDs share the budget
+  port.clear();
+  Engine engine2(port);
+  engine2.setPacing(30);
+  engine2.setProtocol(GPS::SiRF::Protocol_NMEA);
+  engine2.setMessageRate(0,41,1);
+  engine2.update(0);
+  CU_ASSERT(port.writes == 2);
+}
+
+void init_commandtest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Command", NULL, NULL);
+  CU_add_test(suite, "test_command_pipelined", test_command_pipelined);
+  CU_add_test(suite, "test_command_sameID", test_command_sameID);
+  CU_add_test(suite, "test_command_retry", test_command_retry);
+  CU_add_test(suite, "test_command_pacing", test_command_pacing);
+}
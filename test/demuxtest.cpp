@@ -0,0 +1,146 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+
+#include <string.h>
+
+namespace {
+
+class MixedStream {
+public:
+  MixedStream(const uint8_t *in_data,int in_length)
+    : m_data(in_data),m_length(in_length),m_pos(0) {}
+  int available() const { return m_length - m_pos; }
+  int read() { return m_data[m_pos++]; }
+private:
+  const uint8_t *m_data;
+  int m_length;
+  int m_pos;
+};
+
+typedef GPS::SiRF::PacketParser<MixedStream> SiRFParser;
+typedef GPS::Demux<MixedStream,SiRFParser> MixedDemux;
+
+int g_nmea = 0;
+int g_lastNMEA = 0;
+int g_sirf = 0;
+
+void nmeaHandler(const GPS::NMEA::Message &in_msg) {
+  g_lastNMEA = in_msg.messageID;
+  g_nmea++;
+}
+
+void sirfHandler(const GPS::SiRF::OutputMessage &in_msg) {
+  if (in_msg.messageID == GPS::SiRF::ClockStatusDataID
+      && in_msg.messageBody.clockStatusData.extendedGPSWeek == 2000)
+    g_sirf++;
+}
+
+int append(uint8_t *out,const char *in_text) {
+  int l = strlen(in_text);
+  memcpy(out,in_text,l);
+  return l;
+}
+
+int appendFrame(uint8_t *out,const uint8_t *in_payload,int in_length) {
+  int cs = 0;
+  out[0] = 0xa0;
+  out[1] = 0xa2;
+  out[2] = in_length >> 8;
+  out[3] = in_length & 0xff;
+  memcpy(out + 4,in_payload,in_length);
+  for (int i = 0;i < in_length;i++)
+    cs += in_payload[i];
+  cs &= 0x7fff;
+  out[4 + in_length] = cs >> 8;
+  out[5 + in_length] = cs & 0xff;
+  out[6 + in_length] = 0xb0;
+  out[7 + in_length] = 0xb3;
+  return in_length + 8;
+}
+
+int appendFrame(uint8_t *out) {
+  const uint8_t payload[] = {
+    GPS::SiRF::ClockStatusDataID,
+    0x07,0xd0,0x00,0x01,0x86,0xa0,0x09,
+    0x00,0x01,0x5f,0x90,0x00,0x00,0x00,0x64,0x00,0x00,0x27,0x10
+  };
+  return appendFrame(out,payload,sizeof(payload));
+}
+
+} /* namespace */
+
+void test_demux(void) {
+  uint8_t buf[512];
+  int l = 0;
+  l += append(buf + l,"$GPGGA,002153.000,3342.6618,N,11751.3858,W,1,10,1.2,27.0,M,-34.2,M,,0000*5E\r\n");
+  l += appendFrame(buf + l);
+  buf[l++] = 0xa0;  // lone sync byte
+  l += appendFrame(buf + l);
+  l += append(buf + l,"$GPRMC,161229.487,A,3723.2475,N,12158.3416,W,0.13,309.62,120598,,*10\r\n");
+  l += appendFrame(buf + l);
+
+  MixedStream stream(buf,l);
+  GPS::SiRF::MessageParser sirfParser;
+  SiRFParser packetParser(stream,sirfParser);
+  packetParser.setHandler(sirfHandler);
+  MixedDemux demux(stream,packetParser);
+  GPS::NMEA::Parser<MixedDemux> parser(demux);
+  parser.setHandler(nmeaHandler);
+
+  g_nmea = 0;
+  g_sirf = 0;
+  parser.yyparse();
+  CU_ASSERT(g_nmea == 2);
+  CU_ASSERT(g_lastNMEA == NMEA_GPRMC);
+  CU_ASSERT(g_sirf == 3);
+  CU_ASSERT(demux.binaryBytes() == 3 * 28 + 1);
+  CU_ASSERT(demux.textBytes() + demux.binaryBytes() == (uint32_t)l);
+  CU_ASSERT(!demux.inBinaryFrame());
+}
+
+void test_demux_cutFrame(void) {
+  const char *zda = "$GPZDA,181813,14,10,2003,00,00*4F\r\n";
+  uint8_t buf[1024];
+  int l = 0;
+
+  // a MID 41 frame cut after 10 payload bytes by a port reset
+  uint8_t geodetic[1 + sizeof(GPS::SiRF::GeodeticNavigationData)];
+  memset(geodetic,0x11,sizeof(geodetic));
+  geodetic[0] = GPS::SiRF::GeodeticNavigationDataID;
+  l += appendFrame(buf + l,geodetic,sizeof(geodetic)) - sizeof(geodetic) - 4 + 10;
+  for (int i = 0;i < 5;i++)
+    l += append(buf + l,zda);
+
+  // sentence like bytes inside a complete frame are frame data
+  const uint8_t payload[] = { 0xff,'$','G','P','Z','D','A',0,'$','P','S','R','F','1','0','$','$' };
+  l += appendFrame(buf + l,payload,sizeof(payload));
+  l += appendFrame(buf + l);
+  l += append(buf + l,zda);
+
+  MixedStream stream(buf,l);
+  GPS::SiRF::MessageParser sirfParser;
+  SiRFParser packetParser(stream,sirfParser);
+  packetParser.setHandler(sirfHandler);
+  MixedDemux demux(stream,packetParser);
+  GPS::NMEA::Parser<MixedDemux> parser(demux);
+  parser.setHandler(nmeaHandler);
+
+  g_nmea = 0;
+  g_sirf = 0;
+  parser.yyparse();
+  CU_ASSERT(g_nmea == 6);
+  CU_ASSERT(g_lastNMEA == NMEA_GPZDA);
+  CU_ASSERT(g_sirf == 1);
+  CU_ASSERT(packetParser.frames() == 2);
+  CU_ASSERT(demux.textBytes() == 6 * strlen(zda));
+  CU_ASSERT(demux.textBytes() + demux.binaryBytes() == (uint32_t)l);
+  CU_ASSERT(!demux.inBinaryFrame());
+}
+
+void init_demuxtest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Demux", NULL, NULL);
+  CU_add_test(suite, "test_demux", test_demux);
+  CU_add_test(suite, "test_demux_cutFrame", test_demux_cutFrame);
+}
@@ -0,0 +1,201 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/encoder.h>
+#include "TestInputStream.h"
+
+#include <string.h>
+
+namespace {
+
+  GPS::NMEA::Message g_decoded[8];
+  int g_count = 0;
+
+  void handler(const GPS::NMEA::Message &in_msg) {
+    if (g_count < 8)
+      g_decoded[g_count] = in_msg;
+    g_count++;
+  }
+
+  int parse(const char *in_text) {
+    g_count = 0;
+    TestInputStream stream(in_text);
+    GPS::NMEA::Parser<TestInputStream> parser(stream);
+    parser.setHandler(handler);
+    parser.yyparse();
+    return g_count;
+  }
+
+  //! decode, encode and decode again
+  bool roundTrip(const char *in_sentence) {
+    if (parse(in_sentence) != 1)
+      return false;
+    GPS::NMEA::Message first = g_decoded[0];
+
+    char buf[256];
+    GPS::NMEA::Encoder encoder(buf,sizeof(buf) - 1);
+    if (encoder.encode(first) == 0)
+      return false;
+    buf[encoder.length()] = 0;
+    if (parse(buf) != 1)
+      return false;
+    return memcmp(&first,&g_decoded[0],sizeof(GPS::NMEA::Message)) == 0;
+  }
+
+  //! the widest value of a decimal field
+#ifndef NMEA_USE_FLOAT
+  template<class D>
+  D extreme(bool in_negative) {
+    D d;
+    memset(&d,0xff,sizeof(d));
+    if (in_negative)
+      d.integerPart = 1 << (sizeof(d.integerPart) * 8 - 1);
+    return d;
+  }
+#else
+  template<class D>
+  D extreme(bool in_negative) {
+    return in_negative ? -1e30 : 1e30;
+  }
+#endif
+
+#ifdef NMEA_USE_COORD_E7
+  template<>
+  GPS::NMEA::coordinate_t extreme<GPS::NMEA::coordinate_t>(bool in_negative) {
+    return in_negative ? INT32_MIN : INT32_MAX;
+  }
+#endif
+
+  //! encode into a buffer of exactly NMEA_ENCODER_SENTENCE_SIZE
+  bool fits(const GPS::NMEA::Message &in_msg) {
+    char buf[NMEA_ENCODER_SENTENCE_SIZE + 1];
+    buf[NMEA_ENCODER_SENTENCE_SIZE] = 0x55;
+    GPS::NMEA::Encoder encoder(buf,NMEA_ENCODER_SENTENCE_SIZE);
+    size_t n = encoder.encode(in_msg);
+    if (n == 0 || n != encoder.length() || buf[NMEA_ENCODER_SENTENCE_SIZE] != 0x55)
+      return false;
+
+    // one byte short, through the scratch buffer
+    GPS::NMEA::Encoder small(buf,n - 1);
+    return small.encode(in_msg) == 0 && small.length() == 0 && small.remaining() == n - 1;
+  }
+
+} /* namespace */
+
+void test_encode_GGA(void) {
+  parse("$GPGGA,002153.000,3342.6618,N,11751.3858,W,1,10,1.2,27.0,M,-34.2,M,,0000*5E\r\n");
+  CU_ASSERT_FATAL(g_count == 1);
+  char buf[128];
+  GPS::NMEA::Encoder encoder(buf,sizeof(buf));
+  size_t n = encoder.encode(g_decoded[0]);
+  CU_ASSERT(n == encoder.length());
+  buf[n] = 0;
+#if defined(NMEA_USE_COORD_E7)
+  CU_ASSERT(strcmp(buf,"$GPGGA,002153.000,3342.661800,N,11751.385800,W,1,10,1.20,27.00,M,-34.20,M,,0000*6E\r\n") == 0);
+#elif !defined(NMEA_USE_FLOAT)
+  CU_ASSERT(strcmp(buf,"$GPGGA,002153.000,3342.6618,N,11751.3858,W,1,10,1.20,27.00,M,-34.20,M,,0000*6E\r\n") == 0);
+#endif
+}
+
+void test_encode_roundTrip(void) {
+  CU_ASSERT(roundTrip("$GPGGA,104549.04,2447.2038,N,12100.4990,E,1,06,01.7,00078.8,M,0016.3,M,,*5C\r\n"));
+  CU_ASSERT(roundTrip("$GPGGA,074429.310,,,,,0,00,,,M,0.0,M,,0000*58\r\n"));
+  CU_ASSERT(roundTrip("$GPGSA,A,3,07,02,26,27,09,04,15,,,,,,1.8,1.0,1.5*33\r\n"));
+  CU_ASSERT(roundTrip("$GPGSV,2,1,07,07,79,048,42,02,51,062,43,26,36,256,42,27,27,138,42*71\r\n"));
+  CU_ASSERT(roundTrip("$GPGSV,2,2,07,09,23,313,42,04,19,159,41,15,12,041,42*41\r\n"));
+  CU_ASSERT(roundTrip("$GPRMC,161229.487,A,3723.2475,N,12158.3416,W,0.13,309.62,120598,,*10\r\n"));
+  CU_ASSERT(roundTrip("$GPVTG,309.62,T,,M,0.13,N,0.2,K,A*03\r\n"));
+  CU_ASSERT(roundTrip("$GPZDA,181813,14,10,2003,00,00*4F\r\n"));
+}
+
+void test_encode_batch(void) {
+  parse("$GPZDA,181813,14,10,2003,00,00*4F\r\n");
+  CU_ASSERT_FATAL(g_count == 1);
+  GPS::NMEA::Message zda = g_decoded[0];
+
+  char buf[300];
+  GPS::NMEA::Encoder encoder(buf,sizeof(buf) - 1);
+  size_t n = encoder.encode(zda);
+  CU_ASSERT_FATAL(n > 0);
+  int sentences = 1;
+  while (encoder.encode(zda) > 0)
+    sentences++;
+  // the last ones are written through the scratch buffer
+  CU_ASSERT(sentences == (int)((sizeof(buf) - 1) / n));
+  CU_ASSERT(encoder.remaining() < n);
+  buf[encoder.length()] = 0;
+  CU_ASSERT(parse(buf) == sentences);
+
+  encoder.clear();
+  CU_ASSERT(encoder.length() == 0);
+}
+
+void test_encode_unsupported(void) {
+  GPS::NMEA::Message msg;
+  memset(&msg,0xff,sizeof(msg));
+  msg.messageID = NMEA_GPMSS;
+  char buf[128];
+  GPS::NMEA::Encoder encoder(buf,sizeof(buf));
+  CU_ASSERT(encoder.encode(msg) == 0);
+  CU_ASSERT(encoder.length() == 0);
+}
+
+void test_encode_outOfRange(void) {
+  GPS::NMEA::Message msg;
+  memset(&msg,0xff,sizeof(msg));
+  msg.messageID = NMEA_GPGGA;
+  GPS::NMEA::GGA &gga = msg.gga;
+  gga.utcTime.hour = 23;
+  gga.utcTime.min = 59;
+  gga.utcTime.sec = 59;
+  gga.utcTime.msec = 65534;
+  gga.latitude = extreme<GPS::NMEA::coordinate_t>(true);
+  gga.nsIndicator = 'S';
+  gga.longitude = extreme<GPS::NMEA::coordinate_t>(true);
+  gga.ewIndicator = 'W';
+  gga.positionFixIndicator = -128;
+  gga.satelitesUsed = -128;
+  gga.hdop = extreme<GPS::NMEA::decimal88_t>(true);
+  gga.mslAltitude = extreme<GPS::NMEA::decimal88_t>(true);
+  gga.units = 'M';
+  gga.geoidSeparation = extreme<GPS::NMEA::decimal88_t>(true);
+  gga.units2 = 'M';
+  gga.ageOfDiffCorr = 65534;
+  gga.diffRefStationID = 65534;
+  CU_ASSERT(fits(msg));
+  gga.latitude = extreme<GPS::NMEA::coordinate_t>(false);
+  gga.longitude = extreme<GPS::NMEA::coordinate_t>(false);
+  gga.hdop = extreme<GPS::NMEA::decimal88_t>(false);
+  gga.mslAltitude = extreme<GPS::NMEA::decimal88_t>(false);
+  gga.geoidSeparation = extreme<GPS::NMEA::decimal88_t>(false);
+  CU_ASSERT(fits(msg));
+
+  memset(&msg,0xff,sizeof(msg));
+  msg.messageID = NMEA_GPRMC;
+  GPS::NMEA::RMC &rmc = msg.rmc;
+  rmc.utcTime = gga.utcTime;
+  rmc.status = 'A';
+  rmc.latitude = extreme<GPS::NMEA::coordinate_t>(true);
+  rmc.nsIndicator = 'S';
+  rmc.longitude = extreme<GPS::NMEA::coordinate_t>(true);
+  rmc.ewIndicator = 'W';
+  rmc.speedOverGround = extreme<GPS::NMEA::decimal168_t>(true);
+  rmc.courseOverGround = extreme<GPS::NMEA::decimal168_t>(true);
+  rmc.date.day = 31;
+  rmc.date.mon = 12;
+  rmc.date.year = 99;
+  rmc.magneticVariation = extreme<GPS::NMEA::decimal168_t>(true);
+  rmc.ewIndicator2 = 'W';
+  rmc.mode = 'A';
+  CU_ASSERT(fits(msg));
+}
+
+void init_encodertest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Encoder", NULL, NULL);
+  CU_add_test(suite, "test_encode_GGA", test_encode_GGA);
+  CU_add_test(suite, "test_encode_roundTrip", test_encode_roundTrip);
+  CU_add_test(suite, "test_encode_batch", test_encode_batch);
+  CU_add_test(suite, "test_encode_unsupported", test_encode_unsupported);
+  CU_add_test(suite, "test_encode_outOfRange", test_encode_outOfRange);
+}
@@ -0,0 +1,152 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/engine.h>
+#include <GPS/simulator.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+enum {
+  STREAMS = 3,
+  EPOCHS = 10,
+  MAX_MESSAGES = 128
+};
+
+uint32_t g_expected[MAX_MESSAGES];
+uint32_t g_expectedCount = 0;
+
+void referenceHandler(const GPS::NMEA::Message &in_msg) {
+  if (g_expectedCount < MAX_MESSAGES)
+    g_expected[g_expectedCount++] = GPS::util::fingerprint(&in_msg,sizeof(in_msg));
+}
+
+uint32_t g_received[STREAMS][MAX_MESSAGES];
+uint32_t g_receivedCount[STREAMS];
+
+void streamHandler(uint32_t in_stream,const GPS::NMEA::Message &in_msg) {
+  if (g_receivedCount[in_stream] < MAX_MESSAGES)
+    g_received[in_stream][g_receivedCount[in_stream]++] = GPS::util::fingerprint(&in_msg,sizeof(in_msg));
+}
+
+size_t generate(int in_stream,uint8_t *out_buffer,size_t in_size) {
+  GPS::Simulator sim(in_stream + 1);
+  sim.setMotion(12,30,1);
+  sim.setNoise(2);
+  sim.setErrorRate(0.02);
+  size_t l = 0;
+  for (int i = 0;i < EPOCHS;i++)
+    l += sim.epoch(out_buffer + l,in_size - l);
+  return l;
+}
+
+//! true if a stream yields the messages of an uninterrupted Parser
+bool sameAsParser(int in_stream,const uint8_t *in_data,size_t in_length) {
+  GPS::util::ChunkStream stream;
+  GPS::NMEA::Parser<GPS::util::ChunkStream> parser(stream);
+  parser.setHandler(referenceHandler);
+  g_expectedCount = 0;
+  stream.set(in_data,in_length);
+  parser.yyparse();
+  return g_expectedCount > 0 && g_expectedCount == g_receivedCount[in_stream] &&
+    memcmp(g_expected,g_received[in_stream],g_expectedCount * sizeof(uint32_t)) == 0;
+}
+
+} /* namespace */
+
+void test_engine_interleaved(void) {
+  uint8_t data[STREAMS][SIMULATOR_EPOCH_SIZE * EPOCHS];
+  size_t length[STREAMS];
+  size_t fed[STREAMS];
+  GPS::NMEA::ParserState states[STREAMS];
+  for (int i = 0;i < STREAMS;i++) {
+    length[i] = generate(i,data[i],sizeof(data[i]));
+    fed[i] = 0;
+    g_receivedCount[i] = 0;
+    GPS::NMEA::Engine::reset(&states[i]);
+  }
+
+  // streams move between two engines in chunks of 1 - 40 bytes
+  GPS::NMEA::Engine engines[2];
+  engines[0].setHandler(streamHandler);
+  engines[1].setHandler(streamHandler);
+  uint32_t r = 12345;
+  bool more = true;
+  while (more) {
+    more = false;
+    for (int i = 0;i < STREAMS;i++) {
+      r = r * 1103515245 + 12345;
+      size_t n = (r >> 16) % 40 + 1;
+      if (n > length[i] - fed[i])
+        n = length[i] - fed[i];
+      engines[(r >> 8) & 1].feed(i,&states[i],data[i] + fed[i],n);
+      fed[i] += n;
+      more |= fed[i] < length[i];
+    }
+  }
+
+  for (int i = 0;i < STREAMS;i++) {
+    CU_ASSERT(sameAsParser(i,data[i],length[i]));
+    CU_ASSERT(states[i].messages == g_receivedCount[i]);
+  }
+}
+
+void test_engine_state(void) {
+  // far smaller than a Parser bound to a stream with its own buffers
+  CU_ASSERT(sizeof(GPS::NMEA::ParserState) <= 96);
+
+  const char *zda = "$GPZDA,181813,14,10,2003,00,00*4F\r\n";
+  GPS::NMEA::ParserState a,b;
+  GPS::NMEA::Engine::reset(&a);
+  GPS::NMEA::Engine engine;
+  engine.setHandler(streamHandler);
+  g_receivedCount[0] = 0;
+
+  // a state copied mid-sentence continues on its own
+  engine.feed(0,&a,(const uint8_t *)zda,20);
+  memcpy(&b,&a,sizeof(a));
+  engine.feed(0,&b,(const uint8_t *)zda + 20,strlen(zda) - 20);
+  CU_ASSERT(g_receivedCount[0] == 1);
+  CU_ASSERT(b.messages == 1);
+  CU_ASSERT(a.messages == 0);
+  engine.feed(0,&a,(const uint8_t *)zda + 20,strlen(zda) - 20);
+  CU_ASSERT(g_receivedCount[0] == 2);
+  CU_ASSERT(g_received[0][0] == g_received[0][1]);
+}
+
+void test_engine_noise(void) {
+  const char *vtg = "$GPVTG,221.0,T,224.3,M,016.0,N,0029.6,K,A*1F\r\n";
+  std::string data = vtg;
+  // a field longer than the token buffer, ended by a newline
+  data += "$GPVTG," + std::string(40,'1') + ",T\r\n";
+  for (int i = 0;i < 5;i++)
+    data += vtg;
+  // a cut sentence, ended by the next one
+  data += "$GPVTG,221.0,T," + std::string(40,'2') + vtg;
+
+  GPS::NMEA::ParserState state;
+  GPS::NMEA::Engine engine;
+  engine.setHandler(streamHandler);
+
+  // in one piece and byte by byte
+  for (size_t chunk = data.size();chunk > 0;chunk = chunk > 1 ? 1 : 0) {
+    GPS::NMEA::Engine::reset(&state);
+    g_receivedCount[0] = 0;
+    for (size_t i = 0;i < data.size();i += chunk)
+      engine.feed(0,&state,(const uint8_t *)data.data() + i,std::min(chunk,data.size() - i));
+    CU_ASSERT(g_receivedCount[0] == 7);
+    CU_ASSERT(state.messages == 7);
+  }
+}
+
+void init_enginetest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Engine", NULL, NULL);
+  CU_add_test(suite, "test_engine_interleaved", test_engine_interleaved);
+  CU_add_test(suite, "test_engine_state", test_engine_state);
+  CU_add_test(suite, "test_engine_noise", test_engine_noise);
+}
@@ -0,0 +1,88 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/geodesy.h>
+
+void test_haversine(void) {
+  double lat1[5] = { 0.0, 0.0, 51.5007, 89.0, 10.0 };
+  double lon1[5] = { 0.0, 0.0, -0.1246, 0.0, 179.5 };
+  double lat2[5] = { 0.0, 1.0, 40.6892, 89.0, 10.0 };
+  double lon2[5] = { 1.0, 0.0, -74.0445, 180.0, -179.5 };
+  double d[5];
+  GPS::Geodesy::haversine(lat1,lon1,lat2,lon2,d,5);
+  CU_ASSERT_DOUBLE_EQUAL(d[0],111195.0802335329,1e-6);
+  CU_ASSERT_DOUBLE_EQUAL(d[1],111195.0802335329,1e-6);
+  CU_ASSERT_DOUBLE_EQUAL(d[2],5574848.157146156,1e-6);
+  CU_ASSERT_DOUBLE_EQUAL(d[3],222390.16046706692,1e-6);
+  CU_ASSERT_DOUBLE_EQUAL(d[4],109505.73519924385,1e-6);
+}
+
+void test_equirectangular(void) {
+  double lat1[2] = { 35.0, 10.0 };
+  double lon1[2] = { 139.0, 179.9 };
+  double lat2[2] = { 35.001, 10.0 };
+  double lon2[2] = { 139.001, -179.9 };
+  double d[2],h[2];
+  GPS::Geodesy::equirectangular(lat1,lon1,lat2,lon2,d,2);
+  GPS::Geodesy::haversine(lat1,lon1,lat2,lon2,h,2);
+  CU_ASSERT_DOUBLE_EQUAL(d[0],h[0],1e-3);
+  CU_ASSERT_DOUBLE_EQUAL(d[1],h[1],1e-3);
+}
+
+void test_initialBearing(void) {
+  double lat1[4] = { 0.0, 0.0, 0.0, 0.0 };
+  double lon1[4] = { 0.0, 0.0, 0.0, 0.0 };
+  double lat2[4] = { 1.0, 0.0, -1.0, 0.0 };
+  double lon2[4] = { 0.0, 1.0, 0.0, -1.0 };
+  double b[4];
+  GPS::Geodesy::initialBearing(lat1,lon1,lat2,lon2,b,4);
+  CU_ASSERT_DOUBLE_EQUAL(b[0],0.0,1e-12);
+  CU_ASSERT_DOUBLE_EQUAL(b[1],90.0,1e-12);
+  CU_ASSERT_DOUBLE_EQUAL(b[2],180.0,1e-12);
+  CU_ASSERT_DOUBLE_EQUAL(b[3],270.0,1e-12);
+}
+
+void test_odometer(void) {
+  double lat[4] = { 0.0, 0.0, 0.0, 0.0 };
+  double lon[4] = { 0.0, 1.0, 2.0, 3.0 };
+  double c[4];
+  double total = GPS::Geodesy::odometer(lat,lon,c,4);
+  CU_ASSERT_DOUBLE_EQUAL(total,3 * 111195.0802335329,1e-5);
+  CU_ASSERT(c[0] == 0.0);
+  CU_ASSERT_DOUBLE_EQUAL(c[2],2 * 111195.0802335329,1e-5);
+}
+
+void test_ecef(void) {
+  double lat[3] = { 0.0, 90.0, 35.681236 };
+  double lon[3] = { 0.0, 0.0, 139.767125 };
+  double alt[3] = { 0.0, 0.0, 40.0 };
+  double x[3],y[3],z[3],la[3],lo[3],al[3];
+  GPS::Geodesy::llaToECEF(lat,lon,alt,x,y,z,3);
+  CU_ASSERT_DOUBLE_EQUAL(x[0],6378137.0,1e-6);
+  CU_ASSERT_DOUBLE_EQUAL(y[0],0.0,1e-6);
+  CU_ASSERT_DOUBLE_EQUAL(z[1],6356752.314245179,1e-6);
+  GPS::Geodesy::ecefToLLA(x,y,z,la,lo,al,3);
+  for (int i = 0;i < 3;i++) {
+    CU_ASSERT_DOUBLE_EQUAL(la[i],lat[i],1e-12);
+    CU_ASSERT_DOUBLE_EQUAL(al[i],alt[i],1e-6);
+  }
+  CU_ASSERT_DOUBLE_EQUAL(lo[2],lon[2],1e-12);
+}
+
+void test_toDegrees(void) {
+  GPS::NMEA::decimal1616_t c;
+  c.integerPart = 3342;
+  c.fractionalPart = 6618;
+  CU_ASSERT_DOUBLE_EQUAL(GPS::Geodesy::toDegrees(c),33.71103,1e-12);
+}
+
+void init_geodesytest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Geodesy", NULL, NULL);
+  CU_add_test(suite, "test_haversine", test_haversine);
+  CU_add_test(suite, "test_equirectangular", test_equirectangular);
+  CU_add_test(suite, "test_initialBearing", test_initialBearing);
+  CU_add_test(suite, "test_odometer", test_odometer);
+  CU_add_test(suite, "test_ecef", test_ecef);
+  CU_add_test(suite, "test_toDegrees", test_toDegrees);
+}
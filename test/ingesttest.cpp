@@ -0,0 +1,170 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+
+#ifdef __linux__
+
+#include <GPS/ingest.h>
+#include <GPS/simulator.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace {
+
+enum {
+  STREAMS = 64,
+  EPOCHS = 5
+};
+
+uint32_t g_sentences[STREAMS];
+uint32_t g_outputs[STREAMS];
+int g_closed = -1;
+
+GPS::EpollIngest *g_ingest = NULL;
+
+void nmeaHandler(uint32_t in_stream,const GPS::NMEA::Message &) {
+  g_sentences[in_stream]++;
+}
+
+//! removes its stream from its first sentence
+void removingHandler(uint32_t in_stream,const GPS::NMEA::Message &) {
+  g_sentences[in_stream]++;
+  g_ingest->remove(in_stream);
+}
+
+void sirfHandler(uint32_t in_stream,const GPS::SiRF::OutputMessage &) {
+  g_outputs[in_stream]++;
+}
+
+void closedHandler(uint32_t in_stream) {
+  g_closed = in_stream;
+}
+
+//! in_epochs of simulator output, binary on odd streams
+size_t generate(int in_stream,uint8_t *out_buffer,size_t in_size) {
+  GPS::Simulator sim(in_stream + 1);
+  if (in_stream & 1)
+    sim.setProtocol(GPS::NMEA::PROTOCOL_SiRF_binary);
+  size_t l = 0;
+  for (int i = 0;i < EPOCHS;i++)
+    l += sim.epoch(out_buffer + l,in_size - l);
+  return l;
+}
+
+} /* namespace */
+
+void test_ingest_streams(void) {
+  // small chunks split sentences and frames across reads
+  GPS::EpollIngest ingest(STREAMS,7);
+  CU_ASSERT_FATAL(ingest.valid());
+  memset(g_sentences,0,sizeof(g_sentences));
+  memset(g_outputs,0,sizeof(g_outputs));
+
+  int writers[STREAMS];
+  int readers[STREAMS];
+  size_t lengths[STREAMS];
+  for (int i = 0;i < STREAMS;i++) {
+    int sv[2];
+    CU_ASSERT_FATAL(socketpair(AF_UNIX,SOCK_STREAM,0,sv) == 0);
+    readers[i] = sv[0];
+    writers[i] = sv[1];
+    CU_ASSERT_FATAL(ingest.add(readers[i],nmeaHandler,sirfHandler,&lengths[i]) == i);
+  }
+  CU_ASSERT(ingest.streams() == STREAMS);
+  // nothing readable, the driver sleeps instead of spinning
+  CU_ASSERT(ingest.poll(0) == 0);
+
+  for (int i = 0;i < STREAMS;i++) {
+    uint8_t out[SIMULATOR_EPOCH_SIZE * EPOCHS];
+    lengths[i] = generate(i,out,sizeof(out));
+    CU_ASSERT(write(writers[i],out,lengths[i]) == (ssize_t)lengths[i]);
+  }
+  while (ingest.poll(0) > 0);
+
+  for (int i = 0;i < STREAMS;i++) {
+    const GPS::StreamStats *stats = ingest.stats(i);
+    CU_ASSERT_FATAL(stats != NULL);
+    CU_ASSERT(stats->bytes == lengths[i]);
+    CU_ASSERT(ingest.context(i) == &lengths[i]);
+    if (i & 1) {
+      CU_ASSERT(stats->frames == EPOCHS);
+      CU_ASSERT(g_outputs[i] == EPOCHS);
+      CU_ASSERT(g_sentences[i] == 0);
+    } else {
+      CU_ASSERT(stats->messages == 7 * EPOCHS);
+      CU_ASSERT(g_sentences[i] == 7 * EPOCHS);
+      CU_ASSERT(g_outputs[i] == 0);
+    }
+  }
+
+  for (int i = 0;i < STREAMS;i++) {
+    close(writers[i]);
+    close(readers[i]);
+  }
+}
+
+void test_ingest_close(void) {
+  GPS::EpollIngest ingest(2);
+  ingest.setClosedHandler(closedHandler);
+  int sv[2];
+  CU_ASSERT_FATAL(socketpair(AF_UNIX,SOCK_STREAM,0,sv) == 0);
+  int32_t id = ingest.add(sv[0],nmeaHandler,NULL);
+  CU_ASSERT_FATAL(id >= 0);
+  g_sentences[id] = 0;
+  g_closed = -1;
+
+  const char *zda = "$GPZDA,181813,14,10,2003,00,00*4F\r\n";
+  CU_ASSERT(write(sv[1],zda,strlen(zda)) == (ssize_t)strlen(zda));
+  close(sv[1]);
+  while (ingest.poll(0) > 0);
+  CU_ASSERT(g_sentences[id] == 1);
+  CU_ASSERT(g_closed == id);
+  CU_ASSERT(!ingest.open(id));
+
+  // the ID is kept until remove()
+  CU_ASSERT(ingest.stats(id) != NULL);
+  ingest.remove(id);
+  CU_ASSERT(ingest.stats(id) == NULL);
+  CU_ASSERT(ingest.streams() == 0);
+  close(sv[0]);
+}
+
+void test_ingest_removeFromHandler(void) {
+  GPS::EpollIngest ingest(2);
+  g_ingest = &ingest;
+  int sv[2];
+  CU_ASSERT_FATAL(socketpair(AF_UNIX,SOCK_STREAM,0,sv) == 0);
+  int32_t id = ingest.add(sv[0],removingHandler,NULL);
+  CU_ASSERT_FATAL(id >= 0);
+  g_sentences[id] = 0;
+
+  // both sentences in one chunk, the second is parsed after remove()
+  const char *zda = "$GPZDA,181813,14,10,2003,00,00*4F\r\n$GPZDA,181814,14,10,2003,00,00*48\r\n";
+  CU_ASSERT(write(sv[1],zda,strlen(zda)) == (ssize_t)strlen(zda));
+  CU_ASSERT(ingest.poll(0) == 1);
+  CU_ASSERT(g_sentences[id] == 1);
+  CU_ASSERT(ingest.streams() == 0);
+  CU_ASSERT(ingest.stats(id) == NULL);
+  CU_ASSERT(!ingest.open(id));
+
+  // no longer polled, and the ID is free again
+  CU_ASSERT(write(sv[1],zda,strlen(zda)) == (ssize_t)strlen(zda));
+  CU_ASSERT(ingest.poll(0) == 0);
+  CU_ASSERT(ingest.add(sv[0],nmeaHandler,NULL) == id);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+#endif /* __linux__ */
+
+void init_ingesttest(void) {
+#ifdef __linux__
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Ingest", NULL, NULL);
+  CU_add_test(suite, "test_ingest_streams", test_ingest_streams);
+  CU_add_test(suite, "test_ingest_close", test_ingest_close);
+  CU_add_test(suite, "test_ingest_removeFromHandler", test_ingest_removeFromHandler);
+#endif
+}
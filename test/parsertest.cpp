@@ -241,6 +241,11 @@ void test_parse_RMC_4(void) {
   parser.yyparse();
   CU_ASSERT_FATAL(g_msg != NULL);
   CU_ASSERT(g_msg->messageID == NMEA_GPRMC);
+  CU_ASSERT(g_msg->rmc.latitude.integerPart == 2447);
+  CU_ASSERT(g_msg->rmc.latitude.fractionalPart == 2038);
+  CU_ASSERT(g_msg->rmc.nsIndicator == 'N');
+  CU_ASSERT(g_msg->rmc.longitude.integerPart == 12100);
+  CU_ASSERT(g_msg->rmc.longitude.fractionalPart == 4990);
 }
 
 void test_parse_VTG(void) {
@@ -404,6 +409,61 @@ void test_parse_stream2(void) {
   CU_ASSERT(g_msg->messageID == NMEA_GPGSA);
 }
 
+static int g_count = 0;
+
+static
+void countingHandler(const GPS::NMEA::Message &) {
+  g_count++;
+}
+
+void test_parse_changeFilter(void) {
+  g_count = 0;
+  TestInputStream stream(
+    "$GPGSA,M,1,,,,,,,,,,,,,,,*12\r\n"
+    "$GPGSA,M,1,,,,,,,,,,,,,,,*12\r\n"
+    "$GPGSA,A,3,07,02,26,27,09,04,15,,,,,,1.8,1.0,1.5*33\r\n"
+    "$GPGSV,2,1,07,07,79,048,42,02,51,062,43,26,36,256,42,27,27,138,42*71\r\n"
+    "$GPGSV,2,2,07,09,23,313,42,04,19,159,41,15,12,041,42*41\r\n"
+    "$GPGSV,2,1,07,07,79,048,42,02,51,062,43,26,36,256,42,27,27,138,42*71\r\n"
+    "$GPGSV,2,2,07,09,23,313,42,04,19,159,41,15,12,041,42*41\r\n"
+  );
+  GPS::NMEA::ChangeFilter filter;
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.setHandler(countingHandler);
+  parser.setFilter(&filter);
+  parser.yyparse();
+  CU_ASSERT(g_count == 4);
+  CU_ASSERT(filter.suppressed(NMEA_GPGSA) == 1);
+  CU_ASSERT(filter.suppressed(NMEA_GPGSV) == 2);
+}
+
+void test_parse_changeFilter_2(void) {
+  g_count = 0;
+  TestInputStream stream(
+    "$GPGSA,M,1,,,,,,,,,,,,,,,*12\r\n"
+    "$GPGSA,M,1,,,,,,,,,,,,,,,*12\r\n"
+    "$GPGSA,M,1,,,,,,,,,,,,,,,*12\r\n"
+    "$GPGSA,M,1,,,,,,,,,,,,,,,*12\r\n"
+  );
+  GPS::NMEA::ChangeFilter filter;
+  filter.setMaxSuppressed(1);
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.setHandler(countingHandler);
+  parser.setFilter(&filter);
+  parser.yyparse();
+  CU_ASSERT(g_count == 2);
+  CU_ASSERT(filter.suppressed(NMEA_GPGSA) == 2);
+}
+
+void test_parse_noise(void) {
+  g_msg = NULL;
+  TestInputStream stream("\xff\x80\xc3\r\n$GPZDA,181813,14,10,2003,00,00*4F\r\n");
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.setHandler(handler);
+  parser.yyparse();
+  CU_ASSERT_FATAL(g_msg != NULL);
+  CU_ASSERT(g_msg->messageID == NMEA_GPZDA);
+}
 
 void init_parsertest(void) {
   CU_pSuite suite;
@@ -441,4 +501,7 @@ void init_parsertest(void) {
   CU_add_test(suite, "test_parse_154", test_parse_154);
   CU_add_test(suite, "test_parse_stream", test_parse_stream);
   CU_add_test(suite, "test_parse_stream2", test_parse_stream2);
+  CU_add_test(suite, "test_parse_changeFilter", test_parse_changeFilter);
+  CU_add_test(suite, "test_parse_changeFilter_2", test_parse_changeFilter_2);
+  CU_add_test(suite, "test_parse_noise", test_parse_noise);
 }
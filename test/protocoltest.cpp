@@ -0,0 +1,313 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/simulator.h>
+
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <stdlib.h>
+#include "PtyPort.h"
+#endif
+
+namespace {
+
+class MockPort {
+public:
+  MockPort() : baud(9600),inLength(0),inPos(0),outLength(0) {}
+  void begin(long in_baud) { baud = in_baud; }
+  void flush() {}
+  int available() const { return inLength - inPos; }
+  int read() { return in[inPos++]; }
+  void write(uint8_t c) {
+    outBaud[outLength] = baud;
+    out[outLength++] = c;
+  }
+  void write(const uint8_t *in_data,int in_length) {
+    for (int i = 0;i < in_length;i++)
+      write(in_data[i]);
+  }
+  void write(const char *in_data,int in_length) {
+    write((const uint8_t *)in_data,in_length);
+  }
+  void receive(const void *in_data,int in_length) {
+    memcpy(in + inLength,in_data,in_length);
+    inLength += in_length;
+  }
+
+  long baud;
+  uint8_t in[1024];
+  int inLength;
+  int inPos;
+  uint8_t out[256];
+  long outBaud[256];  //!< baud rate each byte was sent at
+  int outLength;
+};
+
+typedef GPS::ProtocolSwitch<MockPort> Switch;
+
+int g_switches = 0;
+bool g_confirmed = false;
+
+void switchHandler(GPS::NMEA::ProtocolType,bool in_confirmed) {
+  g_switches++;
+  g_confirmed = in_confirmed;
+}
+
+int clockStatusFrame(uint8_t *out) {
+  const uint8_t payload[] = {
+    GPS::SiRF::ClockStatusDataID,
+    0x07,0xd0,0x00,0x01,0x86,0xa0,0x09,
+    0x00,0x01,0x5f,0x90,0x00,0x00,0x00,0x64,0x00,0x00,0x27,0x10
+  };
+  int cs = 0;
+  out[0] = 0xa0;
+  out[1] = 0xa2;
+  out[2] = 0;
+  out[3] = sizeof(payload);
+  memcpy(out + 4,payload,sizeof(payload));
+  for (size_t i = 0;i < sizeof(payload);i++)
+    cs += payload[i];
+  out[4 + sizeof(payload)] = cs >> 8;
+  out[5 + sizeof(payload)] = cs & 0xff;
+  out[6 + sizeof(payload)] = 0xb0;
+  out[7 + sizeof(payload)] = 0xb3;
+  return sizeof(payload) + 8;
+}
+
+} /* namespace */
+
+void test_protocolSwitch(void) {
+  MockPort port;
+  GPS::NMEA::Parser<MockPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<MockPort> sirf(port,messageParser);
+  Switch sw(port,nmea,sirf,9600,1000);
+  sw.setHandler(switchHandler);
+  g_switches = 0;
+
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_NMEA);
+  CU_ASSERT(sw.switchToBinary(38400,0));
+  CU_ASSERT(!sw.switchToBinary(38400,0));
+  CU_ASSERT(sw.switching());
+  CU_ASSERT(port.baud == 38400);
+  port.out[port.outLength] = 0;
+  CU_ASSERT(strncmp((const char *)port.out,"$PSRF100,0,38400,8,1,0*",23) == 0);
+
+  // text still in flight, then binary
+  const char *tail = "$GPGGA,002153.000,3342.6618,N,11751.3858,W,1,10,1.2,27.0,M,-34.2,M,,0000*5E\r\n";
+  port.receive(tail,strlen(tail));
+  sw.update(10);
+  CU_ASSERT(sw.switching());
+  uint8_t frame[64];
+  port.receive(frame,clockStatusFrame(frame));
+  sw.update(20);
+  CU_ASSERT(!sw.switching());
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary);
+  CU_ASSERT(sw.baud() == 38400);
+  CU_ASSERT(g_switches == 1 && g_confirmed);
+
+  // back to NMEA
+  port.outLength = 0;
+  CU_ASSERT(sw.switchToNMEA(30));
+  CU_ASSERT(port.outLength == 10 && port.out[4] == GPS::SiRF::SetProtocolID && port.out[5] == GPS::SiRF::Protocol_NMEA);
+  port.receive(tail,strlen(tail));
+  sw.update(40);
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_NMEA);
+  CU_ASSERT(!sw.switching());
+  CU_ASSERT(g_switches == 2 && g_confirmed);
+  CU_ASSERT(sw.failures() == 0);
+}
+
+void test_protocolSwitch_timeout(void) {
+  MockPort port;
+  GPS::NMEA::Parser<MockPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<MockPort> sirf(port,messageParser);
+  Switch sw(port,nmea,sirf,9600,1000);
+  sw.setHandler(switchHandler);
+  g_switches = 0;
+
+  // timestamps wrap around
+  CU_ASSERT(sw.switchToBinary(115200,0xfffffe00UL));
+  sw.update(0xffffff00UL);
+  CU_ASSERT(sw.switching());
+  sw.update(0x00000100UL);
+  CU_ASSERT(sw.switching());
+  sw.update(0x00000200UL);
+  CU_ASSERT(!sw.switching());
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_NMEA);
+  CU_ASSERT(port.baud == 9600);
+  CU_ASSERT(sw.baud() == 9600);
+  CU_ASSERT(sw.failures() == 1);
+  CU_ASSERT(g_switches == 1 && !g_confirmed);
+}
+
+void test_protocolSwitch_lostFrame(void) {
+  MockPort port;
+  GPS::NMEA::Parser<MockPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<MockPort> sirf(port,messageParser);
+  Switch sw(port,nmea,sirf,9600,1000);
+  sw.setHandler(switchHandler);
+  g_switches = 0;
+
+  // the receiver switches, but its first frame is cut short
+  CU_ASSERT(sw.switchToBinary(38400,0));
+  uint8_t frame[64];
+  port.receive(frame,clockStatusFrame(frame) - 5);
+  port.outLength = 0;
+  sw.update(500);
+  CU_ASSERT(sw.switching());
+  sw.update(1000);
+  CU_ASSERT(!sw.switching());
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_NMEA);
+  CU_ASSERT(g_switches == 1 && !g_confirmed);
+
+  // back to 9600 in binary at 38400, then NMEA at 9600
+  CU_ASSERT_FATAL(port.outLength == 17 + 10);
+  CU_ASSERT(port.out[4] == GPS::SiRF::SetBinarySerialPortID);
+  CU_ASSERT(GPS::util::readBE32(port.out + 5) == 9600);
+  CU_ASSERT(port.outBaud[0] == 38400 && port.outBaud[16] == 38400);
+  CU_ASSERT(port.out[17 + 4] == GPS::SiRF::SetProtocolID && port.out[17 + 5] == GPS::SiRF::Protocol_NMEA);
+  CU_ASSERT(port.outBaud[17] == 9600 && port.outBaud[17 + 9] == 9600);
+  CU_ASSERT(port.baud == 9600);
+
+  // and NMEA is heard again
+  const char *gga = "$GPGGA,002153.000,3342.6618,N,11751.3858,W,1,10,1.2,27.0,M,-34.2,M,,0000*5E\r\n";
+  port.receive(gga,strlen(gga));
+  uint32_t messages = nmea.messages();
+  sw.update(1100);
+  CU_ASSERT(nmea.messages() == messages + 1);
+}
+
+void test_protocolSwitch_lostNMEA(void) {
+  MockPort port;
+  GPS::NMEA::Parser<MockPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<MockPort> sirf(port,messageParser);
+  Switch sw(port,nmea,sirf,9600,1000);
+  sw.setHandler(switchHandler);
+  g_switches = 0;
+
+  uint8_t frame[64];
+  CU_ASSERT(sw.switchToBinary(9600,0));
+  port.receive(frame,clockStatusFrame(frame));
+  sw.update(10);
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary && !sw.switching());
+
+  // the receiver switches, but its first sentence is lost
+  CU_ASSERT(sw.switchToNMEA(100));
+  port.outLength = 0;
+  sw.update(600);
+  CU_ASSERT(sw.switching());
+  sw.update(1100);
+  CU_ASSERT(!sw.switching());
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary);
+  CU_ASSERT(g_switches == 2 && !g_confirmed);
+  CU_ASSERT(sw.failures() == 1);
+
+  // asked for binary at the same rate
+  port.out[port.outLength] = 0;
+  CU_ASSERT(strncmp((const char *)port.out,"$PSRF100,0,9600,8,1,0*",22) == 0);
+  CU_ASSERT(port.baud == 9600);
+
+  // and binary is heard again
+  uint32_t frames = sirf.frames();
+  port.receive(frame,clockStatusFrame(frame));
+  sw.update(1200);
+  CU_ASSERT(sirf.frames() == frames + 1);
+}
+
+#ifdef __linux__
+
+namespace {
+
+/**
+  Receiver side of a pseudo terminal
+  @param in_drop true to lose the output of this epoch
+*/
+void serviceSimulator(int in_master,GPS::Simulator &io_receiver,bool in_drop) {
+  uint8_t buf[SIMULATOR_EPOCH_SIZE];
+  int n;
+  while ((n = ::read(in_master,buf,sizeof(buf))) > 0)
+    io_receiver.receive(buf,n);
+  n = io_receiver.epoch(buf,sizeof(buf));
+  if (!in_drop)
+    CU_ASSERT(::write(in_master,buf,n) == n);
+}
+
+} /* namespace */
+
+void test_protocolSwitch_pty(void) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  CU_ASSERT_FATAL(master >= 0);
+  CU_ASSERT_FATAL(grantpt(master) == 0 && unlockpt(master) == 0);
+  int slave = open(ptsname(master),O_RDWR | O_NOCTTY | O_NONBLOCK);
+  CU_ASSERT_FATAL(slave >= 0);
+  fcntl(master,F_SETFL,fcntl(master,F_GETFL) | O_NONBLOCK);
+
+  GPS::Simulator receiver;
+  PtyPort port(slave);
+  port.begin(4800);
+  GPS::NMEA::Parser<PtyPort> nmea(port);
+  GPS::SiRF::MessageParser messageParser;
+  GPS::SiRF::PacketParser<PtyPort> sirf(port,messageParser);
+  GPS::ProtocolSwitch<PtyPort> sw(port,nmea,sirf,4800,3000);
+  sw.setHandler(switchHandler);
+  g_switches = 0;
+
+  uint32_t t = 0;
+  CU_ASSERT(sw.switchToBinary(4800,t));
+  for (;t < 10000 && sw.switching();t += 1000) {
+    serviceSimulator(master,receiver,false);
+    sw.update(t);
+  }
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary && g_confirmed);
+  CU_ASSERT(receiver.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary);
+
+  // every sentence is lost until the switch times out
+  CU_ASSERT(sw.switchToNMEA(t));
+  for (;t < 20000 && sw.switching();t += 1000) {
+    serviceSimulator(master,receiver,true);
+    sw.update(t);
+  }
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary && !g_confirmed);
+  CU_ASSERT(sw.failures() == 1);
+
+  // the receiver follows the host back to binary
+  uint32_t frames = sirf.frames();
+  for (int i = 0;i < 3;i++,t += 1000) {
+    serviceSimulator(master,receiver,false);
+    sw.update(t);
+  }
+  CU_ASSERT(receiver.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary);
+  CU_ASSERT(sirf.frames() > frames);
+
+  // and a switch which is heard succeeds
+  CU_ASSERT(sw.switchToNMEA(t));
+  for (;t < 40000 && sw.switching();t += 1000) {
+    serviceSimulator(master,receiver,false);
+    sw.update(t);
+  }
+  CU_ASSERT(sw.protocol() == GPS::NMEA::PROTOCOL_NMEA && g_confirmed);
+  CU_ASSERT(g_switches == 3);
+
+  close(slave);
+  close(master);
+}
+
+#endif /* __linux__ */
+
+void init_protocoltest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("ProtocolSwitch", NULL, NULL);
+  CU_add_test(suite, "test_protocolSwitch", test_protocolSwitch);
+  CU_add_test(suite, "test_protocolSwitch_timeout", test_protocolSwitch_timeout);
+  CU_add_test(suite, "test_protocolSwitch_lostFrame", test_protocolSwitch_lostFrame);
+  CU_add_test(suite, "test_protocolSwitch_lostNMEA", test_protocolSwitch_lostNMEA);
+#ifdef __linux__
+  CU_add_test(suite, "test_protocolSwitch_pty", test_protocolSwitch_pty);
+#endif
+}
@@ -0,0 +1,231 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/rate.h>
+
+#include <string.h>
+
+namespace {
+
+class MockPort {
+public:
+  MockPort() : outLength(0) {}
+  void write(const uint8_t *in_data,int in_length) {
+    memcpy(out + outLength,in_data,in_length);
+    outLength += in_length;
+  }
+  const char *string() {
+    out[outLength] = 0;
+    outLength = 0;
+    return (const char *)out;
+  }
+
+  uint8_t out[256];
+  int outLength;
+};
+
+typedef GPS::CommandEngine<MockPort> Engine;
+typedef GPS::RateController<MockPort> Controller;
+
+int g_gsv = 0;
+Controller *g_controller = NULL;
+
+void gsvHandler(const GPS::NMEA::Message &) {
+  g_gsv++;
+}
+
+void commandHandler(uint16_t in_command,bool in_acknowledged) {
+  g_controller->completed(in_command,in_acknowledged);
+}
+
+GPS::NMEA::Message nmeaAck() {
+  GPS::NMEA::Message msg;
+  memset(&msg,0xff,sizeof(msg));
+  msg.messageID = NMEA_PSRF154;
+  msg.eeAck.ackID = 103;
+  return msg;
+}
+
+GPS::SiRF::OutputMessage sirfAck() {
+  GPS::SiRF::OutputMessage msg;
+  msg.messageID = GPS::SiRF::CommandAcknowledgmentID;
+  msg.messageBody.commandAcknowledgment.ackID = GPS::SiRF::SetMessageRateID;
+  return msg;
+}
+
+//! send and acknowledge every rate change
+void settle(Controller &io_rc,Engine &io_engine) {
+  while (io_rc.update(0) || io_engine.pending()) {
+    io_engine.update(0);
+    io_engine.acknowledge(nmeaAck());
+  }
+}
+
+} /* namespace */
+
+void test_rate_disable(void) {
+  MockPort port;
+  Engine engine(port);
+  Controller rc(engine);
+  g_controller = &rc;
+  engine.setHandler(commandHandler);
+  rc.manage(GPS::NMEA::MSG_GSV);
+  rc.manage(GPS::NMEA::MSG_VTG);
+
+  // one command per update
+  CU_ASSERT(rc.update(0));
+  engine.update(0);
+  CU_ASSERT(strcmp(port.string(),"$PSRF103,3,0,0,1*27\r\n") == 0);
+  CU_ASSERT(rc.update(0));
+  engine.update(10);
+  CU_ASSERT(port.outLength == 0);
+  CU_ASSERT(!rc.update(0));
+
+  // the second one waits for the first acknowledgement
+  CU_ASSERT(engine.acknowledge(nmeaAck()));
+  engine.update(20);
+  CU_ASSERT(strcmp(port.string(),"$PSRF103,5,0,0,1*21\r\n") == 0);
+  CU_ASSERT(!rc.update(0));
+  CU_ASSERT(engine.acknowledge(nmeaAck()));
+  CU_ASSERT(!rc.update(0));
+  CU_ASSERT(engine.pending() == 0);
+}
+
+void test_rate_unacknowledged(void) {
+  MockPort port;
+  Engine engine(port,100,0);
+  Controller rc(engine);
+  g_controller = &rc;
+  engine.setHandler(commandHandler);
+  rc.manage(GPS::NMEA::MSG_GSV);
+
+  CU_ASSERT(rc.update(0));
+  engine.update(0);
+  CU_ASSERT(strcmp(port.string(),"$PSRF103,3,0,0,1*27\r\n") == 0);
+  CU_ASSERT(!rc.update(0));
+
+  // not applied, so it is queued again after a while
+  engine.update(100);
+  CU_ASSERT(engine.failures() == 1);
+  CU_ASSERT(!rc.update(100));
+  CU_ASSERT(rc.update(RATE_CONTROLLER_BACKOFF_MS));
+  engine.update(RATE_CONTROLLER_BACKOFF_MS);
+  CU_ASSERT(strcmp(port.string(),"$PSRF103,3,0,0,1*27\r\n") == 0);
+  CU_ASSERT(engine.acknowledge(nmeaAck()));
+  CU_ASSERT(!rc.update(RATE_CONTROLLER_BACKOFF_MS));
+
+  // completions of other commands are not ours
+  CU_ASSERT(!rc.completed(engine.setProtocol(GPS::SiRF::Protocol_NMEA),true));
+}
+
+void test_rate_subscribe(void) {
+  MockPort port;
+  Engine engine(port);
+  Controller rc(engine);
+  g_controller = &rc;
+  engine.setHandler(commandHandler);
+  rc.manage(GPS::NMEA::MSG_GSV);
+  settle(rc,engine);
+  port.string();
+
+  int8_t a = rc.subscribe(GPS::NMEA::MSG_GSV,5);
+  int8_t b = rc.subscribe(GPS::NMEA::MSG_GSV,2,gsvHandler);
+  CU_ASSERT(a >= 0 && b >= 0);
+  CU_ASSERT(rc.rateOf(GPS::NMEA::MSG_GSV) == 2);
+  CU_ASSERT(rc.update(0));
+  engine.update(0);
+  CU_ASSERT(strcmp(port.string(),"$PSRF103,3,0,2,1*25\r\n") == 0);
+  engine.acknowledge(nmeaAck());
+
+  GPS::NMEA::Message msg;
+  memset(&msg,0xff,sizeof(msg));
+  msg.messageID = NMEA_GPGSV;
+  g_gsv = 0;
+  rc.dispatch(msg);
+  msg.messageID = NMEA_GPGGA;
+  rc.dispatch(msg);
+  CU_ASSERT(g_gsv == 1);
+
+  rc.unsubscribe(b);
+  CU_ASSERT(rc.update(0));
+  engine.update(0);
+  CU_ASSERT(strcmp(port.string(),"$PSRF103,3,0,5,1*22\r\n") == 0);
+  engine.acknowledge(nmeaAck());
+  rc.unsubscribe(a);
+  CU_ASSERT(rc.update(0));
+  CU_ASSERT(rc.rateOf(GPS::NMEA::MSG_GSV) == 0);
+  settle(rc,engine);
+  CU_ASSERT(!rc.update(0));
+}
+
+void test_rate_binary(void) {
+  MockPort port;
+  Engine engine(port);
+  Controller rc(engine,GPS::NMEA::PROTOCOL_SiRF_binary);
+  g_controller = &rc;
+  engine.setHandler(commandHandler);
+  rc.manage(GPS::SiRF::MeasuredTrackerDataOutID);
+  rc.subscribe(GPS::SiRF::MeasuredTrackerDataOutID,1);
+  CU_ASSERT(rc.update(0));
+  engine.update(0);
+  CU_ASSERT(port.out[0] == 0xa0 && port.out[1] == 0xa2);
+  CU_ASSERT(port.out[4] == GPS::SiRF::SetMessageRateID);
+  CU_ASSERT(port.out[6] == GPS::SiRF::MeasuredTrackerDataOutID);
+  CU_ASSERT(port.out[7] == 1);
+  port.outLength = 0;
+  CU_ASSERT(engine.acknowledge(sirfAck()));
+  CU_ASSERT(!rc.update(0));
+
+  // a protocol switch sends every rate again
+  rc.setProtocol(GPS::NMEA::PROTOCOL_SiRF_binary);
+  CU_ASSERT(rc.update(0));
+  engine.update(10);
+  CU_ASSERT(engine.acknowledge(sirfAck()));
+  CU_ASSERT(!rc.update(0));
+}
+
+void test_rate_giveUp(void) {
+  MockPort port;
+  Engine engine(port,100,0);
+  Controller rc(engine);
+  g_controller = &rc;
+  engine.setHandler(commandHandler);
+  rc.manage(GPS::NMEA::MSG_GSV);
+  rc.manage(GPS::NMEA::MSG_VTG);
+
+  // the port never acknowledges
+  uint32_t sent[RATE_CONTROLLER_ATTEMPTS + 1];
+  int gsv = 0;
+  for (uint32_t t = 0;t < 120000;t += 100) {
+    rc.update(t);
+    engine.update(t);
+    if (port.outLength > 0 && strncmp(port.string(),"$PSRF103,3,",11) == 0 && gsv <= RATE_CONTROLLER_ATTEMPTS)
+      sent[gsv++] = t;
+  }
+  CU_ASSERT_FATAL(gsv == RATE_CONTROLLER_ATTEMPTS);
+  for (int i = 2;i < gsv;i++) {
+    CU_ASSERT(sent[i] - sent[i - 1] > 2 * (sent[i - 1] - sent[i - 2]) - 200);
+  }
+  CU_ASSERT(!rc.managed(GPS::NMEA::MSG_GSV));
+  CU_ASSERT(!rc.managed(GPS::NMEA::MSG_VTG));
+  CU_ASSERT(!rc.update(120000));
+
+  // until it is managed again
+  CU_ASSERT(rc.manage(GPS::NMEA::MSG_GSV));
+  CU_ASSERT(rc.update(120000));
+  engine.update(120000);
+  CU_ASSERT(strcmp(port.string(),"$PSRF103,3,0,0,1*27\r\n") == 0);
+  CU_ASSERT(engine.acknowledge(nmeaAck()));
+  CU_ASSERT(!rc.update(120000));
+  CU_ASSERT(rc.managed(GPS::NMEA::MSG_GSV));
+}
+
+void init_ratetest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Rate", NULL, NULL);
+  CU_add_test(suite, "test_rate_disable", test_rate_disable);
+  CU_add_test(suite, "test_rate_unacknowledged", test_rate_unacknowledged);
+  CU_add_test(suite, "test_rate_subscribe", test_rate_subscribe);
+  CU_add_test(suite, "test_rate_binary", test_rate_binary);
+  CU_add_test(suite, "test_rate_giveUp", test_rate_giveUp);
+}
@@ -0,0 +1,190 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/scheduler.h>
+#include <GPS/simulator.h>
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum {
+  STREAMS = 16,
+  WORKERS = 4,
+  EPOCHS = 40,
+  BURST = 20,
+  MAX_MESSAGES = 8192
+};
+
+std::vector<uint32_t> g_received[STREAMS];
+std::atomic<int> g_inside[STREAMS];
+std::atomic<int> g_overlaps(0);
+std::set<std::thread::id> g_burstWorkers;  //!< threads which parsed stream 0
+std::atomic<uint32_t> g_burstMessages(0);
+std::atomic<bool> g_hold[STREAMS];      //!< the stream's handler waits while set
+std::atomic<bool> g_held[STREAMS];      //!< and it is waiting
+
+//! poll in_done for up to 5 seconds
+template<class F>
+bool waitFor(F in_done) {
+  for (int i = 0;i < 5000 && !in_done();i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return in_done();
+}
+
+void streamHandler(uint32_t in_stream,const GPS::NMEA::Message &in_msg) {
+  if (g_inside[in_stream]++ != 0)
+    g_overlaps++;
+  g_received[in_stream].push_back(GPS::util::fingerprint(&in_msg,sizeof(in_msg)));
+  if (in_stream == 0) {
+    g_burstWorkers.insert(std::this_thread::get_id());
+    g_burstMessages++;
+  }
+  g_inside[in_stream]--;
+
+  // keep this worker busy
+  if (g_hold[in_stream]) {
+    g_held[in_stream] = true;
+    waitFor([in_stream]() { return !g_hold[in_stream]; });
+    g_held[in_stream] = false;
+  }
+}
+
+std::vector<uint32_t> g_expected;
+
+void referenceHandler(const GPS::NMEA::Message &in_msg) {
+  g_expected.push_back(GPS::util::fingerprint(&in_msg,sizeof(in_msg)));
+}
+
+} /* namespace */
+
+void test_scheduler_order(void) {
+  // stream 0 bursts with BURST times the output of the others
+  std::vector<uint8_t> data[STREAMS];
+  for (int i = 0;i < STREAMS;i++) {
+    GPS::Simulator sim(i + 1);
+    sim.setMotion(8,i * 20,0.5);
+    sim.setErrorRate(0.01);
+    uint8_t out[SIMULATOR_EPOCH_SIZE];
+    for (int e = 0;e < (i == 0 ? EPOCHS * BURST : EPOCHS);e++) {
+      size_t l = sim.epoch(out,sizeof(out));
+      data[i].insert(data[i].end(),out,out + l);
+    }
+    g_received[i].clear();
+    g_inside[i] = 0;
+    g_hold[i] = false;
+    g_held[i] = false;
+  }
+  g_overlaps = 0;
+  g_burstWorkers.clear();
+  g_burstMessages = 0;
+
+  GPS::Scheduler scheduler(STREAMS,WORKERS);
+  scheduler.setHandler(streamHandler);
+  scheduler.start();
+
+  // hold all workers but one in handlers of other streams and feed
+  // stream 0 twice, so it is parsed on two workers and stolen once
+  size_t fed[STREAMS] = { 0 };
+  for (int i = 1;i <= WORKERS;i++) {
+    if (i < WORKERS)
+      g_hold[i] = true;
+    fed[i] = 200;
+  }
+  for (int i = 1;i < WORKERS;i++)
+    CU_ASSERT(scheduler.submit(i,&data[i][0],fed[i]));
+  CU_ASSERT(waitFor([]() {
+    for (int i = 1;i < WORKERS;i++) {
+      if (!g_held[i])
+        return false;
+    }
+    return true;
+  }));
+  fed[0] = 4096;
+  CU_ASSERT(scheduler.submit(0,&data[0][0],fed[0]));
+  CU_ASSERT(waitFor([]() { return g_burstMessages > 0; }));
+
+  // the worker of stream 0 is held next, and the one of stream 1 let go
+  g_hold[WORKERS] = true;
+  CU_ASSERT(scheduler.submit(WORKERS,&data[WORKERS][0],fed[WORKERS]));
+  CU_ASSERT(waitFor([]() { return (bool)g_held[WORKERS]; }));
+  uint32_t first = g_burstMessages;
+  g_hold[1] = false;
+  CU_ASSERT(scheduler.submit(0,&data[0][fed[0]],4096));
+  fed[0] += 4096;
+  CU_ASSERT(waitFor([first]() { return g_burstMessages > first; }));
+  for (int i = 1;i <= WORKERS;i++)
+    g_hold[i] = false;
+
+  bool more = true;
+  while (more) {
+    more = false;
+    for (int i = 0;i < STREAMS;i++) {
+      size_t n = i == 0 ? 4096 : 200;
+      if (n > data[i].size() - fed[i])
+        n = data[i].size() - fed[i];
+      if (n > 0)
+        CU_ASSERT(scheduler.submit(i,&data[i][fed[i]],n));
+      fed[i] += n;
+      more |= fed[i] < data[i].size();
+    }
+  }
+  scheduler.wait();
+  scheduler.stop();
+
+  CU_ASSERT(g_overlaps == 0);
+  for (int i = 0;i < STREAMS;i++) {
+    GPS::util::ChunkStream stream;
+    GPS::NMEA::Parser<GPS::util::ChunkStream> parser(stream);
+    parser.setHandler(referenceHandler);
+    g_expected.clear();
+    stream.set(&data[i][0],data[i].size());
+    parser.yyparse();
+    CU_ASSERT(!g_expected.empty() && g_received[i] == g_expected);
+    CU_ASSERT(scheduler.state(i).messages == g_expected.size());
+  }
+
+  uint64_t bytes = 0,tasks = 0,steals = 0;
+  size_t total = 0;
+  for (int i = 0;i < STREAMS;i++)
+    total += data[i].size();
+  for (unsigned w = 0;w < scheduler.workers();w++) {
+    GPS::WorkerStats s = scheduler.stats(w);
+    bytes += s.bytes;
+    tasks += s.tasks;
+    steals += s.steals;
+    CU_ASSERT(scheduler.utilisation(w) >= 0 && scheduler.utilisation(w) <= 1);
+  }
+  CU_ASSERT(bytes == total);
+  CU_ASSERT(tasks >= STREAMS);
+  CU_ASSERT(steals > 0);
+  CU_ASSERT(g_burstWorkers.size() > 1);
+}
+
+void test_scheduler_backpressure(void) {
+  GPS::Scheduler scheduler(1,1);
+  // not started, nothing is consumed
+  static uint8_t chunk[SCHEDULER_MAX_PENDING / 2];
+  memset(chunk,'x',sizeof(chunk));
+  CU_ASSERT(scheduler.submit(0,chunk,sizeof(chunk)));
+  CU_ASSERT(scheduler.submit(0,chunk,sizeof(chunk)));
+  CU_ASSERT(!scheduler.submit(0,chunk,1));
+  CU_ASSERT(!scheduler.submit(1,chunk,1));
+  scheduler.start();
+  scheduler.wait();
+  CU_ASSERT(scheduler.stats(0).bytes == 2 * sizeof(chunk));
+  CU_ASSERT(scheduler.submit(0,chunk,1));
+  scheduler.wait();
+}
+
+void init_schedulertest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Scheduler", NULL, NULL);
+  CU_add_test(suite, "test_scheduler_order", test_scheduler_order);
+  CU_add_test(suite, "test_scheduler_backpressure", test_scheduler_backpressure);
+}
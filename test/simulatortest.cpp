@@ -0,0 +1,188 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include <GPS/simulator.h>
+
+#include <string.h>
+#include <math.h>
+
+namespace {
+
+typedef GPS::NMEA::Parser<GPS::SimulatorPort> NMEAParser;
+typedef GPS::SiRF::PacketParser<GPS::SimulatorPort> SiRFParser;
+
+int g_count[NMEA_PSRF155 + 1];
+GPS::NMEA::Message g_gga;
+GPS::NMEA::Message g_zda;
+
+void nmeaHandler(const GPS::NMEA::Message &in_msg) {
+  g_count[in_msg.messageID]++;
+  if (in_msg.messageID == NMEA_GPGGA)
+    g_gga = in_msg;
+  else
+  if (in_msg.messageID == NMEA_GPZDA)
+    g_zda = in_msg;
+}
+
+int g_nav = 0;
+int g_ack = -1;
+GPS::SiRF::GeodeticNavigationData g_data;
+
+void sirfHandler(const GPS::SiRF::OutputMessage &in_msg) {
+  if (in_msg.messageID == GPS::SiRF::GeodeticNavigationDataID) {
+    g_nav++;
+    g_data = in_msg.messageBody.geodeticNavigationData;
+  } else
+  if (in_msg.messageID == GPS::SiRF::CommandAcknowledgmentID) {
+    g_ack = in_msg.messageBody.commandAcknowledgment.ackID;
+  }
+}
+
+#ifdef NMEA_USE_COORD_E7
+double degrees(GPS::NMEA::coordinate_t in_c) {
+  return in_c / 1e7;
+}
+#else
+double degrees(GPS::NMEA::coordinate_t in_c) {
+# ifndef NMEA_USE_FLOAT
+  double v = in_c.integerPart + in_c.fractionalPart / 10000.0;
+# else
+  double v = in_c;
+# endif
+  int d = (int)(v / 100);
+  return d + (v - d * 100) / 60;
+}
+#endif
+
+} /* namespace */
+
+void test_simulator_nmea(void) {
+  GPS::Simulator sim;
+  sim.setMotion(10,90);
+  GPS::SimulatorPort port(sim);
+  NMEAParser parser(port);
+  parser.setHandler(nmeaHandler);
+  memset(g_count,0,sizeof(g_count));
+
+  for (int i = 0;i < 3;i++) {
+    port.step();
+    parser.yyparse();
+  }
+  CU_ASSERT(g_count[NMEA_GPGGA] == 3);
+  CU_ASSERT(g_count[NMEA_GPGSA] == 3);
+  CU_ASSERT(g_count[NMEA_GPGSV] == 6);
+  CU_ASSERT(g_count[NMEA_GPRMC] == 3);
+  CU_ASSERT(g_count[NMEA_GPVTG] == 3);
+  CU_ASSERT(g_count[NMEA_GPZDA] == 3);
+  CU_ASSERT(parser.messages() == 21);
+
+  CU_ASSERT(fabs(degrees(g_gga.gga.latitude) - sim.latitude()) < 1e-5);
+  CU_ASSERT(fabs(degrees(g_gga.gga.longitude) - sim.longitude()) < 1e-5);
+  CU_ASSERT(sim.longitude() > 139.7671);
+  CU_ASSERT(g_gga.gga.nsIndicator == 'N' && g_gga.gga.ewIndicator == 'E');
+  CU_ASSERT(g_zda.zda.year == 2020 && g_zda.zda.month == 1 && g_zda.zda.day == 1);
+  CU_ASSERT(g_zda.zda.utcTime.sec == 2);
+  CU_ASSERT(GPS::util::epochNanos(g_zda.zda) == sim.time());
+}
+
+void test_simulator_rate(void) {
+  GPS::Simulator sim;
+  GPS::SimulatorPort port(sim);
+  NMEAParser parser(port);
+  parser.setHandler(nmeaHandler);
+  GPS::NMEA::CommandBuilder<GPS::SimulatorPort> builder(port);
+  memset(g_count,0,sizeof(g_count));
+
+  builder.QueryRateControl(GPS::NMEA::MSG_GSV,GPS::NMEA::SET_RATE,0,1);
+  builder.QueryRateControl(GPS::NMEA::MSG_GGA,GPS::NMEA::SET_RATE,2,1);
+  for (int i = 0;i < 4;i++) {
+    port.step();
+    parser.yyparse();
+  }
+  CU_ASSERT(g_count[NMEA_GPGSV] == 0);
+  CU_ASSERT(g_count[NMEA_GPGGA] == 2);
+  CU_ASSERT(g_count[NMEA_GPRMC] == 4);
+
+  // a query is answered once
+  builder.QueryRateControl(GPS::NMEA::MSG_GSV,GPS::NMEA::QUERY,0,1);
+  port.step();
+  port.step();
+  parser.yyparse();
+  CU_ASSERT(g_count[NMEA_GPGSV] == 2);
+}
+
+void test_simulator_binary(void) {
+  GPS::Simulator sim;
+  GPS::SimulatorPort port(sim);
+  GPS::SiRF::MessageParser messageParser;
+  SiRFParser sirf(port,messageParser);
+  sirf.setHandler(sirfHandler);
+  GPS::NMEA::CommandBuilder<GPS::SimulatorPort> nmeaBuilder(port);
+  GPS::SiRF::CommandBuilder<GPS::SimulatorPort> sirfBuilder(port);
+  g_nav = 0;
+  g_ack = -1;
+
+  nmeaBuilder.SetSerialPort(GPS::NMEA::PROTOCOL_SiRF_binary,4800);
+  CU_ASSERT(sim.protocol() == GPS::NMEA::PROTOCOL_SiRF_binary);
+  port.step();
+  port.step();
+  sirf.polling();
+  CU_ASSERT(g_nav == 2);
+  CU_ASSERT(GPS::util::epochNanos(g_data) == sim.time());
+  CU_ASSERT(abs(g_data.latitude - (int32_t)(sim.latitude() * 1e7)) <= 1);
+  CU_ASSERT(g_data.numberOfSVsInFix == SIMULATOR_SATELLITES);
+
+  sirfBuilder.SetMessageRate(0,GPS::SiRF::GeodeticNavigationDataID,0);
+  port.step();
+  sirf.polling();
+  CU_ASSERT(g_nav == 2);
+  CU_ASSERT(g_ack == GPS::SiRF::SetMessageRateID);
+
+  // back to NMEA, acknowledged in binary first
+  sirfBuilder.SetProtocol(GPS::SiRF::Protocol_NMEA);
+  CU_ASSERT(sim.protocol() == GPS::NMEA::PROTOCOL_NMEA);
+  port.step();
+  sirf.polling();
+  CU_ASSERT(g_ack == GPS::SiRF::SetProtocolID);
+}
+
+void test_simulator_baud(void) {
+  GPS::Simulator sim;
+  GPS::SimulatorPort port(sim);
+  NMEAParser parser(port);
+  GPS::NMEA::CommandBuilder<GPS::SimulatorPort> builder(port);
+
+  builder.SetSerialPort(GPS::NMEA::PROTOCOL_NMEA,9600);
+  CU_ASSERT(sim.baud() == 9600);
+  port.step();
+  parser.yyparse();
+  CU_ASSERT(parser.messages() == 0);
+
+  port.begin(9600);
+  port.step();
+  parser.yyparse();
+  // the first sentence may be lost while the parser resynchronizes
+  CU_ASSERT(parser.messages() >= 6);
+}
+
+void test_simulator_errors(void) {
+  GPS::Simulator sim(7);
+  sim.setErrorRate(0.5);
+  GPS::SimulatorPort port(sim);
+  NMEAParser parser(port);
+  for (int i = 0;i < 20;i++) {
+    port.step();
+    parser.yyparse();
+  }
+  CU_ASSERT(parser.messages() > 20 && parser.messages() < 120);
+}
+
+void init_simulatortest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Simulator", NULL, NULL);
+  CU_add_test(suite, "test_simulator_nmea", test_simulator_nmea);
+  CU_add_test(suite, "test_simulator_rate", test_simulator_rate);
+  CU_add_test(suite, "test_simulator_binary", test_simulator_binary);
+  CU_add_test(suite, "test_simulator_baud", test_simulator_baud);
+  CU_add_test(suite, "test_simulator_errors", test_simulator_errors);
+}
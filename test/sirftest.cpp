@@ -0,0 +1,607 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+
+#include <string.h>
+
+class ByteStream {
+public:
+  ByteStream(const uint8_t *in_data,int in_length)
+    : m_data(in_data),m_length(in_length),m_pos(0) {}
+  int available() const { return m_length - m_pos; }
+  int read() { return m_data[m_pos++]; }
+private:
+  const uint8_t *m_data;
+  int m_length;
+  int m_pos;
+};
+
+static int g_count = 0;
+static GPS::SiRF::GeodeticNavigationData g_nav;
+
+static
+void handler(const GPS::SiRF::OutputMessage &in_msg) {
+  if (in_msg.messageID == GPS::SiRF::GeodeticNavigationDataID) {
+    g_nav = in_msg.messageBody.geodeticNavigationData;
+    g_count++;
+  }
+}
+
+static
+int frame(uint8_t *out,const uint8_t *in_payload,int in_length) {
+  int cs = 0;
+  out[0] = 0xa0;
+  out[1] = 0xa2;
+  out[2] = in_length >> 8;
+  out[3] = in_length & 0xff;
+  memcpy(out + 4,in_payload,in_length);
+  for (int i = 0;i < in_length;i++)
+    cs += in_payload[i];
+  cs &= 0x7fff;
+  out[4 + in_length] = cs >> 8;
+  out[5 + in_length] = cs & 0xff;
+  out[6 + in_length] = 0xb0;
+  out[7 + in_length] = 0xb3;
+  return in_length + 8;
+}
+
+static
+int geodeticFrame(uint8_t *out) {
+  uint8_t payload[sizeof(GPS::SiRF::GeodeticNavigationData) + 1];
+  memset(payload,0,sizeof(payload));
+  payload[0] = GPS::SiRF::GeodeticNavigationDataID;
+  payload[5] = 0x07;  // extendedWeekNumber = 0x07d0 (2000)
+  payload[6] = 0xd0;
+  payload[7] = 0x01;  // TOW = 0x01020304
+  payload[8] = 0x02;
+  payload[9] = 0x03;
+  payload[10] = 0x04;
+  payload[23] = 0x16; // latitude = 0x16b5a5c4 (381003204)
+  payload[24] = 0xb5;
+  payload[25] = 0xa5;
+  payload[26] = 0xc4;
+  payload[27] = 0xb6; // longitude = 0xb6b6b6b6
+  payload[28] = 0xb6;
+  payload[29] = 0xb6;
+  payload[30] = 0xb6;
+  return frame(out,payload,sizeof(payload));
+}
+
+static
+void checkNav(void) {
+  CU_ASSERT(g_nav.extendedWeekNumber == 2000);
+  CU_ASSERT(g_nav.TOW == 0x01020304);
+  CU_ASSERT(g_nav.latitude == 381003204);
+  CU_ASSERT(g_nav.longitude == (int32_t)0xb6b6b6b6);
+}
+
+void test_sirf_feed(void) {
+  uint8_t buf[512];
+  int l = 0;
+  buf[l++] = 0x00;
+  buf[l++] = 0xa0;  // stray start byte
+  l += geodeticFrame(buf + l);
+  buf[l++] = 0xa0;
+  buf[l++] = 0xa2;
+  l += geodeticFrame(buf + l);
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(handler);
+
+  g_count = 0;
+  packetParser.feed(buf,l);
+  CU_ASSERT(g_count == 2);
+  checkNav();
+}
+
+void test_sirf_feed_split(void) {
+  uint8_t buf[512];
+  int l = geodeticFrame(buf);
+  l += geodeticFrame(buf + l);
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(handler);
+
+  for (int split = 1;split < l;split++) {
+    g_count = 0;
+    memset(&g_nav,0,sizeof(g_nav));
+    packetParser.feed(buf,split);
+    packetParser.feed(buf + split,l - split);
+    CU_ASSERT(g_count == 2);
+    checkNav();
+  }
+}
+
+void test_sirf_feed_bad_checksum(void) {
+  uint8_t buf[512];
+  int l = geodeticFrame(buf);
+  buf[l - 3] ^= 1;
+  int l2 = geodeticFrame(buf + l);
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(handler);
+
+  g_count = 0;
+  packetParser.feed(buf,l + l2);
+  CU_ASSERT(g_count == 1);
+  checkNav();
+}
+
+void test_sirf_polling(void) {
+  uint8_t buf[512];
+  int l = geodeticFrame(buf);
+  l += geodeticFrame(buf + l);
+  l += geodeticFrame(buf + l);
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,l);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(handler);
+
+  g_count = 0;
+  packetParser.polling();
+  CU_ASSERT(g_count == 3);
+  checkNav();
+}
+
+static GPS::SiRF::OutputMessage g_out;
+
+static
+void outputHandler(const GPS::SiRF::OutputMessage &in_msg) {
+  g_out = in_msg;
+  g_count++;
+}
+
+void test_sirf_clockStatus(void) {
+  const uint8_t payload[] = {
+    GPS::SiRF::ClockStatusDataID,
+    0x07,0xd0,                // extendedGPSWeek
+    0x00,0x01,0x86,0xa0,      // GPSTOW
+    0x09,                     // SVs
+    0x00,0x01,0x5f,0x90,      // clockDrift
+    0x00,0x00,0x00,0x64,      // clockBias
+    0x00,0x00,0x27,0x10       // estimatedGPSTime
+  };
+  uint8_t buf[64];
+  int l = frame(buf,payload,sizeof(payload));
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,l);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(outputHandler);
+
+  g_count = 0;
+  packetParser.polling();
+  CU_ASSERT_FATAL(g_count == 1);
+  CU_ASSERT(g_out.messageID == GPS::SiRF::ClockStatusDataID);
+  CU_ASSERT(g_out.messageBody.clockStatusData.extendedGPSWeek == 2000);
+  CU_ASSERT(g_out.messageBody.clockStatusData.GPSTOW == 100000);
+  CU_ASSERT(g_out.messageBody.clockStatusData.SVs == 9);
+  CU_ASSERT(g_out.messageBody.clockStatusData.clockDrift == 90000);
+  CU_ASSERT(g_out.messageBody.clockStatusData.clockBias == 100);
+  CU_ASSERT(g_out.messageBody.clockStatusData.estimatedGPSTime == 10000);
+}
+
+void test_sirf_trackerData(void) {
+  uint8_t payload[sizeof(GPS::SiRF::MeasuredTrackerDataOut) + 1];
+  memset(payload,0,sizeof(payload));
+  payload[0] = GPS::SiRF::MeasuredTrackerDataOutID;
+  payload[1] = 0x07;
+  payload[2] = 0xd0;
+  payload[7] = 12;
+  for (int i = 0;i < 12;i++) {
+    uint8_t *ch = payload + 8 + i * 15;
+    ch[0] = i + 1;
+    ch[3] = 0x01;     // state = 0x01bf
+    ch[4] = 0xbf;
+    ch[5] = 40 + i;
+  }
+  uint8_t buf[256];
+  int l = frame(buf,payload,sizeof(payload));
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(outputHandler);
+
+  // once in bulk, once through the per byte state machine
+  for (int split = 0;split < 2;split++) {
+    g_count = 0;
+    packetParser.feed(buf,split ? 10 : l);
+    packetParser.feed(buf + (split ? 10 : l),split ? l - 10 : 0);
+    CU_ASSERT_FATAL(g_count == 1);
+    const GPS::SiRF::MeasuredTrackerDataOut &t = g_out.messageBody.measuredTrackerDataOut;
+    CU_ASSERT(t.GPSWeek == 2000);
+    CU_ASSERT(t.chans == 12);
+    CU_ASSERT(t.channels[0].SVid == 1);
+    CU_ASSERT(t.channels[11].SVid == 12);
+    CU_ASSERT(t.channels[11].state == 0x01bf);
+    CU_ASSERT(t.channels[11].CN0[0] == 51);
+  }
+}
+
+void test_sirf_visibleList(void) {
+  const uint8_t payload[] = {
+    GPS::SiRF::VisibleListID,
+    2,
+    5,0x00,0x5a,0xff,0xfb,    // SV 5, azimuth 90, elevation -5
+    17,0x01,0x0e,0x00,0x2d    // SV 17, azimuth 270, elevation 45
+  };
+  uint8_t buf[64];
+  int l = frame(buf,payload,sizeof(payload));
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(outputHandler);
+
+  for (int split = 0;split < 2;split++) {
+    g_count = 0;
+    packetParser.feed(buf,split ? 3 : l);
+    packetParser.feed(buf + (split ? 3 : l),split ? l - 3 : 0);
+    CU_ASSERT_FATAL(g_count == 1);
+    const GPS::SiRF::VisibleList &v = g_out.messageBody.visibleList;
+    CU_ASSERT(v.visibleSVs == 2);
+    CU_ASSERT(v.SVs[0].SVid == 5);
+    CU_ASSERT(v.SVs[0].azimuth == 90);
+    CU_ASSERT(v.SVs[0].elevation == -5);
+    CU_ASSERT(v.SVs[1].SVid == 17);
+    CU_ASSERT(v.SVs[1].azimuth == 270);
+    CU_ASSERT(v.SVs[1].elevation == 45);
+    CU_ASSERT(v.SVs[2].SVid == 0xff);
+  }
+}
+
+void test_sirf_unknown(void) {
+  const uint8_t payload[] = { 0xff,0x01,0x02 };
+  uint8_t buf[64];
+  int l = frame(buf,payload,sizeof(payload));
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,l);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(outputHandler);
+
+  g_count = 0;
+  packetParser.polling();
+  CU_ASSERT(g_count == 0);
+}
+
+static int32_t g_viewLatitude;
+static uint32_t g_viewTOW;
+
+static
+void viewHandler(const GPS::SiRF::PayloadView &in_view) {
+  GPS::SiRF::GeodeticNavigationDataView nav(in_view);
+  if (nav.valid()) {
+    g_viewLatitude = nav.latitude();
+    g_viewTOW = nav.TOW();
+    g_count++;
+  }
+}
+
+void test_sirf_view(void) {
+  uint8_t buf[256];
+  uint8_t reassembly[128];
+  int l = geodeticFrame(buf);
+  l += geodeticFrame(buf + l);
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+
+  // in place only, the split frame is dropped
+  packetParser.setViewHandler(viewHandler);
+  g_count = 0;
+  packetParser.feed(buf,l - 20);
+  packetParser.feed(buf + l - 20,20);
+  CU_ASSERT(g_count == 1);
+  CU_ASSERT(g_viewLatitude == 381003204);
+  CU_ASSERT(g_viewTOW == 0x01020304);
+
+  packetParser.setPayloadBuffer(reassembly,sizeof(reassembly));
+  g_count = 0;
+  g_viewLatitude = 0;
+  packetParser.feed(buf,l - 20);
+  packetParser.feed(buf + l - 20,20);
+  CU_ASSERT(g_count == 2);
+  CU_ASSERT(g_viewLatitude == 381003204);
+}
+
+void test_sirf_deferred(void) {
+  uint8_t buf[256];
+  uint8_t payloadBuffer[128];
+  int l = geodeticFrame(buf);
+  buf[l - 3] ^= 1;
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(handler);
+
+  // decoded while it arrives
+  g_count = 0;
+  packetParser.feed(buf,10);
+  packetParser.feed(buf + 10,l - 10);
+  CU_ASSERT(g_count == 0);
+  CU_ASSERT(parser.lastMessage().messageID == GPS::SiRF::GeodeticNavigationDataID);
+
+  // checked first, never decoded
+  parser.reset();
+  packetParser.setPayloadBuffer(payloadBuffer,sizeof(payloadBuffer));
+  packetParser.feed(buf,10);
+  packetParser.feed(buf + 10,l - 10);
+  CU_ASSERT(g_count == 0);
+  CU_ASSERT(parser.lastMessage().messageID == 0);
+
+  buf[l - 3] ^= 1;
+  for (int i = 0;i < l;i++) {
+    packetParser.feed(buf + i,1);
+  }
+  CU_ASSERT(g_count == 1);
+  checkNav();
+}
+
+void test_byteSum(void) {
+  uint8_t buf[300];
+  uint32_t sum = 0;
+  for (int i = 0;i < 300;i++) {
+    buf[i] = (i * 37) ^ 0xa5;
+  }
+  for (int l = 0;l < 300;l++) {
+    CU_ASSERT(GPS::util::byteSum(buf,l) == sum);
+    sum += buf[l];
+  }
+}
+
+void test_sirf_resync(void) {
+  uint8_t buf[512];
+  int l = 0;
+  buf[l++] = 0x55;
+  buf[l++] = 0xa0;  // false start, the length covers the next frame's header
+  buf[l++] = 0xa2;
+  buf[l++] = 0x00;
+  buf[l++] = 0x06;
+  buf[l++] = 0x01;
+  buf[l++] = 0x02;
+  l += geodeticFrame(buf + l);
+  uint32_t garbage = 7;
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+  packetParser.setHandler(handler);
+
+  // whole buffer
+  g_count = 0;
+  packetParser.feed(buf,l);
+  int count = g_count;
+  uint32_t resyncs = packetParser.resyncs();
+  uint32_t discarded = packetParser.discardedBytes();
+#if SIRF_RESYNC_WINDOW >= 12
+  // the false start is rejected at its 12th byte
+  CU_ASSERT(g_count == 1);
+  CU_ASSERT(packetParser.resyncs() == 1);
+  CU_ASSERT(packetParser.discardedBytes() == garbage);
+#endif
+
+  // byte by byte through the state machine
+  for (int deferred = 0;deferred < 2;deferred++) {
+    uint8_t payloadBuffer[128];
+    if (deferred)
+      packetParser.setPayloadBuffer(payloadBuffer,sizeof(payloadBuffer));
+    packetParser.resetCounters();
+    g_count = 0;
+    memset(&g_nav,0,sizeof(g_nav));
+    for (int i = 0;i < l;i++) {
+      packetParser.feed(buf + i,1);
+    }
+    CU_ASSERT(g_count == count);
+    CU_ASSERT(packetParser.resyncs() == resyncs);
+    CU_ASSERT(packetParser.discardedBytes() == discarded);
+#if SIRF_RESYNC_WINDOW >= 12
+    checkNav();
+#endif
+  }
+}
+
+static uint32_t g_events[64];
+static int g_eventCount;
+
+static
+void logHandler(const GPS::SiRF::OutputMessage &in_msg) {
+  const GPS::SiRF::MessageLayout *layout = GPS::SiRF::findMessageLayout(in_msg.messageID);
+  if (g_eventCount < 64)
+    g_events[g_eventCount++] = GPS::util::fingerprint(&in_msg,layout->length + 1);
+}
+
+static
+int trackerFrame(uint8_t *out,int in_seed) {
+  uint8_t payload[sizeof(GPS::SiRF::MeasuredTrackerDataOut) + 1];
+  for (size_t i = 0;i < sizeof(payload);i++)
+    payload[i] = (uint8_t)(i * 13 + in_seed);
+  payload[0] = GPS::SiRF::MeasuredTrackerDataOutID;
+  // a false start inside the payload
+  payload[40] = 0xa0;
+  payload[41] = 0xa2;
+  payload[42] = 0x00;
+  payload[43] = 0x20;
+  return frame(out,payload,sizeof(payload));
+}
+
+void test_sirf_chunking(void) {
+  // MID 4 frames, cut short or with a bad checksum, each followed by a
+  // good one which is only found by rescanning the rejected bytes
+  uint8_t buf[4096];
+  int l = 0,good = 0;
+  for (int i = 0;i < 6;i++) {
+    l += trackerFrame(buf + l,i);
+    good++;
+    int n = trackerFrame(buf + l,i + 100);
+    if (i & 1)
+      buf[l + n - 3] ^= 0x01;   // checksum
+    else
+      n = 60 + i * 20;          // truncated
+    l += n;
+    l += trackerFrame(buf + l,i + 200);
+    good++;
+    l += geodeticFrame(buf + l);
+    good++;
+  }
+
+  static const int chunks[] = { 0,1,7,64 };
+  uint32_t expected[64];
+  int expectedCount = 0;
+  uint32_t frames = 0,resyncs = 0,discarded = 0;
+  for (int deferred = 0;deferred < 2;deferred++) {
+    for (size_t c = 0;c < sizeof(chunks) / sizeof(chunks[0]);c++) {
+      GPS::SiRF::MessageParser parser;
+      ByteStream stream(buf,0);
+      GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+      packetParser.setHandler(logHandler);
+      uint8_t payloadBuffer[256];
+      if (deferred)
+        packetParser.setPayloadBuffer(payloadBuffer,sizeof(payloadBuffer));
+      g_eventCount = 0;
+      int chunk = chunks[c] ? chunks[c] : l;
+      for (int i = 0;i < l;i += chunk)
+        packetParser.feed(buf + i,i + chunk <= l ? chunk : l - i);
+      if (deferred == 0 && c == 0) {
+        memcpy(expected,g_events,sizeof(expected));
+        expectedCount = g_eventCount;
+        frames = packetParser.frames();
+        resyncs = packetParser.resyncs();
+        discarded = packetParser.discardedBytes();
+#if SIRF_RESYNC_WINDOW >= 204
+        CU_ASSERT(frames == (uint32_t)good);
+#endif
+        continue;
+      }
+      CU_ASSERT(g_eventCount == expectedCount);
+      CU_ASSERT(memcmp(g_events,expected,expectedCount * sizeof(uint32_t)) == 0);
+      CU_ASSERT(packetParser.frames() == frames);
+      CU_ASSERT(packetParser.resyncs() == resyncs);
+      CU_ASSERT(packetParser.discardedBytes() == discarded);
+    }
+  }
+}
+
+static uint8_t g_raw[512];
+static int g_rawLength;
+
+static
+void rawHandler(const uint8_t *in_frame,uint16_t in_length) {
+  memcpy(g_raw,in_frame,in_length);
+  g_rawLength = in_length;
+  g_count++;
+}
+
+void test_sirf_raw(void) {
+  uint8_t payload[300];
+  uint8_t buf[1024];
+  uint8_t rawBuffer[400];
+  for (int i = 0;i < (int)sizeof(payload);i++)
+    payload[i] = i * 7;
+  payload[0] = 14;  // Almanac Data, not decoded
+  int l1 = frame(buf,payload,sizeof(payload));
+  int l = l1 + geodeticFrame(buf + l1);
+
+  GPS::SiRF::MessageParser parser;
+  ByteStream stream(buf,0);
+  GPS::SiRF::PacketParser<ByteStream> packetParser(stream,parser);
+
+  // in place
+  packetParser.setRawHandler(rawHandler);
+  g_count = 0;
+  packetParser.feed(buf,l);
+  CU_ASSERT(g_count == 1);
+  CU_ASSERT(g_rawLength == l1);
+  CU_ASSERT(memcmp(g_raw,buf,l1) == 0);
+
+  // split, without and with a buffer
+  g_count = 0;
+  packetParser.feed(buf,100);
+  packetParser.feed(buf + 100,l - 100);
+  CU_ASSERT(g_count == 0);
+
+  packetParser.setRawHandler(rawHandler,rawBuffer,sizeof(rawBuffer));
+  g_rawLength = 0;
+  for (int i = 0;i < l;i++) {
+    packetParser.feed(buf + i,1);
+  }
+  CU_ASSERT(g_count == 1);
+  CU_ASSERT(g_rawLength == l1);
+  CU_ASSERT(memcmp(g_raw,buf,l1) == 0);
+
+  // every message ID
+  packetParser.setRawHandler(rawHandler,rawBuffer,sizeof(rawBuffer),true);
+  g_count = 0;
+  packetParser.feed(buf,100);
+  packetParser.feed(buf + 100,l - 100);
+  CU_ASSERT(g_count == 2);
+  CU_ASSERT(g_rawLength == l - l1);
+  CU_ASSERT(memcmp(g_raw,buf + l1,l - l1) == 0);
+
+  // payload copied in runs by the deferred path
+  uint8_t payloadBuffer[400];
+  packetParser.setPayloadBuffer(payloadBuffer,sizeof(payloadBuffer));
+  packetParser.setRawHandler(rawHandler,rawBuffer,sizeof(rawBuffer));
+  g_count = 0;
+  packetParser.feed(buf,5);
+  packetParser.feed(buf + 5,l - 5);
+  CU_ASSERT(g_count == 1);
+  CU_ASSERT(g_rawLength == l1);
+  CU_ASSERT(memcmp(g_raw,buf,l1) == 0);
+}
+
+class CaptureStream {
+public:
+  CaptureStream() : length(0) {}
+  void write(uint8_t c) { data[length++] = c; }
+  void write(const uint8_t *in_data,int in_length) {
+    memcpy(data + length,in_data,in_length);
+    length += in_length;
+  }
+  uint8_t data[64];
+  int length;
+};
+
+void test_sirf_commandBuilder(void) {
+  const uint8_t expected[] = {
+    0xa0,0xa2,0x00,0x09,
+    0x86,0x00,0x01,0xc2,0x00,0x08,0x01,0x00,0x00,
+    0x01,0x52,
+    0xb0,0xb3
+  };
+  CaptureStream stream;
+  GPS::SiRF::CommandBuilder<CaptureStream> builder(stream);
+  builder.SetBinarySerialPort(115200);
+  CU_ASSERT(stream.length == sizeof(expected));
+  CU_ASSERT(memcmp(stream.data,expected,sizeof(expected)) == 0);
+}
+
+void init_sirftest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("SiRF", NULL, NULL);
+  CU_add_test(suite, "test_sirf_feed", test_sirf_feed);
+  CU_add_test(suite, "test_sirf_feed_split", test_sirf_feed_split);
+  CU_add_test(suite, "test_sirf_feed_bad_checksum", test_sirf_feed_bad_checksum);
+  CU_add_test(suite, "test_sirf_polling", test_sirf_polling);
+  CU_add_test(suite, "test_sirf_clockStatus", test_sirf_clockStatus);
+  CU_add_test(suite, "test_sirf_trackerData", test_sirf_trackerData);
+  CU_add_test(suite, "test_sirf_visibleList", test_sirf_visibleList);
+  CU_add_test(suite, "test_sirf_unknown", test_sirf_unknown);
+  CU_add_test(suite, "test_sirf_commandBuilder", test_sirf_commandBuilder);
+  CU_add_test(suite, "test_sirf_view", test_sirf_view);
+  CU_add_test(suite, "test_sirf_deferred", test_sirf_deferred);
+  CU_add_test(suite, "test_byteSum", test_byteSum);
+  CU_add_test(suite, "test_sirf_resync", test_sirf_resync);
+  CU_add_test(suite, "test_sirf_chunking", test_sirf_chunking);
+  CU_add_test(suite, "test_sirf_raw", test_sirf_raw);
+}
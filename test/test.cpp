@@ -4,6 +4,20 @@
 void init_lexertest(void);
 void init_parsertest(void);
 void init_utiltest(void);
+void init_timetest(void);
+void init_geodesytest(void);
+void init_sirftest(void);
+void init_demuxtest(void);
+void init_protocoltest(void);
+void init_encodertest(void);
+void init_commandtest(void);
+void init_ratetest(void);
+void init_baudtest(void);
+void init_simulatortest(void);
+void init_ingesttest(void);
+void init_enginetest(void);
+void init_schedulertest(void);
+void init_checkpointtest(void);
 
 int main(int argc,char **argv) {
   CU_initialize_registry();
@@ -11,6 +25,20 @@ int main(int argc,char **argv) {
   init_lexertest();
   init_parsertest();
   init_utiltest();
+  init_timetest();
+  init_geodesytest();
+  init_sirftest();
+  init_demuxtest();
+  init_protocoltest();
+  init_encodertest();
+  init_commandtest();
+  init_ratetest();
+  init_baudtest();
+  init_simulatortest();
+  init_ingesttest();
+  init_enginetest();
+  init_schedulertest();
+  init_checkpointtest();
 
   CU_basic_run_tests();
   CU_cleanup_registry();
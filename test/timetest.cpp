@@ -0,0 +1,118 @@
+#include <CUnit/CUnit.h>
+#include <GPS.h>
+#include "TestInputStream.h"
+
+static GPS::NMEA::Message g_message;
+
+static
+void handler(const GPS::NMEA::Message &in_msg) {
+  g_message = in_msg;
+}
+
+void test_daysFromCivil(void) {
+  CU_ASSERT(GPS::util::daysFromCivil(1970,1,1) == 0);
+  CU_ASSERT(GPS::util::daysFromCivil(1980,1,6) == 3657);
+  CU_ASSERT(GPS::util::daysFromCivil(2000,2,29) == 11016);
+  CU_ASSERT(GPS::util::daysFromCivil(2000,3,1) == 11017);
+  CU_ASSERT(GPS::util::daysFromCivil(1969,12,31) == -1);
+
+  // usable as a constant expression
+  enum { GPS_EPOCH_DAYS = GPS::util::daysFromCivil(1980,1,6) };
+  CU_ASSERT(GPS_EPOCH_DAYS * 86400L == GPS_EPOCH_UNIX);
+  enum { LEAP_SECONDS = GPS::util::leapSecondCount };
+  CU_ASSERT(LEAP_SECONDS == 18);
+}
+
+void test_epochNanos_RMC(void) {
+  TestInputStream stream("$GPRMC,161229.487,A,3723.2475,N,12158.3416,W,0.13,309.62,120598,,*10\r\n");
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.setHandler(handler);
+  parser.yyparse();
+  CU_ASSERT_FATAL(g_message.messageID == NMEA_GPRMC);
+  CU_ASSERT(GPS::util::epochNanos(g_message.rmc) == 894989549487000000LL);
+}
+
+void test_epochNanos_RMC_2(void) {
+  TestInputStream stream("$GPRMC,,V,,,,,,,,,,N*53\r\n");
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.setHandler(handler);
+  parser.yyparse();
+  CU_ASSERT_FATAL(g_message.messageID == NMEA_GPRMC);
+  CU_ASSERT(GPS::util::epochNanos(g_message.rmc) == GPS_TIME_INVALID);
+}
+
+void test_epochNanos_ZDA(void) {
+  TestInputStream stream("$GPZDA,181813,14,10,2003,00,00*4F\r\n");
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.setHandler(handler);
+  parser.yyparse();
+  CU_ASSERT_FATAL(g_message.messageID == NMEA_GPZDA);
+  CU_ASSERT(GPS::util::epochNanos(g_message.zda) == 1066155493000000000LL);
+}
+
+void test_epochNanos_151(void) {
+  // time of week beyond 16 bits
+  TestInputStream stream("$PSRF151,1,2000,600000,0x40000001*5A\r\n");
+  GPS::NMEA::Parser<TestInputStream> parser(stream);
+  parser.setHandler(handler);
+  parser.yyparse();
+  CU_ASSERT_FATAL(g_message.messageID == NMEA_PSRF151);
+  CU_ASSERT(g_message.gpsDataAndEEM.gpsTOW == 600000);
+  CU_ASSERT(GPS::util::epochNanos(g_message.gpsDataAndEEM) == 1526164782000000000LL);
+
+  stream.set("$PSRF151,0,2000,,0x40000001*5D\r\n");
+  parser.yyparse();
+  CU_ASSERT_FATAL(g_message.messageID == NMEA_PSRF151);
+  CU_ASSERT(GPS::util::epochNanos(g_message.gpsDataAndEEM) == GPS_TIME_INVALID);
+}
+
+void test_gpsToEpochNanos(void) {
+  // GPS week 2000 started 2018-05-05 23:59:42 UTC
+  CU_ASSERT(GPS::util::gpsToEpochNanos(2000,0) == 1525564782000000000LL);
+  CU_ASSERT(GPS::util::gpsToEpochNanos(0,0) == 315964800000000000LL);
+  CU_ASSERT(GPS::util::gpsToEpochNanos(2000,1500000000LL) == 1525564783500000000LL);
+}
+
+void test_epochNanosToGPS(void) {
+  uint16_t week;
+  int64_t tow;
+  GPS::util::epochNanosToGPS(1525564783500000000LL,&week,&tow);
+  CU_ASSERT(week == 2000);
+  CU_ASSERT(tow == 1500000000LL);
+}
+
+void test_leapSeconds(void) {
+  CU_ASSERT(GPS::util::leapSecondsAtUTC(1483228799) == 17);
+  CU_ASSERT(GPS::util::leapSecondsAtUTC(1483228800) == 18);
+  CU_ASSERT(GPS::util::leapSecondsAtGPS(1483228816) == 17);
+  CU_ASSERT(GPS::util::leapSecondsAtGPS(1483228818) == 18);
+  CU_ASSERT(GPS::util::leapSecondsAtUTC(315964800) == 0);
+}
+
+void test_epochNanos_batch(void) {
+  GPS::SiRF::GeodeticNavigationData data[2];
+  int64_t out[2];
+  memset(data,0,sizeof(data));
+  data[0].extendedWeekNumber = 2000;
+  data[0].TOW = 0;
+  data[1].extendedWeekNumber = 2000;
+  data[1].TOW = 100;
+  GPS::util::epochNanos(data,2,out);
+  CU_ASSERT(out[0] == 1525564782000000000LL);
+  CU_ASSERT(out[1] == 1525564782100000000LL);
+}
+
+void init_timetest(void) {
+  CU_pSuite suite;
+
+  suite = CU_add_suite("Time", NULL, NULL);
+  CU_add_test(suite, "test_daysFromCivil", test_daysFromCivil);
+  CU_add_test(suite, "test_epochNanos_RMC", test_epochNanos_RMC);
+  CU_add_test(suite, "test_epochNanos_RMC_2", test_epochNanos_RMC_2);
+  CU_add_test(suite, "test_epochNanos_ZDA", test_epochNanos_ZDA);
+  CU_add_test(suite, "test_epochNanos_151", test_epochNanos_151);
+  CU_add_test(suite, "test_gpsToEpochNanos", test_gpsToEpochNanos);
+  CU_add_test(suite, "test_epochNanosToGPS", test_epochNanosToGPS);
+  CU_add_test(suite, "test_leapSeconds", test_leapSeconds);
+  CU_add_test(suite, "test_epochNanos_batch", test_epochNanos_batch);
+}
@@ -5,16 +5,20 @@
 class TestPort {
 public:
   TestPort()
-    :m_position(0) {
+    :m_position(0),
+     m_writes(0) {
     }
 
   void write(char c) {
     m_buffer[m_position++] = c;
+    m_writes++;
   }
   void write(const char *in_str,int in_l) {
     memcpy(m_buffer + m_position,in_str,in_l);
     m_position += in_l;
+    m_writes++;
   }
+  int writes() const { return m_writes; }
 
   const char *string() {
     m_buffer[m_position] = 0;
@@ -23,6 +27,7 @@ public:
 private:
   char m_buffer[128];
   int m_position;
+  int m_writes;
 };
 
 class TestStream {
@@ -105,6 +110,56 @@ void test_decodeDecimal_4_4_float(void) {
   CU_ASSERT(i == 12345);
 }
 
+void test_decodeFloat(void) {
+  const char *txt[] = { "0.0", "1.7", "-34.2", "2447.2038", "12100.4990", "309.62", "0.13" };
+  for (int n = 0;n < 7;n++) {
+    int l = strlen(txt[n]);
+    int16_t i;
+    uint16_t f;
+    GPS::util::decodeDecimal<int16_t,uint16_t,4>((const int8_t *)txt[n],0,l,&i,&f);
+    int32_t scaled = (int32_t)i * 10000 + (txt[n][0] == '-' ? -f : f);
+    double fixed = scaled / 10000.0;
+    CU_ASSERT(GPS::util::decodeFloat<double>((const int8_t *)txt[n],0,l) == fixed);
+    CU_ASSERT(GPS::util::decodeFloat<float>((const int8_t *)txt[n],0,l) == (float)fixed);
+  }
+}
+
+void test_decodeFloat_2(void) {
+  const char *txt = "4807.038247196";
+  CU_ASSERT(GPS::util::decodeFloat<double>((const int8_t *)txt,0,14) == 4807.038247196);
+  CU_ASSERT(GPS::util::decodeFloat<float>((const int8_t *)txt,0,14) == 4807.038247196f);
+}
+
+void test_decodeFloat_3(void) {
+  // digits after the 15th significant one are truncated
+  const char *txt = "1234.5678901234567";
+  CU_ASSERT(GPS::util::decodeFloat<double>((const int8_t *)txt,0,18) == 1234.56789012345);
+  txt = "12345678901234567";
+  CU_ASSERT(GPS::util::decodeFloat<double>((const int8_t *)txt,0,17) == 12345678901234500.0);
+  txt = "0.000123456789012345678";
+  CU_ASSERT(GPS::util::decodeFloat<double>((const int8_t *)txt,0,23) == 0.000123456789012345);
+}
+
+void test_decodeCoordinateE7(void) {
+  const char *txt = "3342.6618";
+  CU_ASSERT(GPS::util::decodeCoordinateE7((const int8_t *)txt,0,9) == 337110300);
+}
+
+void test_decodeCoordinateE7_2(void) {
+  const char *txt = "12100.4990";
+  CU_ASSERT(GPS::util::decodeCoordinateE7((const int8_t *)txt,0,10) == 1210083167);
+}
+
+void test_decodeCoordinateE7_3(void) {
+  const char *txt = "4807.038247";
+  CU_ASSERT(GPS::util::decodeCoordinateE7((const int8_t *)txt,0,11) == 481173041);
+}
+
+void test_decodeCoordinateE7_4(void) {
+  const char *txt = "18000.0000";
+  CU_ASSERT(GPS::util::decodeCoordinateE7((const int8_t *)txt,0,10) == 1800000000);
+}
+
 void test_decodeUTCTime(void) {
   GPS::NMEA::UTCTime t;
   TestStream st("104549.04");
@@ -132,6 +187,30 @@ void test_portWrapper(void) {
     << ".2,M,,0000";
   pw.end();
   CU_ASSERT(strcmp(port.string(),"$GPGGA,002153.000,3342.6618,N,11751.3858,W,1,10,1.2,27.0,M,-34.2,M,,0000*5E\r\n") == 0);
+  CU_ASSERT(port.writes() == 1);
+}
+
+void test_portWrapperPrefix(void) {
+  TestPort port;
+  GPS::util::PortWrapper<TestPort> pw(port);
+  enum { PREFIX_CHECKSUM = GPS::util::nmeaChecksum("PSRF100,") };
+  pw.begin("$PSRF100,",9,PREFIX_CHECKSUM);
+  pw << 1 << ',' << 9600 << ",8,1,0";
+  pw.end();
+  CU_ASSERT(strcmp(port.string(),"$PSRF100,1,9600,8,1,0*0D\r\n") == 0);
+  CU_ASSERT(port.writes() == 1);
+}
+
+void test_formatDecimal(void) {
+  char buf[12];
+  buf[GPS::util::formatDecimal(buf,0)] = 0;
+  CU_ASSERT(strcmp(buf,"0") == 0);
+  buf[GPS::util::formatDecimal(buf,115200)] = 0;
+  CU_ASSERT(strcmp(buf,"115200") == 0);
+  buf[GPS::util::formatDecimal(buf,-34)] = 0;
+  CU_ASSERT(strcmp(buf,"-34") == 0);
+  buf[GPS::util::formatDecimal(buf,INT32_MIN)] = 0;
+  CU_ASSERT(strcmp(buf,"-2147483648") == 0);
 }
 
 void test_decimal1616_t(void) {
@@ -144,6 +223,16 @@ void test_decimal1616_t(void) {
   CU_ASSERT(b.fractionalPart == b.fractionalPart);
 }
 
+void test_bigEndian(void) {
+  uint8_t buf[6] = { 0,0,0,0,0,0 };
+  GPS::util::writeBE32(buf + 1,0x01020304);
+  CU_ASSERT(buf[1] == 1 && buf[2] == 2 && buf[3] == 3 && buf[4] == 4);
+  CU_ASSERT(GPS::util::readBE32(buf + 1) == 0x01020304);
+  GPS::util::writeBE16(buf + 1,0xa0b0);
+  CU_ASSERT(buf[1] == 0xa0 && buf[2] == 0xb0);
+  CU_ASSERT(GPS::util::readBE16(buf + 1) == 0xa0b0);
+}
+
 void init_utiltest(void) {
   CU_pSuite suite;
 
@@ -156,7 +245,17 @@ void init_utiltest(void) {
   CU_add_test(suite, "test_decodeDecimal_4_4_3", test_decodeDecimal_4_4_3);
   CU_add_test(suite, "test_decodeDecimal_4_4_4", test_decodeDecimal_4_4_4);
   CU_add_test(suite, "test_decodeDecimal_4_4_float", test_decodeDecimal_4_4_float);
+  CU_add_test(suite, "test_decodeFloat", test_decodeFloat);
+  CU_add_test(suite, "test_decodeFloat_2", test_decodeFloat_2);
+  CU_add_test(suite, "test_decodeFloat_3", test_decodeFloat_3);
+  CU_add_test(suite, "test_decodeCoordinateE7", test_decodeCoordinateE7);
+  CU_add_test(suite, "test_decodeCoordinateE7_2", test_decodeCoordinateE7_2);
+  CU_add_test(suite, "test_decodeCoordinateE7_3", test_decodeCoordinateE7_3);
+  CU_add_test(suite, "test_decodeCoordinateE7_4", test_decodeCoordinateE7_4);
   CU_add_test(suite, "test_decodeUTCTime", test_decodeUTCTime);
   CU_add_test(suite, "test_portWrapper", test_portWrapper);
+  CU_add_test(suite, "test_portWrapperPrefix", test_portWrapperPrefix);
+  CU_add_test(suite, "test_formatDecimal", test_formatDecimal);
   CU_add_test(suite, "test_decimal1616_t", test_decimal1616_t);
+  CU_add_test(suite, "test_bigEndian", test_bigEndian);
 }